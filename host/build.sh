@@ -0,0 +1,12 @@
+#!/bin/sh
+# Builds the host-side Sparkler tools. Run from the host directory.
+cc -O2 -Imock -I../src patbench.c ../src/pattern.c -o patbench
+cc -O2 -Imock -I../src copdump.c ../src/copper.c -o copdump
+cc -O2 -Imock -I../src hudshot.c ../src/hud.c ../src/font.c -o hudshot
+cc -O2 -Imock -I../src refframe.c expected.c render.c ppm.c ../src/copper.c ../src/pattern.c ../src/hud.c ../src/font.c -o refframe
+cc -O2 -Imock planarbench.c planar.c -o planarbench
+cc -O2 -Imock -I../src sparkdiff.c sparkle.c expected.c render.c ppm.c ../src/copper.c ../src/pattern.c ../src/hud.c ../src/font.c -o sparkdiff
+cc -O2 -Imock -I../src soak.c sparkle.c expected.c render.c ../src/copper.c ../src/pattern.c ../src/hud.c ../src/font.c -o soak -lpthread
+cc -O2 -Imock -I../src sparkctl.c serlink.c ../src/protocol.c -o sparkctl
+cc -O2 -Imock -I../src sparksim.c ../src/protocol.c ../src/sweep.c ../src/pattern.c -o sparksim
+cc -O2 -Imock -I../src ilbmbench.c ../src/image.c ../src/pattern.c -o ilbmbench
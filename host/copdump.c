@@ -0,0 +1,332 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Prints the copper lists Sparkler builds for every hires/interlace/PAL
+// combination, using made-up chip addresses for the bitplanes. Interlaced
+// lists are printed again as patched for field 1.
+// With an argument, adds color bands that many rows high. With -c, checks
+// the lists against the ones the original hand-written code made instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "copper.h"
+
+#define PLANE_ADDR(n) (0x00020000 + ((n) * 0x14000))
+#define HUD_ADDR 0x00018000
+#define HUD_LINES 38
+
+#define BASELINE_MAX_WORDS 72
+
+// The lists the hand-written code in the original setupDisplay() made for
+// each combination, with the addresses above and its two list addresses
+// 0x00010000 and 0x00010800. Interlaced displays had a second list for
+// field 1 that loaded COLOR16-31, since its register counter went on from
+// the first list, and the two lists chained to each other through COP1LC.
+static const UWORD baselineLists[8][2][BASELINE_MAX_WORDS] =
+{
+    // hires=0 interlaced=0 pal=0
+    {
+        {
+            0x0100, 0x4200, 0x0108, 0x0000, 0x010a, 0x0000, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0xf4c1, 0xffff, 0xfffe
+        }
+    },
+    // hires=1 interlaced=0 pal=0
+    {
+        {
+            0x0100, 0xc200, 0x0108, 0x0000, 0x010a, 0x0000, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0xf4c1, 0xffff, 0xfffe
+        }
+    },
+    // hires=0 interlaced=1 pal=0
+    {
+        {
+            0x0100, 0x4204, 0x0108, 0x0028, 0x010a, 0x0028, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0xf4c1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0800, 0xffff, 0xfffe
+        },
+        {
+            0x0100, 0x4204, 0x0108, 0x0028, 0x010a, 0x0028, 0x0092, 0x0038, 0x0094, 0x00d0, 0x01a0, 0x0000, 0x01a2, 0x0fbf, 0x01a4, 0x0710,
+            0x01a6, 0x0c10, 0x01a8, 0x0910, 0x01aa, 0x0e20, 0x01ac, 0x0fcb, 0x01ae, 0x0fff, 0x01b0, 0x0f42, 0x01b2, 0x0000, 0x01b4, 0x0f98,
+            0x01b6, 0x0f65, 0x01b8, 0x0c54, 0x01ba, 0x0322, 0x01bc, 0x0444, 0x01be, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0028, 0x00e4, 0x0003,
+            0x00e6, 0x4028, 0x00e8, 0x0004, 0x00ea, 0x8028, 0x00ec, 0x0005, 0x00ee, 0xc028, 0x008e, 0x2c81, 0x0090, 0xf4c1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0000, 0xffff, 0xfffe
+        }
+    },
+    // hires=1 interlaced=1 pal=0
+    {
+        {
+            0x0100, 0xc204, 0x0108, 0x0050, 0x010a, 0x0050, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0xf4c1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0800, 0xffff, 0xfffe
+        },
+        {
+            0x0100, 0xc204, 0x0108, 0x0050, 0x010a, 0x0050, 0x0092, 0x0038, 0x0094, 0x00d0, 0x01a0, 0x0000, 0x01a2, 0x0fbf, 0x01a4, 0x0710,
+            0x01a6, 0x0c10, 0x01a8, 0x0910, 0x01aa, 0x0e20, 0x01ac, 0x0fcb, 0x01ae, 0x0fff, 0x01b0, 0x0f42, 0x01b2, 0x0000, 0x01b4, 0x0f98,
+            0x01b6, 0x0f65, 0x01b8, 0x0c54, 0x01ba, 0x0322, 0x01bc, 0x0444, 0x01be, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0050, 0x00e4, 0x0003,
+            0x00e6, 0x4050, 0x00e8, 0x0004, 0x00ea, 0x8050, 0x00ec, 0x0005, 0x00ee, 0xc050, 0x008e, 0x2c81, 0x0090, 0xf4c1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0000, 0xffff, 0xfffe
+        }
+    },
+    // hires=0 interlaced=0 pal=1
+    {
+        {
+            0x0100, 0x4200, 0x0108, 0x0000, 0x010a, 0x0000, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0x2cc1, 0xffff, 0xfffe
+        }
+    },
+    // hires=1 interlaced=0 pal=1
+    {
+        {
+            0x0100, 0xc200, 0x0108, 0x0000, 0x010a, 0x0000, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0x2cc1, 0xffff, 0xfffe
+        }
+    },
+    // hires=0 interlaced=1 pal=1
+    {
+        {
+            0x0100, 0x4204, 0x0108, 0x0028, 0x010a, 0x0028, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0x2cc1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0800, 0xffff, 0xfffe
+        },
+        {
+            0x0100, 0x4204, 0x0108, 0x0028, 0x010a, 0x0028, 0x0092, 0x0038, 0x0094, 0x00d0, 0x01a0, 0x0000, 0x01a2, 0x0fbf, 0x01a4, 0x0710,
+            0x01a6, 0x0c10, 0x01a8, 0x0910, 0x01aa, 0x0e20, 0x01ac, 0x0fcb, 0x01ae, 0x0fff, 0x01b0, 0x0f42, 0x01b2, 0x0000, 0x01b4, 0x0f98,
+            0x01b6, 0x0f65, 0x01b8, 0x0c54, 0x01ba, 0x0322, 0x01bc, 0x0444, 0x01be, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0028, 0x00e4, 0x0003,
+            0x00e6, 0x4028, 0x00e8, 0x0004, 0x00ea, 0x8028, 0x00ec, 0x0005, 0x00ee, 0xc028, 0x008e, 0x2c81, 0x0090, 0x2cc1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0000, 0xffff, 0xfffe
+        }
+    },
+    // hires=1 interlaced=1 pal=1
+    {
+        {
+            0x0100, 0xc204, 0x0108, 0x0050, 0x010a, 0x0050, 0x0092, 0x0038, 0x0094, 0x00d0, 0x0180, 0x0000, 0x0182, 0x0fbf, 0x0184, 0x0710,
+            0x0186, 0x0c10, 0x0188, 0x0910, 0x018a, 0x0e20, 0x018c, 0x0fcb, 0x018e, 0x0fff, 0x0190, 0x0f42, 0x0192, 0x0000, 0x0194, 0x0f98,
+            0x0196, 0x0f65, 0x0198, 0x0c54, 0x019a, 0x0322, 0x019c, 0x0444, 0x019e, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0000, 0x00e4, 0x0003,
+            0x00e6, 0x4000, 0x00e8, 0x0004, 0x00ea, 0x8000, 0x00ec, 0x0005, 0x00ee, 0xc000, 0x008e, 0x2c81, 0x0090, 0x2cc1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0800, 0xffff, 0xfffe
+        },
+        {
+            0x0100, 0xc204, 0x0108, 0x0050, 0x010a, 0x0050, 0x0092, 0x0038, 0x0094, 0x00d0, 0x01a0, 0x0000, 0x01a2, 0x0fbf, 0x01a4, 0x0710,
+            0x01a6, 0x0c10, 0x01a8, 0x0910, 0x01aa, 0x0e20, 0x01ac, 0x0fcb, 0x01ae, 0x0fff, 0x01b0, 0x0f42, 0x01b2, 0x0000, 0x01b4, 0x0f98,
+            0x01b6, 0x0f65, 0x01b8, 0x0c54, 0x01ba, 0x0322, 0x01bc, 0x0444, 0x01be, 0x0888, 0x00e0, 0x0002, 0x00e2, 0x0050, 0x00e4, 0x0003,
+            0x00e6, 0x4050, 0x00e8, 0x0004, 0x00ea, 0x8050, 0x00ec, 0x0005, 0x00ee, 0xc050, 0x008e, 0x2c81, 0x0090, 0x2cc1, 0xf401, 0xfffe,
+            0x0080, 0x0001, 0x0082, 0x0000, 0xffff, 0xfffe
+        }
+    }
+};
+
+// Bands step through C1 like Sparkler does from C0/C1 = 000/000
+static UWORD bandColors[512][2];
+
+// Same palette and startup colors as setupDisplay()
+static const UWORD colors[16] = { 0, 0xfbf, 0x710, 0xC10, 0x910, 0xE20, 0xFCB, 0xFFF, 0xF42, 0x0, 0xF98, 0xF65, 0xC54, 0x322, 0x444, 0x888 };
+
+static void PrintList(const char* name, const struct CopperList* cl)
+{
+    printf("%s:", name);
+    for (int i = 0; i < cl->written; i++)
+    {
+        printf(" %04x", cl->words[i]);
+    }
+    printf("\n");
+}
+
+static void GetDisplay(struct CopperDisplay* display, int combo, int bandRows)
+{
+    display->hires = combo & 1;
+    display->interlaced = (combo >> 1) & 1;
+    display->pal = (combo >> 2) & 1;
+    display->modulo = display->interlaced ? (display->hires ? 0x50 : 0x28) : 0;
+    display->rowBytes = display->hires ? 80 : 40;
+    display->hudPlane = HUD_ADDR;
+    display->hudColor = 0x888;
+    display->hudLines = HUD_LINES;
+    display->bandRows = bandRows;
+    display->bandCount = 512;
+    display->bandColors = bandColors;
+    display->scroll = FALSE;
+    display->scrollX = 0;
+    display->scrollY = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        display->planes[i] = PLANE_ADDR(i);
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        display->colors[i] = colors[i];
+    }
+}
+
+static int Put(UWORD* words, int n, UWORD first, UWORD second)
+{
+    words[n] = first;
+    words[n + 1] = second;
+    return n + 2;
+}
+
+// The words Sparkler should build now from a baseline list, with each
+// deliberate change since made to it in turn. Returns the word count.
+static int ExpectedList(const UWORD* baseline, const struct CopperDisplay* display, UWORD* words)
+{
+    int n = 0;
+    ULONG fieldOffset = 0;
+
+    for (int i = 0; ; i += 2)
+    {
+        UWORD reg = baseline[i];
+        UWORD value = baseline[i + 1];
+
+        if (reg == 0xFFFF && value == 0xFFFE)
+        {
+            // Below the HUD band plane 4 shows the bitmap again and colors
+            // 8-15 are the palette's (hud.c)
+            int rows = display->hudLines * (display->interlaced ? 2 : 1);
+            ULONG plane = display->planes[3] + fieldOffset + ((ULONG)rows * display->rowBytes);
+            n = Put(words, n, (UWORD)(((COPPER_DISPLAY_TOP + display->hudLines) << 8) | 0x01), 0xFFFE);
+            n = Put(words, n, COPREG(bplpt) + 12, (UWORD)(plane >> 16));
+            n = Put(words, n, COPREG(bplpt) + 14, (UWORD)(plane & 0xFFFF));
+            for (int c = 8; c < 16; c++)
+            {
+                n = Put(words, n, COPREG(color) + (c * 2), display->colors[c]);
+            }
+            return Put(words, n, 0xFFFF, 0xFFFE);
+        }
+
+        // Both fields run one list, so the WAIT and COP1LC moves that
+        // chained the two went (vblank.c)
+        if ((reg & 1) != 0 || reg == COPREG(cop1lc) || reg == COPREG(cop1lc) + 2)
+            continue;
+
+        // The one change the builder made: field 1 loads COLOR00-15 too
+        if (reg >= COPREG(color) + 32 && reg < COPREG(color) + 64)
+            reg -= 32;
+
+        // Plane 4 set selects colors 8-15, so in the HUD band they are its
+        // pen, and plane 4 is the HUD overlay there (hud.c)
+        if (reg >= COPREG(color) + 16 && reg < COPREG(color) + 32)
+            value = display->hudColor;
+
+        if (reg == COPREG(bplpt) + 12)
+        {
+            fieldOffset = (((ULONG)value << 16) | baseline[i + 3]) - display->planes[3];
+            n = Put(words, n, reg, (UWORD)((display->hudPlane + fieldOffset) >> 16));
+            n = Put(words, n, reg + 2, (UWORD)((display->hudPlane + fieldOffset) & 0xFFFF));
+            i += 2;
+            continue;
+        }
+
+        n = Put(words, n, reg, value);
+
+        // BPLCON1 is set for hardware scrolling (vblank.c)
+        if (reg == COPREG(bplcon0))
+            n = Put(words, n, COPREG(bplcon1), 0);
+    }
+}
+
+static int CheckList(const char* name, const struct CopperList* cl, const UWORD* baseline, const struct CopperDisplay* display)
+{
+    UWORD expected[BASELINE_MAX_WORDS * 2];
+    int count = ExpectedList(baseline, display, expected);
+
+    if (cl->written == count && memcmp(cl->words, expected, count * sizeof(UWORD)) == 0)
+        return 0;
+
+    int i = 0;
+    while (i < count && i < cl->written && cl->words[i] == expected[i])
+    {
+        i++;
+    }
+    printf("  %s differs from word %d\n", name, i);
+    PrintList("  built", cl);
+    printf("  expected:");
+    for (int j = 0; j < count; j++)
+    {
+        printf(" %04x", expected[j]);
+    }
+    printf("\n");
+    return 1;
+}
+
+static int Check()
+{
+    UWORD words[2048];
+    int errors = 0;
+
+    for (int combo = 0; combo < 8; combo++)
+    {
+        struct CopperDisplay display;
+        GetDisplay(&display, combo, 0);
+
+        struct CopperList cl;
+        CopperInit(&cl, words, sizeof(words));
+        CopperBuild(&cl, &display);
+
+        int comboErrors = CheckList("field 0", &cl, baselineLists[combo][0], &display);
+        if (display.interlaced)
+        {
+            CopperPatchField(&cl, &display, 1);
+            comboErrors += CheckList("field 1", &cl, baselineLists[combo][1], &display);
+        }
+
+        printf("hires=%d interlaced=%d pal=%d %s\n", display.hires, display.interlaced, display.pal, comboErrors == 0 ? "ok" : "differs");
+        errors += comboErrors;
+    }
+
+    printf("%d lists differ\n", errors);
+    return errors != 0;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 0; i < 512; i++)
+    {
+        bandColors[i][0] = 0;
+        bandColors[i][1] = (UWORD)i;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        return Check();
+    }
+
+    int bandRows = argc > 1 ? atoi(argv[1]) : 0;
+    UWORD words[2048];
+
+    for (int combo = 0; combo < 8; combo++)
+    {
+        struct CopperDisplay display;
+        GetDisplay(&display, combo, bandRows);
+
+        printf("hires=%d interlaced=%d pal=%d\n", display.hires, display.interlaced, display.pal);
+
+        struct CopperList cl;
+        CopperInit(&cl, words, sizeof(words));
+        CopperBuild(&cl, &display);
+        PrintList("list", &cl);
+
+        // The same list as the server points it at the second field
+        if (display.interlaced)
+        {
+            CopperPatchField(&cl, &display, 1);
+            PrintList("field1", &cl);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Expected frames, see expected.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "copper.h"
+#include "hud.h"
+#include "pattern.h"
+#include "expected.h"
+
+#define CHIP_SIZE (512L * 1024L)
+#define LIST_ADDR 0x1000
+#define LIST_WORDS 0x2000
+#define HUD_ADDR 0x10000
+#define PLANE_ADDR(n) (0x20000 + ((n) * 0x10000))
+
+static uint8_t chip[CHIP_SIZE] __attribute__((aligned(4)));
+static int builtFields = 0;
+static BOOL builtPal = FALSE;
+static struct CopperDisplay builtDisplay;
+static struct CopperList builtList;
+
+static void StoreList(const struct CopperList* cl, uint32_t addr)
+{
+    for (int i = 0; i < cl->written; i++)
+    {
+        chip[addr + (i * 2)] = (uint8_t)(cl->words[i] >> 8);
+        chip[addr + (i * 2) + 1] = (uint8_t)cl->words[i];
+    }
+}
+
+static BOOL Valid(const struct ExpectedState* state)
+{
+    return (state->width == 320 || state->width == 640)
+        && (state->height == 200 || state->height == 256 || state->height == 400 || state->height == 512)
+        && state->lineMode >= 1 && state->lineMode <= PATTERN_ALL_MODES;
+}
+
+int ExpectedParse(struct ExpectedState* state, int argc, char** argv)
+{
+    if (argc < 3)
+        return 0;
+
+    state->width = atoi(argv[0]);
+    state->height = atoi(argv[1]);
+    state->lineMode = atoi(argv[2]);
+    state->seed = 0;
+    if (argv[2][0] == 'N' && argv[2][1] == ':')
+    {
+        char* end;
+        state->lineMode = PATTERN_NOISE;
+        state->seed = strtoul(argv[2] + 2, &end, 16);
+        if (*end != '\0' || end == argv[2] + 2)
+            return 0;
+    }
+    state->colors[0] = 0x000;
+    state->colors[1] = 0xfbf;
+    state->hud = TRUE;
+    state->scroll = FALSE;
+    state->scrollX = 0;
+    state->scrollY = 0;
+
+    int used = 3;
+    if (argc >= 5)
+    {
+        char* end0;
+        char* end1;
+        ULONG c0 = strtoul(argv[3], &end0, 16);
+        ULONG c1 = strtoul(argv[4], &end1, 16);
+
+        // Colors are optional, so anything else is left for the caller
+        if (*end0 == '\0' && *end1 == '\0' && end0 != argv[3] && end1 != argv[4])
+        {
+            state->colors[0] = (UWORD)(c0 & 0xFFF);
+            state->colors[1] = (UWORD)(c1 & 0xFFF);
+            used = 5;
+        }
+    }
+
+    return Valid(state) ? used : 0;
+}
+
+int ExpectedBuild(const struct ExpectedState* state)
+{
+    if (!Valid(state))
+        return 0;
+
+    int width = state->width;
+    int height = state->height;
+    BOOL hires = width == 640;
+    BOOL interlaced = height > 256;
+    BOOL pal = (height % 256) == 0;
+
+    memset(chip, 0, sizeof(chip));
+
+    // Same bitmap as the pattern cache builds
+    UBYTE* planes[4];
+    for (int i = 0; i < 4; i++)
+    {
+        planes[i] = chip + PLANE_ADDR(i);
+    }
+    if (!FillPatternPlanes(planes, 4, width / 8, height, state->lineMode, state->seed))
+        return 0;
+    FillPatternWrapRow(planes, 4, width / 8, height);
+
+    // Palette from initDisplayState()
+    static const UWORD colors[16] = { 0, 0xfbf, 0x710, 0xC10, 0x910, 0xE20, 0xFCB, 0xFFF, 0xF42, 0x0, 0xF98, 0xF65, 0xC54, 0x322, 0x444, 0x888 };
+
+    // Same HUD as Sparkler shows at startup
+    int hudRows = 0;
+    if (state->hud)
+    {
+        HudInit(chip + HUD_ADDR);
+        hudRows = HudLayout(width, TRUE);
+        sprintf(HudFieldText(HUD_VIDEO, 1), "%s %dx%d I:%d", pal ? "PAL" : "NTSC", width, height, interlaced);
+        PatternLabel(HudFieldText(HUD_PATTERN, 1), state->lineMode, state->seed);
+        for (int i = 0; i < 2; i++)
+        {
+            UWORD c = state->colors[i];
+            sprintf(HudFieldText(HUD_COLOR0 + i, 1), "C%d(R:%x G:%x B:%x)", i, c >> 8, (c >> 4) & 0xF, c & 0xF);
+        }
+        sprintf(HudFieldText(HUD_PALETTE, 1), "E2(R:%x G:%x B:%x)", colors[2] >> 8, (colors[2] >> 4) & 0xF, colors[2] & 0xF);
+        HudRender();
+    }
+
+    struct CopperDisplay display;
+    display.hires = hires;
+    display.interlaced = interlaced;
+    display.pal = pal;
+    display.modulo = interlaced ? width / 8 : 0;
+    display.rowBytes = width / 8;
+    display.hudLines = interlaced ? (hudRows + 1) / 2 : hudRows;
+    display.bandRows = 0;
+    display.bandCount = 0;
+    display.bandColors = NULL;
+    display.scroll = state->scroll;
+    display.scrollX = state->scrollX;
+    display.scrollY = state->scrollY;
+
+    for (int i = 0; i < 4; i++)
+    {
+        display.planes[i] = PLANE_ADDR(i);
+    }
+    display.hudPlane = HUD_ADDR;
+    display.hudColor = HUD_TEXT_COLOR;
+
+    for (int i = 0; i < 16; i++)
+    {
+        display.colors[i] = colors[i];
+    }
+    display.colors[0] = state->colors[0];
+    display.colors[1] = state->colors[1];
+
+    static UWORD words[LIST_WORDS];
+    CopperInit(&builtList, words, sizeof(words));
+    CopperBuild(&builtList, &display);
+    if (builtList.overflow)
+        return 0;
+
+    builtDisplay = display;
+    builtFields = interlaced ? 2 : 1;
+    builtPal = pal;
+    return builtFields;
+}
+
+BOOL ExpectedRenderField(int field, struct RenderFrame* frame)
+{
+    if (field >= builtFields)
+        return FALSE;
+
+    // Both fields run the one list, pointed at the field as the vertical
+    // blank server does
+    CopperPatchField(&builtList, &builtDisplay, field);
+    StoreList(&builtList, LIST_ADDR);
+    return RenderField(chip, CHIP_SIZE, LIST_ADDR, builtPal, frame);
+}
+
+BOOL ExpectedRenderFrame(struct RenderFrame* frame)
+{
+    if (builtFields < 2)
+        return ExpectedRenderField(0, frame);
+
+    static struct RenderFrame fields[2];
+    for (int field = 0; field < 2; field++)
+    {
+        if (!ExpectedRenderField(field, &fields[field]))
+            return FALSE;
+    }
+
+    // Long frames show the even lines
+    frame->width = fields[0].width;
+    frame->hires = fields[0].hires;
+    frame->height = 0;
+
+    for (int y = 0; y < fields[0].height * 2 && y < RENDER_MAX_LINES * 2; y++)
+    {
+        const struct RenderFrame* source = &fields[y & 1];
+        memcpy(frame->pixels + ((long)y * frame->width), source->pixels + ((long)(y / 2) * source->width), frame->width * sizeof(uint32_t));
+        frame->height++;
+    }
+
+    return TRUE;
+}
+
+uint32_t* ExpectedScale(const struct RenderFrame* frame, int width, int height)
+{
+    uint32_t* pixels = (uint32_t*)malloc((size_t)width * height * sizeof(uint32_t));
+    if (pixels == NULL)
+        return NULL;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint32_t* row = frame->pixels + ((long)((long)y * frame->height / height) * frame->width);
+        for (int x = 0; x < width; x++)
+        {
+            pixels[((long)y * width) + x] = row[(long)x * frame->width / width];
+        }
+    }
+
+    return pixels;
+}
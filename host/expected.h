@@ -0,0 +1,47 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Builds the bitmap, HUD and copper lists Sparkler shows for a state in an
+// image of chip RAM, using the Amiga source, and renders them with the
+// reference renderer. Shared by the tools that need an expected frame.
+
+#ifndef SPARKLER_EXPECTED_H
+#define SPARKLER_EXPECTED_H
+
+#include <exec/types.h>
+
+#include "render.h"
+
+// What the status line reports
+struct ExpectedState
+{
+    int width;          // 320 or 640
+    int height;         // 200, 256, 400 or 512
+    int lineMode;       // 1-7, or a De Bruijn, multi-plane or noise mode
+    ULONG seed;         // noise seed
+    UWORD colors[2];    // C0 and C1
+    BOOL hud;           // show the overlay as at startup
+    BOOL scroll;        // hardware scrolling, at scrollX and scrollY
+    ULONG scrollX;      // BPLCON1 steps
+    ULONG scrollY;      // bitmap rows
+};
+
+// Parse "<320|640> <200|256|400|512> <pattern> [c0 c1]" from argv, colors in
+// hex. The pattern is a line mode, or noise as the HUD shows it: "N:" and
+// the seed in hex. Returns the number of arguments used, 0 if they are not
+// valid.
+int ExpectedParse(struct ExpectedState* state, int argc, char** argv);
+
+// Build the chip RAM image for state. Returns the number of fields, 0 if
+// the state is not valid.
+int ExpectedBuild(const struct ExpectedState* state);
+
+// Render a field of the last build
+BOOL ExpectedRenderField(int field, struct RenderFrame* frame);
+
+// Both fields of an interlaced build woven into one frame, or field 0
+BOOL ExpectedRenderFrame(struct RenderFrame* frame);
+
+// Frame scaled to a capture's size, nearest neighbour so every captured
+// pixel maps to one Amiga pixel. Allocated with malloc; NULL if out of memory.
+uint32_t* ExpectedScale(const struct RenderFrame* frame, int width, int height);
+
+#endif
@@ -0,0 +1,107 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Renders the HUD overlay plane with sample values and writes it to stdout
+// as a PBM image, for comparing against known good output. With -c,
+// compares the standard widths with and without help against the images
+// in golden/ instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hud.h"
+
+#define GOLDEN_DIR "golden"
+
+// PBM header and the rows of a full plane
+#define SHOT_MAX_BYTES (32 + HUD_PLANE_BYTES)
+
+// Render the overlay into a PBM image; returns its length
+static long Shot(int width, BOOL showHelp, UBYTE* pbm)
+{
+    // HudInit expects a clear plane, and -c draws several shots in this one
+    static UBYTE plane[HUD_PLANE_BYTES];
+    memset(plane, 0, sizeof(plane));
+    HudInit(plane);
+    int rows = HudLayout(width, showHelp);
+
+    // Same startup values Sparkler shows
+    strcpy(HudFieldText(HUD_VIDEO, 1), "NTSC 640x200 I:0");
+    strcpy(HudFieldText(HUD_PATTERN, 1), "P:1");
+    strcpy(HudFieldText(HUD_COLOR0, 1), "C0(R:0 G:0 B:0)");
+    strcpy(HudFieldText(HUD_COLOR1, 1), "C1(R:f G:b B:f)");
+    strcpy(HudFieldText(HUD_CACHE, 1), "Cache H:0 M:2 E:0");
+    strcpy(HudFieldText(HUD_BANDS, 1), "Bands 4 rows: 000/000 to 000/031");
+    strcpy(HudFieldText(HUD_SWEEP, 1), "Sweep Gray 0/16777216 x2");
+    HudRender();
+
+    // PBM rows are packed MSB first, the same as a bitplane
+    long length = sprintf((char*)pbm, "P4\n%d %d\n", width, rows);
+    memcpy(pbm + length, plane, (size_t)(width / 8) * rows);
+    return length + ((long)(width / 8) * rows);
+}
+
+// Whole file, or -1 if it can't be read
+static long ReadFile(const char* path, UBYTE* data, long size)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return -1;
+
+    long length = (long)fread(data, 1, size, file);
+    fclose(file);
+    return length;
+}
+
+static int Check()
+{
+    static UBYTE shot[SHOT_MAX_BYTES];
+    static UBYTE golden[SHOT_MAX_BYTES + 1];
+    static const int widths[] = { 320, 640 };
+    int errors = 0;
+
+    for (int w = 0; w < 2; w++)
+    {
+        for (int help = 0; help <= 1; help++)
+        {
+            char path[64];
+            snprintf(path, sizeof(path), "%s/hud-%d-help%d.pbm", GOLDEN_DIR, widths[w], help);
+
+            long length = Shot(widths[w], help, shot);
+            long goldenLength = ReadFile(path, golden, sizeof(golden));
+
+            const char* result = "ok";
+            if (goldenLength < 0)
+                result = "can't read the golden image";
+            else if (goldenLength != length || memcmp(shot, golden, length) != 0)
+                result = "differs";
+
+            printf("%s: %s\n", path, result);
+            errors += result[0] != 'o';
+        }
+    }
+
+    printf("%d images differ\n", errors);
+    return errors != 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        return Check();
+    }
+
+    int width = argc > 1 ? atoi(argv[1]) : 640;
+    BOOL showHelp = argc > 2 ? atoi(argv[2]) != 0 : TRUE;
+
+    if (width != 320 && width != 640)
+    {
+        fprintf(stderr, "usage: hudshot [320|640] [help 0|1] > hud.pbm | -c\n");
+        return 1;
+    }
+
+    static UBYTE pbm[SHOT_MAX_BYTES];
+    long length = Shot(width, showHelp, pbm);
+    fwrite(pbm, 1, length, stdout);
+    return 0;
+}
@@ -0,0 +1,597 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Reports the speed of the image loader (image.c) on generated ILBM and raw
+// pictures, or on the files given, unpacking into the largest bitmap. With
+// -z, feeds it a corpus of corrupted ILBMs and checks that every one comes
+// back with an error or a picture and nothing is written outside the planes.
+// With -c, runs the same checks on the files given, e.g. a saved corpus.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pattern.h"
+#include "image.h"
+
+#define MAX_WIDTH 640
+#define MAX_HEIGHT 512
+#define GUARD_BYTES 64
+#define GUARD 0xA5
+
+// Generated files, and room for the largest one to grow by mutation
+#define MAX_FILE_BYTES (MAX_WIDTH / 8 * MAX_HEIGHT * 6 + 4096)
+
+static const int resolutions[][2] =
+{
+    { 320, 200 }, { 320, 256 }, { 320, 400 }, { 320, 512 },
+    { 640, 200 }, { 640, 256 }, { 640, 400 }, { 640, 512 },
+};
+
+#define RESOLUTION_COUNT (int)(sizeof(resolutions) / sizeof(resolutions[0]))
+
+// Each plane with a guard band either side
+static UBYTE planeData[IMAGE_MAX_DEPTH][GUARD_BYTES + (MAX_WIDTH / 8) * MAX_HEIGHT + GUARD_BYTES];
+static UBYTE fileData[MAX_FILE_BYTES];
+static UBYTE mutated[MAX_FILE_BYTES];
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static ULONG randomState = 12345;
+
+static ULONG Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static void PlanePointers(UBYTE* planes[])
+{
+    for (int p = 0; p < IMAGE_MAX_DEPTH; p++)
+    {
+        planes[p] = planeData[p] + GUARD_BYTES;
+    }
+}
+
+// Everything the loader may not write: before the first plane byte and
+// after the last one
+static void SetGuards(int bytesPerRow, int height)
+{
+    ULONG planeBytes = (ULONG)bytesPerRow * height;
+
+    for (int p = 0; p < IMAGE_MAX_DEPTH; p++)
+    {
+        memset(planeData[p], GUARD, GUARD_BYTES);
+        memset(planeData[p] + GUARD_BYTES + planeBytes, GUARD, sizeof(planeData[p]) - GUARD_BYTES - planeBytes);
+    }
+}
+
+static BOOL GuardsIntact(int bytesPerRow, int height)
+{
+    ULONG planeBytes = (ULONG)bytesPerRow * height;
+
+    for (int p = 0; p < IMAGE_MAX_DEPTH; p++)
+    {
+        for (ULONG i = 0; i < sizeof(planeData[p]); i++)
+        {
+            if (i == GUARD_BYTES)
+                i += planeBytes;
+            if (planeData[p][i] != GUARD)
+                return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// ByteRun1: runs of three or more equal bytes, literals for the rest
+static int PackRow(const UBYTE* row, int bytes, UBYTE* out)
+{
+    int length = 0;
+    int x = 0;
+
+    while (x < bytes)
+    {
+        int run = 1;
+        while (x + run < bytes && run < 128 && row[x + run] == row[x])
+            run++;
+
+        if (run >= 3)
+        {
+            out[length++] = (UBYTE)(257 - run);
+            out[length++] = row[x];
+            x += run;
+            continue;
+        }
+
+        // Literals up to the next run of three
+        int count = 0;
+        while (x + count < bytes && count < 128
+                && !(x + count + 2 < bytes && row[x + count] == row[x + count + 1] && row[x + count] == row[x + count + 2]))
+            count++;
+
+        out[length++] = (UBYTE)(count - 1);
+        memcpy(out + length, row + x, count);
+        length += count;
+        x += count;
+    }
+
+    return length;
+}
+
+static UBYTE* PutLong(UBYTE* out, ULONG value)
+{
+    out[0] = (UBYTE)(value >> 24);
+    out[1] = (UBYTE)(value >> 16);
+    out[2] = (UBYTE)(value >> 8);
+    out[3] = (UBYTE)value;
+    return out + 4;
+}
+
+static UBYTE* PutChunk(UBYTE* out, const char* id, const UBYTE* data, ULONG length)
+{
+    memcpy(out, id, 4);
+    out = PutLong(out + 4, length);
+    memcpy(out, data, length);
+    out += length;
+    if (length & 1)
+        *out++ = 0;
+    return out;
+}
+
+// An ILBM of planes with rows bytesPerRow apart, with an odd ANNO chunk
+// and a CAMG for the loader to pass over. Returns its length.
+static ULONG MakeIlbm(UBYTE* out, UBYTE** planes, int bytesPerRow, int width, int height, int depth,
+                        int masking, int compression, int colors)
+{
+    static UBYTE body[MAX_FILE_BYTES];
+    UBYTE bmhd[20] = { 0 };
+    UBYTE cmap[256 * 3];
+    static const UBYTE camg[4] = { 0, 0, 0x80, 0x04 };
+    static const UBYTE anno[] = "Sparkler";
+    int rowBytes = ((width + 15) >> 4) << 1;
+    UBYTE row[(MAX_WIDTH * 2) / 8];
+
+    bmhd[0] = (UBYTE)(width >> 8);
+    bmhd[1] = (UBYTE)width;
+    bmhd[2] = (UBYTE)(height >> 8);
+    bmhd[3] = (UBYTE)height;
+    bmhd[8] = (UBYTE)depth;
+    bmhd[9] = (UBYTE)masking;
+    bmhd[10] = (UBYTE)compression;
+    bmhd[14] = 10;
+    bmhd[15] = 11;
+
+    for (int i = 0; i < colors * 3; i++)
+    {
+        cmap[i] = (UBYTE)(i * 37);
+    }
+
+    ULONG bodyLength = 0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int p = 0; p < depth + (masking == 1 ? 1 : 0); p++)
+        {
+            // Rows wider than the planes repeat them; the mask plane is set
+            for (int i = 0; i < rowBytes; i++)
+            {
+                row[i] = p < depth ? planes[p][((y % MAX_HEIGHT) * bytesPerRow) + (i % bytesPerRow)] : 0xFF;
+            }
+
+            if (compression == 1)
+            {
+                bodyLength += PackRow(row, rowBytes, body + bodyLength);
+            }
+            else
+            {
+                memcpy(body + bodyLength, row, rowBytes);
+                bodyLength += rowBytes;
+            }
+        }
+    }
+
+    UBYTE* end = PutChunk(out + 12, "BMHD", bmhd, sizeof(bmhd));
+    end = PutChunk(end, "ANNO", anno, sizeof(anno));
+    end = PutChunk(end, "CAMG", camg, sizeof(camg));
+    if (colors > 0)
+        end = PutChunk(end, "CMAP", cmap, colors * 3);
+    end = PutChunk(end, "BODY", body, bodyLength);
+
+    memcpy(out, "FORM", 4);
+    PutLong(out + 4, (ULONG)(end - out) - 8);
+    memcpy(out + 8, "ILBM", 4);
+    return (ULONG)(end - out);
+}
+
+static int LoadFromMemory(const UBYTE* data, ULONG length, struct ImageInfo* info, UBYTE** planes, int bytesPerRow, int height)
+{
+    FILE* file = fmemopen((void*)data, length, "rb");
+    if (file == NULL)
+        return IMAGE_NO_FILE;
+
+    int error = ImageLoad(file, info, planes, IMAGE_MAX_DEPTH, bytesPerRow, height);
+    fclose(file);
+    return error;
+}
+
+// Loads for seconds into the largest bitmap, as megabytes of planes a second
+static double Rate(const UBYTE* data, ULONG length, double seconds, int* pError)
+{
+    UBYTE* planes[IMAGE_MAX_DEPTH];
+    struct ImageInfo info;
+    PlanePointers(planes);
+
+    long loads = 0;
+    double start = Seconds();
+    double elapsed;
+    do
+    {
+        *pError = LoadFromMemory(data, length, &info, planes, MAX_WIDTH / 8, MAX_HEIGHT);
+        if (*pError != IMAGE_OK)
+            return 0;
+        loads++;
+        elapsed = Seconds() - start;
+    } while (elapsed < seconds);
+
+    return (loads * (double)(MAX_WIDTH / 8) * MAX_HEIGHT * IMAGE_MAX_DEPTH) / (elapsed * 1e6);
+}
+
+static void FillPlanes(UBYTE** planes, int lineMode)
+{
+    FillPatternPlanes(planes, IMAGE_MAX_DEPTH, MAX_WIDTH / 8, MAX_HEIGHT, lineMode, 1);
+}
+
+static int Bench(double seconds)
+{
+    static const struct { const char* name; int lineMode; } patterns[] =
+    {
+        { "pattern 1", 1 },
+        { "De Bruijn k:3", PATTERN_DEBRUIJN(3) },
+        { "noise", PATTERN_NOISE },
+    };
+    UBYTE* planes[IMAGE_MAX_DEPTH];
+    PlanePointers(planes);
+
+    printf("Megabytes of planes/second unpacking 640x512x4, file size in brackets\n");
+    printf("%-16s %20s %20s %20s\n", "", "ByteRun1", "uncompressed", "raw");
+
+    for (int i = 0; i < (int)(sizeof(patterns) / sizeof(patterns[0])); i++)
+    {
+        printf("%-16s", patterns[i].name);
+        for (int kind = 0; kind < 3; kind++)
+        {
+            FillPlanes(planes, patterns[i].lineMode);
+
+            ULONG length;
+            if (kind == 2)
+            {
+                length = (MAX_WIDTH / 8) * MAX_HEIGHT * IMAGE_MAX_DEPTH;
+                for (int p = 0; p < IMAGE_MAX_DEPTH; p++)
+                {
+                    memcpy(fileData + (p * length / IMAGE_MAX_DEPTH), planes[p], length / IMAGE_MAX_DEPTH);
+                }
+            }
+            else
+            {
+                length = MakeIlbm(fileData, planes, MAX_WIDTH / 8, MAX_WIDTH, MAX_HEIGHT, IMAGE_MAX_DEPTH, 0, kind == 0, 16);
+            }
+
+            int error;
+            double rate = Rate(fileData, length, seconds, &error);
+            if (error != IMAGE_OK)
+                printf(" %20s", ImageErrorText(error));
+            else
+                printf(" %9.0f (%6luK)", rate, (unsigned long)(length / 1024));
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
+
+static BOOL ReadFile(const char* path, ULONG* pLength)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return FALSE;
+
+    *pLength = fread(fileData, 1, sizeof(fileData), file);
+    fclose(file);
+    return TRUE;
+}
+
+static int BenchFiles(int count, char** paths, double seconds)
+{
+    printf("Megabytes of planes/second unpacking into 640x512x4\n");
+
+    for (int i = 0; i < count; i++)
+    {
+        ULONG length;
+        if (!ReadFile(paths[i], &length))
+        {
+            printf("%s: can't open\n", paths[i]);
+            continue;
+        }
+
+        int error;
+        double rate = Rate(fileData, length, seconds, &error);
+        if (error != IMAGE_OK)
+            printf("%s: %s\n", paths[i], ImageErrorText(error));
+        else
+            printf("%s: %.0f\n", paths[i], rate);
+    }
+
+    return 0;
+}
+
+// Load into every display size with guards round the planes. Returns OK if
+// any size loaded, as a raw file only fits some, or else the first error,
+// and FALSE in *pSafe if anything landed outside the planes.
+static int CheckData(const UBYTE* data, ULONG length, BOOL* pSafe)
+{
+    UBYTE* planes[IMAGE_MAX_DEPTH];
+    struct ImageInfo info;
+    int result = IMAGE_ERROR_COUNT;
+    PlanePointers(planes);
+    *pSafe = TRUE;
+
+    for (int r = 0; r < RESOLUTION_COUNT; r++)
+    {
+        int bytesPerRow = resolutions[r][0] / 8;
+        int height = resolutions[r][1];
+
+        SetGuards(bytesPerRow, height);
+        int error = LoadFromMemory(data, length, &info, planes, bytesPerRow, height);
+        if (!GuardsIntact(bytesPerRow, height))
+            *pSafe = FALSE;
+        if (result == IMAGE_ERROR_COUNT || error == IMAGE_OK)
+            result = error;
+    }
+
+    return result;
+}
+
+static int CheckFiles(int count, char** paths)
+{
+    int failures = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        ULONG length;
+        if (!ReadFile(paths[i], &length))
+        {
+            printf("%s: can't open\n", paths[i]);
+            failures++;
+            continue;
+        }
+
+        BOOL safe;
+        int error = CheckData(fileData, length, &safe);
+        printf("%s: %s%s\n", paths[i], ImageErrorText(error), safe ? "" : ", WROTE OUTSIDE THE PLANES");
+        if (!safe)
+            failures++;
+    }
+
+    return failures != 0;
+}
+
+static void WriteFile(const char* dir, const char* name, int number, const UBYTE* data, ULONG length)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s-%04d.iff", dir, name, number);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "can't write %s\n", path);
+        return;
+    }
+    fwrite(data, 1, length, file);
+    fclose(file);
+}
+
+// Valid pictures covering the BMHD options: sizes either side of every
+// display size, masks, both compressions and CMAPs short and long
+static void MakeSeed(int seed, UBYTE* out, ULONG* pLength)
+{
+    static const int widths[] = { 1, 17, 320, 333, 640, 700 };
+    static const int heights[] = { 1, 9, 200, 256, 513 };
+    static const int lineModes[] = { 1, 5, PATTERN_DEBRUIJN(2), PATTERN_MULTI(2), PATTERN_NOISE };
+    UBYTE* planes[IMAGE_MAX_DEPTH];
+    PlanePointers(planes);
+
+    int width = widths[seed % 6];
+    int height = heights[(seed / 6) % 5];
+    int depth = 1 + (seed % IMAGE_MAX_DEPTH);
+    int masking = (seed / 3) % 3;
+    int compression = (seed / 2) % 2;
+    int colors = (seed * 7) % 40;
+
+    FillPlanes(planes, lineModes[seed % 5]);
+    *pLength = MakeIlbm(out, planes, MAX_WIDTH / 8, width, height, depth, masking, compression, colors);
+}
+
+#define SEED_COUNT 60
+
+// A few changes of the kinds that break loaders: flipped bits, bytes set
+// to edge values, chunk lengths made huge, zero or off by one, cuts, and
+// bytes dropped or repeated
+static ULONG Mutate(const UBYTE* in, ULONG length, UBYTE* out)
+{
+    static const ULONG edges[] = { 0, 1, 2, 0x7F, 0x80, 0x81, 0xFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF };
+
+    memcpy(out, in, length);
+    int changes = 1 + (Random() % 8);
+
+    for (int c = 0; c < changes && length > 0; c++)
+    {
+        ULONG at = Random() % length;
+        switch (Random() % 6)
+        {
+            case 0:
+                out[at] ^= (UBYTE)(1 << (Random() % 8));
+                break;
+
+            case 1:
+                out[at] = (UBYTE)edges[Random() % 7];
+                break;
+
+            case 2:
+            {
+                // A length or size field: the long after an ID, or a BMHD word
+                ULONG field = (at & ~3UL) + 4;
+                if (field + 4 <= length)
+                {
+                    ULONG value = (Random() & 1) ? edges[Random() % 10] : ((ULONG)out[field] << 24 | (ULONG)out[field + 1] << 16 | (ULONG)out[field + 2] << 8 | out[field + 3]) + (Random() % 3) - 1;
+                    PutLong(out + field, value);
+                }
+                break;
+            }
+
+            case 3:
+                length = at;
+                break;
+
+            case 4:
+            {
+                ULONG count = 1 + (Random() % 16);
+                if (at + count <= length)
+                {
+                    memmove(out + at, out + at + count, length - at - count);
+                    length -= count;
+                }
+                break;
+            }
+
+            case 5:
+            {
+                ULONG count = 1 + (Random() % 16);
+                if (at + count <= length && length + count <= MAX_FILE_BYTES)
+                {
+                    memmove(out + at + count, out + at, length - at);
+                    length += count;
+                }
+                break;
+            }
+        }
+    }
+
+    return length;
+}
+
+static int Fuzz(int cases, const char* dir)
+{
+    static UBYTE seeds[SEED_COUNT][MAX_FILE_BYTES];
+    ULONG seedLengths[SEED_COUNT];
+    int results[IMAGE_ERROR_COUNT] = { 0 };
+    int failures = 0;
+
+    for (int s = 0; s < SEED_COUNT; s++)
+    {
+        MakeSeed(s, seeds[s], &seedLengths[s]);
+
+        // Unchanged, every seed has to load
+        BOOL safe;
+        int error = CheckData(seeds[s], seedLengths[s], &safe);
+        if (error != IMAGE_OK || !safe)
+        {
+            printf("seed %d: %s%s\n", s, ImageErrorText(error), safe ? "" : ", wrote outside the planes");
+            failures++;
+        }
+
+        if (dir != NULL)
+            WriteFile(dir, "seed", s, seeds[s], seedLengths[s]);
+    }
+
+    double start = Seconds();
+    for (int c = 0; c < cases; c++)
+    {
+        randomState = 0x9E3779B9UL ^ (ULONG)(c + 1) * 2654435761UL;
+        int s = Random() % SEED_COUNT;
+        ULONG length = Mutate(seeds[s], seedLengths[s], mutated);
+
+        BOOL safe;
+        int error = CheckData(mutated, length, &safe);
+        results[error]++;
+        if (!safe)
+        {
+            printf("case %d (seed %d): wrote outside the planes\n", c, s);
+            if (dir != NULL)
+                WriteFile(dir, "fail", c, mutated, length);
+            failures++;
+        }
+    }
+    double elapsed = Seconds() - start;
+
+    printf("%d cases in %.1f seconds, %d failed\n", cases, elapsed, failures);
+    for (int e = 0; e < IMAGE_ERROR_COUNT; e++)
+    {
+        if (results[e] != 0)
+            printf("  %6d %s\n", results[e], ImageErrorText(e));
+    }
+
+    return failures != 0;
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: ilbmbench [seconds per test] [file...]\n");
+    fprintf(stderr, "       ilbmbench -z [cases] [-w dir]\n");
+    fprintf(stderr, "       ilbmbench -c <file>...\n");
+    fprintf(stderr, "  -z loads cases corrupted from a corpus of generated ILBMs (default 20000)\n");
+    fprintf(stderr, "  at every display size, -w also writes the corpus and failing cases to dir\n");
+    fprintf(stderr, "  -c does the same checks on the files given; both exit 1 if any load\n");
+    fprintf(stderr, "  wrote outside the planes\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-z") == 0)
+    {
+        int cases = 20000;
+        const char* dir = NULL;
+
+        for (int arg = 2; arg < argc; arg++)
+        {
+            if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc)
+                dir = argv[++arg];
+            else if (atoi(argv[arg]) > 0)
+                cases = atoi(argv[arg]);
+            else
+                return Usage();
+        }
+        return Fuzz(cases, dir);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        if (argc < 3)
+            return Usage();
+        return CheckFiles(argc - 2, argv + 2);
+    }
+
+    int first = 1;
+    double seconds = 0.2;
+    if (argc > 1 && atof(argv[1]) > 0)
+    {
+        seconds = atof(argv[1]);
+        first = 2;
+    }
+    else if (argc > 1 && argv[1][0] == '-')
+    {
+        return Usage();
+    }
+
+    if (first < argc)
+        return BenchFiles(argc - first, argv + first, seconds);
+
+    return Bench(seconds);
+}
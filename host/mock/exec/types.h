@@ -0,0 +1,28 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Minimal stand-in for the NDK's exec/types.h so the portable parts of
+// Sparkler can be built on the host.
+
+#ifndef EXEC_TYPES_H
+#define EXEC_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef int16_t WORD;
+typedef uint16_t UWORD;
+typedef int8_t BYTE;
+typedef uint8_t UBYTE;
+typedef int16_t BOOL;
+typedef void* APTR;
+typedef char* STRPTR;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#endif
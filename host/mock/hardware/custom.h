@@ -0,0 +1,147 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Host stand-in for the NDK's hardware/custom.h. Pointer registers are
+// ULONGs so the layout, and with it every register offset, matches the
+// real chipset on 64-bit hosts.
+
+#ifndef HARDWARE_CUSTOM_H
+#define HARDWARE_CUSTOM_H
+
+#include <exec/types.h>
+
+struct AudChannel
+{
+    ULONG ac_ptr;
+    UWORD ac_len;
+    UWORD ac_per;
+    UWORD ac_vol;
+    UWORD ac_dat;
+    UWORD ac_pad[2];
+};
+
+struct SpriteDef
+{
+    UWORD pos;
+    UWORD ctl;
+    UWORD dataa;
+    UWORD datab;
+};
+
+struct Custom
+{
+    UWORD bltddat;
+    UWORD dmaconr;
+    UWORD vposr;
+    UWORD vhposr;
+    UWORD dskdatr;
+    UWORD joy0dat;
+    UWORD joy1dat;
+    UWORD clxdat;
+    UWORD adkconr;
+    UWORD pot0dat;
+    UWORD pot1dat;
+    UWORD potinp;
+    UWORD serdatr;
+    UWORD dskbytr;
+    UWORD intenar;
+    UWORD intreqr;
+    ULONG dskpt;
+    UWORD dsklen;
+    UWORD dskdat;
+    UWORD refptr;
+    UWORD vposw;
+    UWORD vhposw;
+    UWORD copcon;
+    UWORD serdat;
+    UWORD serper;
+    UWORD potgo;
+    UWORD joytest;
+    UWORD strequ;
+    UWORD strvbl;
+    UWORD strhor;
+    UWORD strlong;
+    UWORD bltcon0;
+    UWORD bltcon1;
+    UWORD bltafwm;
+    UWORD bltalwm;
+    ULONG bltcpt;
+    ULONG bltbpt;
+    ULONG bltapt;
+    ULONG bltdpt;
+    UWORD bltsize;
+    UBYTE pad2d;
+    UBYTE bltcon0l;
+    UWORD bltsizv;
+    UWORD bltsizh;
+    UWORD bltcmod;
+    UWORD bltbmod;
+    UWORD bltamod;
+    UWORD bltdmod;
+    UWORD pad34[4];
+    UWORD bltcdat;
+    UWORD bltbdat;
+    UWORD bltadat;
+    UWORD pad3b[3];
+    UWORD deniseid;
+    UWORD dsksync;
+    ULONG cop1lc;
+    ULONG cop2lc;
+    UWORD copjmp1;
+    UWORD copjmp2;
+    UWORD copins;
+    UWORD diwstrt;
+    UWORD diwstop;
+    UWORD ddfstrt;
+    UWORD ddfstop;
+    UWORD dmacon;
+    UWORD clxcon;
+    UWORD intena;
+    UWORD intreq;
+    UWORD adkcon;
+    struct AudChannel aud[4];
+    ULONG bplpt[8];
+    UWORD bplcon0;
+    UWORD bplcon1;
+    UWORD bplcon2;
+    UWORD bplcon3;
+    UWORD bpl1mod;
+    UWORD bpl2mod;
+    UWORD bplcon4;
+    UWORD clxcon2;
+    UWORD bpldat[8];
+    ULONG sprpt[8];
+    struct SpriteDef spr[8];
+    UWORD color[32];
+    UWORD htotal;
+    UWORD hsstop;
+    UWORD hbstrt;
+    UWORD hbstop;
+    UWORD vtotal;
+    UWORD vsstop;
+    UWORD vbstrt;
+    UWORD vbstop;
+    UWORD sprhstrt;
+    UWORD sprhstop;
+    UWORD bplhstrt;
+    UWORD bplhstop;
+    UWORD hhposw;
+    UWORD hhposr;
+    UWORD beamcon0;
+    UWORD hsstrt;
+    UWORD vsstrt;
+    UWORD hcenter;
+    UWORD diwhigh;
+    UWORD padf3[11];
+    UWORD fmode;
+};
+
+// Catch layout mistakes against the hardware reference manual
+_Static_assert(offsetof(struct Custom, cop1lc) == 0x080, "cop1lc");
+_Static_assert(offsetof(struct Custom, diwstrt) == 0x08E, "diwstrt");
+_Static_assert(offsetof(struct Custom, bplpt) == 0x0E0, "bplpt");
+_Static_assert(offsetof(struct Custom, bplcon0) == 0x100, "bplcon0");
+_Static_assert(offsetof(struct Custom, sprpt) == 0x120, "sprpt");
+_Static_assert(offsetof(struct Custom, color) == 0x180, "color");
+_Static_assert(offsetof(struct Custom, beamcon0) == 0x1DC, "beamcon0");
+_Static_assert(offsetof(struct Custom, fmode) == 0x1FC, "fmode");
+
+#endif
@@ -0,0 +1,199 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Host benchmark for the pattern generator. Reports bytes/second for every
+// line mode at the common Sparkler resolutions, built into four planes as
+// Sparkler builds its bitmaps, next to the original byte-at-a-time column
+// loop for one plane. Also checks the patterns against that loop, and
+// reports the speed of four-plane noise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pattern.h"
+
+// The column-major loop createBitmap() used before pattern.c
+static void LegacyFill(UBYTE* plane, int width, int height, int lineMode)
+{
+    int bytesPerLine = width/8;
+    int xCounter = 0;
+    for (int x=0; x < bytesPerLine; x++)
+    {
+        BOOL evenLine = TRUE;
+        for (int y=0; y < height; y++)
+        {
+            int index = (y * bytesPerLine) + x;
+
+            if (y == height - 1)
+                plane[index] = 0xff;
+            else if (lineMode == 1)
+                plane[index] = evenLine ? 0x55 : 0xAA;
+            else if (lineMode == 2)
+                plane[index] = 0xAA;
+            else if (lineMode == 3)
+                plane[index] = evenLine ? 0xFF : 0x00;
+            else if (lineMode == 4)
+                plane[index] = 0xff;
+            else if (lineMode == 5)
+            {
+                static const UBYTE bars[] = { 0x92, 0x49, 0x24 };
+                plane[index] = bars[xCounter];
+            }
+            else if (lineMode == 6)
+                plane[index] = 0x88;
+            else if (lineMode == 7)
+            {
+                static const UBYTE bars[] = { 0x84, 0x21, 0x8, 0x42, 0x10 };
+                plane[index] = bars[xCounter];
+            }
+
+            evenLine = !evenLine;
+        }
+        xCounter++;
+        if (lineMode == 5 && xCounter == 3)
+            xCounter = 0;
+        if (lineMode == 7 && xCounter == 5)
+            xCounter = 0;
+    }
+}
+
+static double Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Returns bytes/second of one plane for one generator, running it for at
+// least minSeconds. The row generator writes all four planes each time.
+static double Measure(BOOL legacy, UBYTE** planes, int width, int height, int lineMode, double minSeconds)
+{
+    size_t bytes = (size_t)(width / 8) * height;
+    long runs = 0;
+    double start = Now();
+    double elapsed;
+
+    do
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            if (legacy)
+                LegacyFill(planes[0], width, height, lineMode);
+            else
+                FillPatternPlanes(planes, 4, width / 8, height, lineMode, 0);
+        }
+        runs += 16;
+        elapsed = Now() - start;
+    } while (elapsed < minSeconds);
+
+    return (double)bytes * runs / elapsed;
+}
+
+// Four-plane noise bitmaps per second, a new seed for each
+static double MeasureNoise(UBYTE** planes, int width, int height, double minSeconds)
+{
+    long runs = 0;
+    double start = Now();
+    double elapsed;
+
+    do
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            FillPatternPlanes(planes, 4, width / 8, height, PATTERN_NOISE, (ULONG)(runs + i + 1));
+        }
+        runs += 16;
+        elapsed = Now() - start;
+    } while (elapsed < minSeconds);
+
+    return runs / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    static const int sizes[][2] = { { 320, 200 }, { 640, 256 }, { 640, 512 } };
+    double minSeconds = argc > 1 ? atof(argv[1]) : 0.2;
+    int failures = 0;
+
+    printf("%-9s %4s %14s %14s %8s\n", "size", "mode", "row B/s", "legacy B/s", "speedup");
+
+    for (int s = 0; s < 3; s++)
+    {
+        int width = sizes[s][0];
+        int height = sizes[s][1];
+        size_t bytes = (size_t)(width / 8) * height;
+
+        // malloc alignment covers the longword requirement
+        UBYTE* planes[4];
+        for (int p = 0; p < 4; p++)
+        {
+            planes[p] = calloc(1, bytes);
+        }
+        UBYTE* expected = calloc(1, bytes);
+        UBYTE* clear = calloc(1, bytes);
+
+        for (int mode = 1; mode <= PATTERN_MODE_COUNT; mode++)
+        {
+            memset(expected, 0, bytes);
+            LegacyFill(expected, width, height, mode);
+            for (int p = 0; p < 4; p++)
+            {
+                memset(planes[p], 0xCC, bytes);
+            }
+            FillPatternPlanes(planes, 4, width / 8, height, mode, 0);
+
+            // The pattern is in plane 0 and the others are cleared
+            BOOL same = memcmp(planes[0], expected, bytes) == 0;
+            for (int p = 1; p < 4; p++)
+            {
+                same = same && memcmp(planes[p], clear, bytes) == 0;
+            }
+            if (!same)
+            {
+                printf("%dx%d mode %d: output differs from the legacy loop\n", width, height, mode);
+                failures++;
+            }
+
+            double fast = Measure(FALSE, planes, width, height, mode, minSeconds);
+            double slow = Measure(TRUE, planes, width, height, mode, minSeconds);
+
+            char size[16];
+            sprintf(size, "%dx%d", width, height);
+            printf("%-9s %4d %14.0f %14.0f %7.1fx\n", size, mode, fast, slow, fast / slow);
+        }
+
+        for (int p = 0; p < 4; p++)
+        {
+            free(planes[p]);
+        }
+        free(expected);
+        free(clear);
+    }
+
+    printf("\n%-9s %14s %14s\n", "size", "noise B/s", "frames/s");
+    for (int s = 0; s < 3; s++)
+    {
+        int width = sizes[s][0];
+        int height = sizes[s][1];
+        size_t bytes = (size_t)(width / 8) * height;
+
+        UBYTE* planes[4];
+        for (int p = 0; p < 4; p++)
+        {
+            planes[p] = calloc(1, bytes);
+        }
+
+        double frames = MeasureNoise(planes, width, height, minSeconds);
+
+        char size[16];
+        sprintf(size, "%dx%d", width, height);
+        printf("%-9s %14.0f %14.0f\n", size, frames * bytes * 4, frames);
+
+        for (int p = 0; p < 4; p++)
+        {
+            free(planes[p]);
+        }
+    }
+
+    return failures ? 1 : 0;
+}
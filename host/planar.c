@@ -0,0 +1,315 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Planar/chunky conversion, see planar.h
+
+#include <string.h>
+#include <stdint.h>
+
+#include "planar.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PLANAR_X86 1
+#include <immintrin.h>
+#endif
+
+// One row: bytes of each plane starting at byte start, 8 chunky pixels each
+typedef void (*P2cRowFunc)(const UBYTE* const* rows, int depth, int start, int bytes, UBYTE* chunky);
+typedef void (*C2pRowFunc)(const UBYTE* chunky, int start, int bytes, UBYTE* const* rows, int depth);
+
+// Byte of plane data to eight pixels of 0 or 1, leftmost pixel first in
+// memory
+static uint64_t expand[256];
+
+// Bit order reversed, for movemask results that have the leftmost pixel
+// in bit 0
+static UBYTE reverse[256];
+
+static P2cRowFunc p2cRow = NULL;
+static C2pRowFunc c2pRow = NULL;
+static int currentPath = PLANAR_SCALAR;
+static BOOL ready = FALSE;
+
+static void P2cRowScalar(const UBYTE* const* rows, int depth, int start, int bytes, UBYTE* chunky)
+{
+    for (int i = start; i < bytes; i++)
+    {
+        uint64_t pixels = 0;
+        for (int p = 0; p < depth; p++)
+        {
+            pixels |= expand[rows[p][i]] << p;
+        }
+        memcpy(chunky + (i * 8), &pixels, 8);
+    }
+}
+
+static void C2pRowScalar(const UBYTE* chunky, int start, int bytes, UBYTE* const* rows, int depth)
+{
+    for (int i = start; i < bytes; i++)
+    {
+        uint64_t pixels;
+        memcpy(&pixels, chunky + (i * 8), 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        pixels = __builtin_bswap64(pixels);
+#endif
+
+        // The multiply moves bit 0 of byte n to bit 63 - n with no carries
+        // between the terms, so the top byte is the plane byte
+        for (int p = 0; p < depth; p++)
+        {
+            uint64_t bits = (pixels >> p) & 0x0101010101010101ULL;
+            rows[p][i] = (UBYTE)((bits * 0x8040201008040201ULL) >> 56);
+        }
+    }
+}
+
+#ifdef PLANAR_X86
+
+// 128 pixels per step: every plane byte is spread over eight lanes, and
+// lanes whose bit is set get the plane's bit
+__attribute__((target("sse2")))
+static void P2cRowSse2(const UBYTE* const* rows, int depth, int start, int bytes, UBYTE* chunky)
+{
+    const __m128i mask = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1);
+    int i = start;
+
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i acc[8];
+        for (int k = 0; k < 8; k++)
+        {
+            acc[k] = _mm_setzero_si128();
+        }
+
+        for (int p = 0; p < depth; p++)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i*)(rows[p] + i));
+            __m128i bit = _mm_set1_epi8((char)(1 << p));
+            __m128i pairs[2] = { _mm_unpacklo_epi8(x, x), _mm_unpackhi_epi8(x, x) };
+
+            for (int h = 0; h < 2; h++)
+            {
+                __m128i quads[2] = { _mm_unpacklo_epi16(pairs[h], pairs[h]), _mm_unpackhi_epi16(pairs[h], pairs[h]) };
+
+                for (int q = 0; q < 2; q++)
+                {
+                    __m128i spread[2] = { _mm_unpacklo_epi32(quads[q], quads[q]), _mm_unpackhi_epi32(quads[q], quads[q]) };
+
+                    for (int s = 0; s < 2; s++)
+                    {
+                        int k = (h * 4) + (q * 2) + s;
+                        __m128i set = _mm_cmpeq_epi8(_mm_and_si128(spread[s], mask), mask);
+                        acc[k] = _mm_or_si128(acc[k], _mm_and_si128(set, bit));
+                    }
+                }
+            }
+        }
+
+        for (int k = 0; k < 8; k++)
+        {
+            _mm_storeu_si128((__m128i*)(chunky + (i * 8) + (k * 16)), acc[k]);
+        }
+    }
+
+    P2cRowScalar(rows, depth, i, bytes, chunky);
+}
+
+// 16 pixels per step: shift plane bit p to bit 7 of each lane and collect
+// the lanes with movemask
+__attribute__((target("sse2")))
+static void C2pRowSse2(const UBYTE* chunky, int start, int bytes, UBYTE* const* rows, int depth)
+{
+    int i = start;
+
+    for (; i + 2 <= bytes; i += 2)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(chunky + (i * 8)));
+
+        for (int p = 0; p < depth; p++)
+        {
+            int bits = _mm_movemask_epi8(_mm_slli_epi16(x, 7 - p));
+            rows[p][i] = reverse[bits & 0xFF];
+            rows[p][i + 1] = reverse[bits >> 8];
+        }
+    }
+
+    C2pRowScalar(chunky, i, bytes, rows, depth);
+}
+
+// 32 pixels per vector: four plane bytes are broadcast and shuffled so
+// each lane holds the byte for its pixel
+__attribute__((target("avx2")))
+static void P2cRowAvx2(const UBYTE* const* rows, int depth, int start, int bytes, UBYTE* chunky)
+{
+    const __m256i mask = _mm256_setr_epi8(
+        (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1,
+        (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1);
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    int i = start;
+
+    for (; i + 4 <= bytes; i += 4)
+    {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int p = 0; p < depth; p++)
+        {
+            int32_t four;
+            memcpy(&four, rows[p] + i, 4);
+
+            __m256i x = _mm256_shuffle_epi8(_mm256_set1_epi32(four), spread);
+            __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(x, mask), mask);
+            acc = _mm256_or_si256(acc, _mm256_and_si256(set, _mm256_set1_epi8((char)(1 << p))));
+        }
+
+        _mm256_storeu_si256((__m256i*)(chunky + (i * 8)), acc);
+    }
+
+    P2cRowScalar(rows, depth, i, bytes, chunky);
+}
+
+// 32 pixels per step. Pixels are reversed within each group of eight first,
+// so movemask gives the plane bytes in Amiga bit order.
+__attribute__((target("avx2")))
+static void C2pRowAvx2(const UBYTE* chunky, int start, int bytes, UBYTE* const* rows, int depth)
+{
+    const __m256i flip = _mm256_setr_epi8(
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    int i = start;
+
+    for (; i + 4 <= bytes; i += 4)
+    {
+        __m256i x = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(chunky + (i * 8))), flip);
+
+        for (int p = 0; p < depth; p++)
+        {
+            int32_t bits = _mm256_movemask_epi8(_mm256_slli_epi16(x, 7 - p));
+            memcpy(rows[p] + i, &bits, 4);
+        }
+    }
+
+    C2pRowScalar(chunky, i, bytes, rows, depth);
+}
+
+#endif
+
+// Build the tables and pick the fastest path
+static void Init()
+{
+    if (ready)
+        return;
+
+    ready = TRUE;
+    for (int b = 0; b < 256; b++)
+    {
+        UBYTE pixels[8];
+        UBYTE reversed = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            pixels[i] = (b >> (7 - i)) & 1;
+            reversed |= ((b >> i) & 1) << (7 - i);
+        }
+        memcpy(&expand[b], pixels, 8);
+        reverse[b] = reversed;
+    }
+
+    PlanarSelectPath(PlanarPathSupported(PLANAR_AVX2) ? PLANAR_AVX2 : PlanarPathSupported(PLANAR_SSE2) ? PLANAR_SSE2 : PLANAR_SCALAR);
+}
+
+BOOL PlanarPathSupported(int path)
+{
+    switch (path)
+    {
+    case PLANAR_SCALAR:
+        return TRUE;
+#ifdef PLANAR_X86
+    case PLANAR_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2") != 0;
+    case PLANAR_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+BOOL PlanarSelectPath(int path)
+{
+    Init();
+
+    if (!PlanarPathSupported(path))
+        return FALSE;
+
+    switch (path)
+    {
+#ifdef PLANAR_X86
+    case PLANAR_SSE2:
+        p2cRow = P2cRowSse2;
+        c2pRow = C2pRowSse2;
+        break;
+    case PLANAR_AVX2:
+        p2cRow = P2cRowAvx2;
+        c2pRow = C2pRowAvx2;
+        break;
+#endif
+    default:
+        p2cRow = P2cRowScalar;
+        c2pRow = C2pRowScalar;
+        break;
+    }
+
+    currentPath = path;
+    return TRUE;
+}
+
+int PlanarCurrentPath()
+{
+    Init();
+    return currentPath;
+}
+
+const char* PlanarPathName(int path)
+{
+    static const char* names[PLANAR_PATH_COUNT] = { "scalar", "sse2", "avx2" };
+    return path >= 0 && path < PLANAR_PATH_COUNT ? names[path] : "?";
+}
+
+void PlanarToChunky(const UBYTE* const* planes, int depth, int bytesPerRow, int width, int height, UBYTE* chunky, int chunkyStride)
+{
+    Init();
+
+    const UBYTE* rows[PLANAR_MAX_DEPTH];
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int p = 0; p < depth; p++)
+        {
+            rows[p] = planes[p] + ((long)y * bytesPerRow);
+        }
+
+        UBYTE* out = chunky + ((long)y * chunkyStride);
+        if (depth == 0)
+            memset(out, 0, width);
+        else
+            p2cRow(rows, depth, 0, width / 8, out);
+    }
+}
+
+void ChunkyToPlanar(const UBYTE* chunky, int chunkyStride, int width, int height, UBYTE* const* planes, int depth, int bytesPerRow)
+{
+    Init();
+
+    UBYTE* rows[PLANAR_MAX_DEPTH];
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int p = 0; p < depth; p++)
+        {
+            rows[p] = planes[p] + ((long)y * bytesPerRow);
+        }
+
+        c2pRow(chunky + ((long)y * chunkyStride), 0, width / 8, rows, depth);
+    }
+}
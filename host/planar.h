@@ -0,0 +1,37 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Planar to chunky and back for the host tools. Planar data is laid out like
+// an Amiga BitMap: each plane its own rows, leftmost pixel in bit 7. Chunky
+// data is one byte per pixel with plane n in bit n. Scalar, SSE2 and AVX2
+// versions; the fastest one the CPU has is picked on first use.
+
+#ifndef SPARKLER_PLANAR_H
+#define SPARKLER_PLANAR_H
+
+#include <exec/types.h>
+
+#define PLANAR_MAX_DEPTH 8
+
+enum PlanarPath
+{
+    PLANAR_SCALAR,
+    PLANAR_SSE2,
+    PLANAR_AVX2,
+    PLANAR_PATH_COUNT
+};
+
+// Width is in pixels and a multiple of 8. Plane bits above depth are zero
+// in the chunky output and ignored in the chunky input.
+void PlanarToChunky(const UBYTE* const* planes, int depth, int bytesPerRow, int width, int height, UBYTE* chunky, int chunkyStride);
+void ChunkyToPlanar(const UBYTE* chunky, int chunkyStride, int width, int height, UBYTE* const* planes, int depth, int bytesPerRow);
+
+// Whether this CPU can run a path
+BOOL PlanarPathSupported(int path);
+
+// Use path from now on, for benchmarks and checks. Returns FALSE and
+// keeps the current one if the CPU lacks it.
+BOOL PlanarSelectPath(int path);
+
+int PlanarCurrentPath(void);
+const char* PlanarPathName(int path);
+
+#endif
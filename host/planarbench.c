@@ -0,0 +1,255 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Reports planar/chunky conversion speed of every path the CPU has for
+// 1-8 planes at every Sparkler resolution. With -c, checks every path
+// against a bit at a time conversion instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "planar.h"
+
+#define MAX_WIDTH 640
+#define MAX_HEIGHT 512
+#define GUARD 0xA5
+
+static UBYTE planeData[PLANAR_MAX_DEPTH][(MAX_WIDTH / 8 + 8) * MAX_HEIGHT];
+static UBYTE planeCheck[PLANAR_MAX_DEPTH][(MAX_WIDTH / 8 + 8) * MAX_HEIGHT];
+static UBYTE chunky[(MAX_WIDTH + 16) * MAX_HEIGHT];
+static UBYTE chunkyCheck[(MAX_WIDTH + 16) * MAX_HEIGHT];
+
+static const int resolutions[][2] =
+{
+    { 320, 200 }, { 320, 256 }, { 320, 400 }, { 320, 512 },
+    { 640, 200 }, { 640, 256 }, { 640, 400 }, { 640, 512 },
+};
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static ULONG randomState = 12345;
+
+static UBYTE Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (UBYTE)randomState;
+}
+
+static void PlanePointers(UBYTE* planes[], UBYTE data[][(MAX_WIDTH / 8 + 8) * MAX_HEIGHT])
+{
+    for (int p = 0; p < PLANAR_MAX_DEPTH; p++)
+    {
+        planes[p] = data[p];
+    }
+}
+
+// Pixel by pixel, the way the hardware reads the planes
+static void ReferenceToChunky(UBYTE* const* planes, int depth, int bytesPerRow, int width, int height, UBYTE* out, int stride)
+{
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            UBYTE index = 0;
+            for (int p = 0; p < depth; p++)
+            {
+                index |= ((planes[p][(y * bytesPerRow) + (x / 8)] >> (7 - (x % 8))) & 1) << p;
+            }
+            out[(y * stride) + x] = index;
+        }
+    }
+}
+
+// Converts planeData both ways with the current path and compares against
+// the reference. Rows are padded so writes past the width are caught.
+static int CheckFrame(int depth, int width, int height)
+{
+    int bytesPerRow = (width / 8) + 3;
+    int stride = width + 7;
+    UBYTE* planes[PLANAR_MAX_DEPTH];
+    UBYTE* checkPlanes[PLANAR_MAX_DEPTH];
+    PlanePointers(planes, planeData);
+    PlanePointers(checkPlanes, planeCheck);
+
+    int errors = 0;
+
+    ReferenceToChunky(planes, depth, bytesPerRow, width, height, chunkyCheck, stride);
+    memset(chunky, GUARD, sizeof(chunky));
+    PlanarToChunky((const UBYTE* const*)planes, depth, bytesPerRow, width, height, chunky, stride);
+
+    for (int y = 0; y < height; y++)
+    {
+        errors += memcmp(chunky + (y * stride), chunkyCheck + (y * stride), width) != 0;
+        for (int x = width; x < stride; x++)
+        {
+            errors += chunky[(y * stride) + x] != GUARD;
+        }
+    }
+
+    // Back again: the planes must come out as they went in
+    for (int p = 0; p < depth; p++)
+    {
+        memset(planeCheck[p], GUARD, sizeof(planeCheck[p]));
+    }
+    ChunkyToPlanar(chunkyCheck, stride, width, height, checkPlanes, depth, bytesPerRow);
+
+    for (int p = 0; p < depth; p++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            const UBYTE* row = planeCheck[p] + (y * bytesPerRow);
+            errors += memcmp(row, planeData[p] + (y * bytesPerRow), width / 8) != 0;
+            for (int x = width / 8; x < bytesPerRow; x++)
+            {
+                errors += row[x] != GUARD;
+            }
+        }
+    }
+
+    return errors;
+}
+
+static int Check()
+{
+    int failed = 0;
+
+    for (int path = 0; path < PLANAR_PATH_COUNT; path++)
+    {
+        if (!PlanarSelectPath(path))
+        {
+            printf("%-6s not supported by this CPU\n", PlanarPathName(path));
+            continue;
+        }
+
+        int errors = 0;
+        int frames = 0;
+
+        // Every plane byte value at every byte offset within a vector,
+        // in every plane, for every depth
+        for (int depth = 1; depth <= PLANAR_MAX_DEPTH; depth++)
+        {
+            for (int shift = 0; shift < 256; shift++)
+            {
+                for (int p = 0; p < depth; p++)
+                {
+                    for (int i = 0; i < (256 / 8 + 3) * 2; i++)
+                    {
+                        planeData[p][i] = (UBYTE)(i + shift + (p * 37));
+                    }
+                }
+                errors += CheckFrame(depth, 256, 2);
+                frames++;
+            }
+        }
+
+        // Random data at every width up to 640, so every tail length is hit
+        for (int depth = 1; depth <= PLANAR_MAX_DEPTH; depth++)
+        {
+            for (int width = 8; width <= MAX_WIDTH; width += 8)
+            {
+                for (int p = 0; p < depth; p++)
+                {
+                    for (int i = 0; i < ((width / 8) + 3) * 4; i++)
+                    {
+                        planeData[p][i] = Random();
+                    }
+                }
+                errors += CheckFrame(depth, width, 4);
+                frames++;
+            }
+        }
+
+        printf("%-6s %d frames checked, %d errors\n", PlanarPathName(path), frames, errors);
+        failed |= errors != 0;
+    }
+
+    return failed;
+}
+
+// Megapixels per second of the current path, timed for at least seconds
+static double Rate(BOOL toChunky, int depth, int width, int height, double seconds)
+{
+    UBYTE* planes[PLANAR_MAX_DEPTH];
+    PlanePointers(planes, planeData);
+
+    long frames = 0;
+    double start = Seconds();
+    double elapsed;
+
+    do
+    {
+        if (toChunky)
+            PlanarToChunky((const UBYTE* const*)planes, depth, width / 8, width, height, chunky, width);
+        else
+            ChunkyToPlanar(chunky, width, width, height, planes, depth, width / 8);
+
+        frames++;
+        elapsed = Seconds() - start;
+    }
+    while (elapsed < seconds);
+
+    return ((double)frames * width * height) / (elapsed * 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        return Check();
+    }
+
+    double seconds = argc > 1 ? atof(argv[1]) : 0.05;
+    if (seconds <= 0)
+    {
+        fprintf(stderr, "usage: planarbench [seconds per test] | -c\n");
+        return 1;
+    }
+
+    for (int p = 0; p < PLANAR_MAX_DEPTH; p++)
+    {
+        for (int i = 0; i < (int)sizeof(planeData[p]); i++)
+        {
+            planeData[p][i] = Random();
+        }
+    }
+
+    printf("Megapixels/second, planar to chunky / chunky to planar\n");
+    printf("%-12s", "");
+    for (int path = 0; path < PLANAR_PATH_COUNT; path++)
+    {
+        if (PlanarPathSupported(path))
+            printf(" %17s", PlanarPathName(path));
+    }
+    printf("\n");
+
+    for (int r = 0; r < (int)(sizeof(resolutions) / sizeof(resolutions[0])); r++)
+    {
+        int width = resolutions[r][0];
+        int height = resolutions[r][1];
+
+        for (int depth = 1; depth <= PLANAR_MAX_DEPTH; depth++)
+        {
+            printf("%dx%d d%d ", width, height, depth);
+
+            for (int path = 0; path < PLANAR_PATH_COUNT; path++)
+            {
+                if (!PlanarSelectPath(path))
+                    continue;
+
+                double p2c = Rate(TRUE, depth, width, height, seconds);
+                double c2p = Rate(FALSE, depth, width, height, seconds);
+                printf(" %8.0f /%7.0f", p2c, c2p);
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
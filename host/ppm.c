@@ -0,0 +1,89 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// PPM files, see ppm.h
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ppm.h"
+
+BOOL PpmWrite(const char* name, const uint32_t* pixels, int width, int height)
+{
+    FILE* f = fopen(name, "wb");
+    if (f == NULL)
+        return FALSE;
+
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    for (long i = 0; i < (long)width * height; i++)
+    {
+        uint32_t rgb = pixels[i];
+        fputc((rgb >> 16) & 0xFF, f);
+        fputc((rgb >> 8) & 0xFF, f);
+        fputc(rgb & 0xFF, f);
+    }
+
+    return fclose(f) == 0;
+}
+
+// Next header number, skipping white space and comments
+static int ReadNumber(FILE* f)
+{
+    int c = fgetc(f);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+                c = fgetc(f);
+        }
+        c = fgetc(f);
+    }
+
+    int value = -1;
+    while (c >= '0' && c <= '9')
+    {
+        value = (value < 0 ? 0 : value * 10) + (c - '0');
+        c = fgetc(f);
+    }
+
+    // one white space character ends the number
+    return value;
+}
+
+uint32_t* PpmRead(const char* name, int* width, int* height)
+{
+    FILE* f = fopen(name, "rb");
+    if (f == NULL)
+        return NULL;
+
+    uint32_t* pixels = NULL;
+    if (fgetc(f) == 'P' && fgetc(f) == '6')
+    {
+        int w = ReadNumber(f);
+        int h = ReadNumber(f);
+        int maxValue = ReadNumber(f);
+
+        if (w > 0 && h > 0 && w <= 16384 && h <= 16384 && maxValue == 255)
+        {
+            pixels = (uint32_t*)malloc((size_t)w * h * sizeof(uint32_t));
+            for (long i = 0; pixels != NULL && i < (long)w * h; i++)
+            {
+                int r = fgetc(f);
+                int g = fgetc(f);
+                int b = fgetc(f);
+                if (b == EOF)
+                {
+                    free(pixels);
+                    pixels = NULL;
+                    break;
+                }
+                pixels[i] = ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
+            }
+
+            *width = w;
+            *height = h;
+        }
+    }
+
+    fclose(f);
+    return pixels;
+}
@@ -0,0 +1,16 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Binary PPM (P6) files to and from 0x00RRGGBB pixels, for the host tools
+
+#ifndef SPARKLER_PPM_H
+#define SPARKLER_PPM_H
+
+#include <stdint.h>
+#include <exec/types.h>
+
+BOOL PpmWrite(const char* name, const uint32_t* pixels, int width, int height);
+
+// Returns pixels allocated with malloc, or NULL if the file can't be read
+// or is not an 8-bit P6 image
+uint32_t* PpmRead(const char* name, int* width, int* height);
+
+#endif
@@ -0,0 +1,113 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Writes the picture the reference renderer expects Sparkler to show for a
+// mode, one PPM per field. With -b, times the renderer instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "expected.h"
+#include "ppm.h"
+#include "render.h"
+
+static struct RenderFrame frames[2];
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: refframe [-b frames] [-q] [-m x,y] <320|640> <200|256|400|512> <pattern> [c0 c1] [prefix]\n");
+    fprintf(stderr, "  pattern is 1-7, 8-10 for De Bruijn of order 2-4, 11-14 for multi-plane,\n");
+    fprintf(stderr, "  or N:<seed> for noise as the HUD shows it\n");
+    fprintf(stderr, "  writes prefix-field0.ppm, and prefix-field1.ppm when interlaced\n");
+    fprintf(stderr, "  -b times the renderer instead, -q leaves the HUD out\n");
+    fprintf(stderr, "  -m scrolls to x BPLCON1 steps and y rows, as Sparkler does on M\n");
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    int benchFrames = 0;
+    BOOL showHud = TRUE;
+    BOOL scroll = FALSE;
+    unsigned long scrollX = 0;
+    unsigned long scrollY = 0;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc)
+            benchFrames = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-q") == 0)
+            showHud = FALSE;
+        else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc)
+        {
+            if (sscanf(argv[++arg], "%lu,%lu", &scrollX, &scrollY) != 2)
+                return Usage();
+            scroll = TRUE;
+        }
+        else
+            return Usage();
+    }
+
+    struct ExpectedState state;
+    int used = ExpectedParse(&state, argc - arg, argv + arg);
+    if (used == 0)
+        return Usage();
+
+    arg += used;
+    const char* prefix = arg < argc ? argv[arg] : "ref";
+    state.hud = showHud;
+    state.scroll = scroll;
+    state.scrollX = scrollX;
+    state.scrollY = scrollY;
+
+    int fields = ExpectedBuild(&state);
+    if (fields == 0)
+    {
+        fprintf(stderr, "copper list overflow\n");
+        return 1;
+    }
+
+    if (benchFrames > 0)
+    {
+        double start = Seconds();
+        for (int i = 0; i < benchFrames; i++)
+        {
+            for (int field = 0; field < fields; field++)
+            {
+                ExpectedRenderField(field, &frames[field]);
+            }
+        }
+        double elapsed = Seconds() - start;
+
+        printf("%dx%d: %d fields of %dx%d, %.1f us per frame\n", state.width, state.height, fields, frames[0].width, frames[0].height, (elapsed * 1e6) / benchFrames);
+        return 0;
+    }
+
+    for (int field = 0; field < fields; field++)
+    {
+        if (!ExpectedRenderField(field, &frames[field]))
+        {
+            fprintf(stderr, "copper ran off the end of chip RAM in field %d\n", field);
+            return 1;
+        }
+
+        char name[256];
+        snprintf(name, sizeof(name), "%s-field%d.ppm", prefix, field);
+        if (!PpmWrite(name, frames[field].pixels, frames[field].width, frames[field].height))
+        {
+            fprintf(stderr, "can't write %s\n", name);
+            return 1;
+        }
+        printf("%s: %dx%d\n", name, frames[field].width, frames[field].height);
+    }
+
+    return 0;
+}
@@ -0,0 +1,326 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Reference renderer, see render.h
+
+#include <string.h>
+
+#include "copper.h"
+#include "render.h"
+
+#define LINE_CLOCKS 227         // color clocks per line
+#define COPPER_CLOCKS 4         // per instruction, two word fetches
+#define COPPER_WAKE_CLOCKS 2    // a WAIT that waited takes a cycle to wake
+#define MAX_PLANES 6
+#define LINE_PAD 32             // output pixels kept either side of a line
+#define BLANK_LINES 20          // vertical blank, no window opens in it
+
+struct Registers
+{
+    UWORD bplcon0;
+    UWORD bplcon1;
+    WORD bpl1mod;
+    WORD bpl2mod;
+    UWORD ddfstrt;
+    UWORD ddfstop;
+    UWORD diwstrt;
+    UWORD diwstop;
+    uint32_t bplpt[MAX_PLANES];
+    uint32_t cop1lc;
+    uint32_t cop2lc;
+    uint32_t rgb[32];           // COLORxx already converted
+};
+
+struct RenderState
+{
+    const uint8_t* chip;
+    uint32_t chipSize;
+    int frameLines;
+    struct Registers regs;
+
+    uint32_t pc;
+    long time;                  // beam position of the next instruction
+    BOOL stopped;
+    BOOL fault;
+};
+
+// Byte of plane data to eight pixels of 0 or 1, leftmost pixel first in
+// memory
+static uint64_t expand[256];
+static BOOL expandReady = FALSE;
+
+static void InitExpand()
+{
+    for (int b = 0; b < 256; b++)
+    {
+        uint8_t pixels[8];
+        for (int i = 0; i < 8; i++)
+        {
+            pixels[i] = (b >> (7 - i)) & 1;
+        }
+        memcpy(&expand[b], pixels, 8);
+    }
+    expandReady = TRUE;
+}
+
+static UWORD ReadWord(const struct RenderState* s, uint32_t addr)
+{
+    return (UWORD)((s->chip[addr] << 8) | s->chip[addr + 1]);
+}
+
+static void SetHigh(uint32_t* reg, UWORD value)
+{
+    *reg = (*reg & 0xFFFF) | ((uint32_t)value << 16);
+}
+
+static void SetLow(uint32_t* reg, UWORD value)
+{
+    *reg = (*reg & 0xFFFF0000) | (value & 0xFFFE);
+}
+
+static void WriteRegister(struct RenderState* s, UWORD reg, UWORD value)
+{
+    struct Registers* r = &s->regs;
+
+    if (reg >= COPREG(color) && reg < COPREG(color) + 64)
+    {
+        r->rgb[(reg - COPREG(color)) / 2] = RENDER_RGB(value);
+        return;
+    }
+
+    if (reg >= COPREG(bplpt) && reg < COPREG(bplpt) + (MAX_PLANES * 4))
+    {
+        int plane = (reg - COPREG(bplpt)) / 4;
+        if (reg & 2)
+            SetLow(&r->bplpt[plane], value);
+        else
+            SetHigh(&r->bplpt[plane], value);
+        return;
+    }
+
+    switch (reg)
+    {
+    case COPREG(bplcon0): r->bplcon0 = value; break;
+    case COPREG(bplcon1): r->bplcon1 = value; break;
+    case COPREG(bpl1mod): r->bpl1mod = (WORD)value; break;
+    case COPREG(bpl2mod): r->bpl2mod = (WORD)value; break;
+    case COPREG(ddfstrt): r->ddfstrt = value & 0xFC; break;
+    case COPREG(ddfstop): r->ddfstop = value & 0xFC; break;
+    case COPREG(diwstrt): r->diwstrt = value; break;
+    case COPREG(diwstop): r->diwstop = value; break;
+    case COPREG(cop1lc): SetHigh(&r->cop1lc, value); break;
+    case COPREG(cop1lc) + 2: SetLow(&r->cop1lc, value); break;
+    case COPREG(cop2lc): SetHigh(&r->cop2lc, value); break;
+    case COPREG(cop2lc) + 2: SetLow(&r->cop2lc, value); break;
+    case COPREG(copjmp1): s->pc = r->cop1lc; break;
+    case COPREG(copjmp2): s->pc = r->cop2lc; break;
+    default: break;             // not part of the picture
+    }
+}
+
+// First beam position at or after time where the WAIT or SKIP compare is
+// true, or -1 if that never happens this field. Only 8 bits of vpos are
+// compared, so after line 255 the compare starts from 0 again.
+static long CompareTarget(const struct RenderState* s, long time, UWORD first, UWORD second)
+{
+    int vmask = ((second >> 8) & 0x7F) | 0x80;
+    int hmask = second & 0xFE;
+    int waitV = (first >> 8) & vmask;
+    int waitH = first & hmask;
+
+    for (int line = (int)(time / LINE_CLOCKS); line < s->frameLines; line++)
+    {
+        int startH = line == time / LINE_CLOCKS ? (int)(time % LINE_CLOCKS) : 0;
+        int beamV = line & 0xFF & vmask;
+
+        if (beamV > waitV)
+            return ((long)line * LINE_CLOCKS) + startH;
+
+        if (beamV < waitV)
+            continue;
+
+        if (hmask == 0xFE)
+        {
+            int h = startH > waitH ? startH : waitH;
+            if (h < LINE_CLOCKS)
+                return ((long)line * LINE_CLOCKS) + h;
+            continue;
+        }
+
+        for (int h = startH; h < LINE_CLOCKS; h++)
+        {
+            if ((h & hmask) >= waitH)
+                return ((long)line * LINE_CLOCKS) + h;
+        }
+    }
+
+    return -1;
+}
+
+// Run the copper until the beam reaches limit. Registers below 0x80 stop
+// it, as they do with the COPCON danger bit clear.
+static void RunCopper(struct RenderState* s, long limit)
+{
+    while (!s->stopped && s->time < limit)
+    {
+        if (s->pc + 4 > s->chipSize)
+        {
+            s->stopped = TRUE;
+            s->fault = TRUE;
+            return;
+        }
+
+        UWORD first = ReadWord(s, s->pc);
+        UWORD second = ReadWord(s, s->pc + 2);
+        s->pc += 4;
+
+        if ((first & 1) == 0)
+        {
+            UWORD reg = first & 0x1FE;
+            if (reg < 0x80)
+            {
+                s->stopped = TRUE;
+                return;
+            }
+
+            WriteRegister(s, reg, second);
+            s->time += COPPER_CLOCKS;
+            continue;
+        }
+
+        // The compare starts once both words are fetched, so a WAIT for
+        // the end of line 255 hands over to the next one on line 256
+        s->time += COPPER_CLOCKS;
+        long target = CompareTarget(s, s->time, first, second);
+
+        if ((second & 1) == 0)
+        {
+            // WAIT, including the 0xFFFF 0xFFFE end of list
+            if (target < 0)
+            {
+                s->stopped = TRUE;
+                return;
+            }
+
+            if (target > s->time)
+                s->time = target + COPPER_WAKE_CLOCKS;
+        }
+        else
+        {
+            // SKIP the next instruction if the beam is already there
+            if (target >= 0 && target <= s->time)
+                s->pc += 4;
+        }
+    }
+}
+
+// Fetch one line of every plane into pixel indexes. Plane data starts
+// 17 lores pixels after DDFSTRT (9 in hires), delayed by the BPLCON1 scroll
+// of its playfield.
+static void FetchLine(struct RenderState* s, uint8_t* index, int width, BOOL frameHires)
+{
+    struct Registers* r = &s->regs;
+    int planes = (r->bplcon0 >> 12) & 7;
+    if (planes > MAX_PLANES)
+        planes = MAX_PLANES;
+
+    BOOL hires = (r->bplcon0 & 0x8000) != 0;
+    int words = 0;
+    if (r->ddfstop >= r->ddfstrt)
+        words = hires ? ((r->ddfstop - r->ddfstrt) >> 2) + 2 : ((r->ddfstop - r->ddfstrt) >> 3) + 1;
+
+    int scale = frameHires ? 2 : 1;
+    int dataStart = (r->ddfstrt * 2) + (hires ? 9 : 17) - (r->diwstrt & 0xFF);
+
+    for (int plane = 0; plane < planes; plane++)
+    {
+        BOOL odd = (plane & 1) == 0;
+        int delay = odd ? (r->bplcon1 & 0xF) : ((r->bplcon1 >> 4) & 0xF);
+        int x = (dataStart + delay) * scale;
+        uint32_t addr = r->bplpt[plane] & ~1u;
+        int bytes = words * 2;
+
+        if (addr + bytes <= s->chipSize)
+        {
+            const uint8_t* data = s->chip + addr;
+
+            for (int i = 0; i < bytes; i++, x += 8)
+            {
+                uint64_t bits = expand[data[i]] << plane;
+
+                if (x >= -LINE_PAD && x + 8 <= width + LINE_PAD)
+                {
+                    uint64_t pixels;
+                    memcpy(&pixels, index + x, 8);
+                    pixels |= bits;
+                    memcpy(index + x, &pixels, 8);
+                }
+            }
+        }
+
+        r->bplpt[plane] = addr + bytes + (odd ? r->bpl1mod : r->bpl2mod);
+    }
+}
+
+BOOL RenderField(const uint8_t* chip, uint32_t chipSize, uint32_t listAddr, BOOL pal, struct RenderFrame* frame)
+{
+    if (!expandReady)
+        InitExpand();
+
+    static struct RenderState s;
+    memset(&s, 0, sizeof(s));
+    s.chip = chip;
+    s.chipSize = chipSize;
+    s.frameLines = pal ? 313 : 263;
+    s.pc = listAddr;
+    s.regs.cop1lc = listAddr;
+
+    frame->width = 0;
+    frame->height = 0;
+    frame->hires = FALSE;
+
+    int vstart = -1;
+    uint8_t line[LINE_PAD + RENDER_MAX_WIDTH + LINE_PAD];
+    uint8_t* index = line + LINE_PAD;
+
+    for (int v = 0; v < s.frameLines; v++)
+    {
+        // Changes made before the line's fetch starts are part of it
+        RunCopper(&s, ((long)v * LINE_CLOCKS) + s.regs.ddfstrt);
+
+        struct Registers* r = &s.regs;
+        int top = r->diwstrt >> 8;
+        int bottom = r->diwstop >> 8;
+        if ((bottom & 0x80) == 0)
+            bottom |= 0x100;
+
+        if (vstart < 0)
+        {
+            if (v != top || v < BLANK_LINES)
+                continue;
+
+            // The window's size and resolution are taken from its first line
+            vstart = v;
+            frame->hires = (r->bplcon0 & 0x8000) != 0;
+            frame->width = (((r->diwstop & 0xFF) | 0x100) - (r->diwstrt & 0xFF)) * (frame->hires ? 2 : 1);
+            if (frame->width > RENDER_MAX_WIDTH)
+                frame->width = RENDER_MAX_WIDTH;
+            if (frame->width < 0)
+                frame->width = 0;
+        }
+
+        if (v >= bottom || frame->height >= RENDER_MAX_LINES)
+            break;
+
+        memset(line, 0, sizeof(line));
+        FetchLine(&s, index, frame->width, frame->hires);
+
+        uint32_t* out = frame->pixels + ((long)frame->height * frame->width);
+        for (int x = 0; x < frame->width; x++)
+        {
+            out[x] = r->rgb[index[x] & 31];
+        }
+
+        frame->height++;
+    }
+
+    return !s.fault;
+}
@@ -0,0 +1,34 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Reference renderer: runs a copper list against an image of chip RAM and
+// produces the 24-bit picture the display window should show for that
+// field. Models what Sparkler's lists use: BPLCON0 planes/hires, BPLCON1
+// scroll, BPLxMOD, DDFSTRT/STOP, DIWSTRT/STOP, COLORxx, BPLxPT, WAIT, SKIP
+// and COPJMP. Register changes apply to the line being fetched if the
+// copper makes them before the fetch starts, else from the next line.
+
+#ifndef SPARKLER_RENDER_H
+#define SPARKLER_RENDER_H
+
+#include <stdint.h>
+#include <exec/types.h>
+
+#define RENDER_MAX_WIDTH 768        // output pixels, hires
+#define RENDER_MAX_LINES 313
+
+struct RenderFrame
+{
+    int width;                      // output pixels; hires pixels for hires
+    int height;                     // lines in the display window
+    BOOL hires;
+    uint32_t pixels[RENDER_MAX_WIDTH * RENDER_MAX_LINES * 2];  // 0x00RRGGBB, room for two woven fields
+};
+
+// Run the list at listAddr (big-endian words, as in chip RAM) for one
+// field of a PAL (313 line) or NTSC (263 line) frame. Returns FALSE if the
+// list runs off the end of chip RAM.
+BOOL RenderField(const uint8_t* chip, uint32_t chipSize, uint32_t listAddr, BOOL pal, struct RenderFrame* frame);
+
+// 12-bit Amiga color to 0x00RRGGBB
+#define RENDER_RGB(c) ((uint32_t)((((c) >> 8) & 0xF) * 0x110000 + (((c) >> 4) & 0xF) * 0x1100 + ((c) & 0xF) * 0x11))
+
+#endif
@@ -0,0 +1,152 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Host end of the serial remote control, see serlink.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "serlink.h"
+
+static speed_t BaudSpeed(long baud)
+{
+    switch (baud)
+    {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+    }
+    return 0;
+}
+
+static long Milliseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000L) + (ts.tv_nsec / 1000000L);
+}
+
+BOOL LinkOpen(struct SerialLink* link, const char* path, long baud)
+{
+    speed_t speed = BaudSpeed(baud);
+    if (speed == 0)
+    {
+        errno = EINVAL;
+        return FALSE;
+    }
+
+    link->fd = open(path, O_RDWR | O_NOCTTY);
+    if (link->fd < 0)
+        return FALSE;
+
+    // 8N1, no flow control, bytes passed through untouched
+    struct termios tio;
+    if (tcgetattr(link->fd, &tio) != 0)
+    {
+        LinkClose(link);
+        return FALSE;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_iflag &= ~(IXON | IXOFF);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(link->fd, TCSANOW, &tio) != 0)
+    {
+        LinkClose(link);
+        return FALSE;
+    }
+
+    ProtocolLineInit(&link->line);
+    link->reply[0] = '\0';
+    return TRUE;
+}
+
+void LinkClose(struct SerialLink* link)
+{
+    if (link->fd >= 0)
+    {
+        close(link->fd);
+        link->fd = -1;
+    }
+}
+
+static BOOL WriteAll(int fd, const char* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        data += written;
+        length -= written;
+    }
+    return TRUE;
+}
+
+int LinkRequest(struct SerialLink* link, const char* request, int timeoutMs)
+{
+    char text[PROTOCOL_LINE_MAX + 1];
+    int length = snprintf(text, sizeof(text), "%s\n", request);
+    if (length >= (int)sizeof(text))
+        return LINK_FAILED;
+
+    link->reply[0] = '\0';
+    tcflush(link->fd, TCIFLUSH);
+    ProtocolLineInit(&link->line);
+
+    if (!WriteAll(link->fd, text, length))
+        return LINK_FAILED;
+
+    long deadline = Milliseconds() + timeoutMs;
+    for (;;)
+    {
+        long left = deadline - Milliseconds();
+        if (left <= 0)
+            return LINK_TIMEOUT;
+
+        struct pollfd pfd = { link->fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, (int)left);
+        if (ready < 0 && errno != EINTR)
+            return LINK_FAILED;
+        if (ready <= 0)
+            continue;
+
+        char buffer[64];
+        ssize_t got = read(link->fd, buffer, sizeof(buffer));
+        if (got == 0 || (got < 0 && errno != EINTR && errno != EAGAIN))
+            return LINK_FAILED;
+
+        for (ssize_t i = 0; i < got; i++)
+        {
+            // One request is in flight, so the first line is its reply
+            if (ProtocolFeed(&link->line, buffer[i]))
+            {
+                strcpy(link->reply, link->line.text);
+                return ProtocolReplyIsOk(link->reply) ? LINK_OK : LINK_ERR;
+            }
+        }
+    }
+}
+
+ULONG LinkValue(const struct SerialLink* link, const char* key, ULONG fallback)
+{
+    char value[32];
+    if (!ProtocolValue(link->reply, key, value, sizeof(value)))
+        return fallback;
+
+    return strtoul(value, NULL, 10);
+}
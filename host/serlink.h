@@ -0,0 +1,39 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Host end of Sparkler's serial remote control. Opens a serial port, or the
+// pseudo terminal of sparksim, raw at a baud rate and runs one request at a
+// time, waiting for its reply line. The requests are listed in protocol.h.
+
+#ifndef SPARKLER_SERLINK_H
+#define SPARKLER_SERLINK_H
+
+#include <exec/types.h>
+
+#include "protocol.h"
+
+enum LinkResult
+{
+    LINK_OK,            // the reply starts with OK
+    LINK_ERR,           // the reply starts with ERR
+    LINK_TIMEOUT,       // no whole line came back in time
+    LINK_FAILED         // the port could not be read or written
+};
+
+struct SerialLink
+{
+    int fd;
+    struct ProtocolLine line;
+    char reply[PROTOCOL_LINE_MAX];  // last reply, empty after a timeout
+};
+
+// FALSE with errno set if the port cannot be opened or set up
+BOOL LinkOpen(struct SerialLink* link, const char* path, long baud);
+void LinkClose(struct SerialLink* link);
+
+// Send a request and wait up to timeoutMs for its reply. Anything still
+// coming in from an earlier request that timed out is thrown away first.
+int LinkRequest(struct SerialLink* link, const char* request, int timeoutMs);
+
+// Decimal value of key in the last reply, or fallback if it has none
+ULONG LinkValue(const struct SerialLink* link, const char* key, ULONG fallback);
+
+#endif
@@ -0,0 +1,562 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Runs the sparkle compare over every frame of a soak run recording, raw
+// RGB24 frames or a Y4M file, on all cores. Frames are mapped straight from
+// the file. Writes a time series of every frame's errors, a per pixel
+// error heatmap for each pattern mode seen, and a summary by mode.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "expected.h"
+#include "pattern.h"
+#include "sparkle.h"
+
+#define MAX_THREADS 64
+#define CHUNK_FRAMES 4          // frames a thread claims at a time
+
+// A frame with more than this many mismatches per thousand pixels is taken
+// to show another pattern mode
+#define REDETECT_PER_MILLE 10
+
+struct Capture
+{
+    const UBYTE* data;
+    size_t size;
+    int width;
+    int height;
+    BOOL y4m;
+    BOOL chroma420;
+    size_t frameBytes;
+    long frames;
+    size_t* offsets;            // start of each frame's pixels
+};
+
+struct FrameResult
+{
+    ULONG mismatches;
+    UWORD rows;
+    UBYTE mode;                 // line mode
+    UBYTE maxDiff;
+};
+
+struct Worker
+{
+    pthread_t thread;
+    uint32_t* rgb;
+    ULONG* heat[PATTERN_ALL_MODES + 1];
+    struct SparkleStats stats;
+    int lastMode;
+    BOOL failed;
+};
+
+static struct Capture capture;
+static uint32_t* expected[PATTERN_ALL_MODES + 1];
+static int fixedMode = 0;       // 0 to find the mode of every frame
+static uint32_t tolerance = 0x181818;
+static struct FrameResult* results;
+static long nextFrame = 0;
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: soak [-j threads] [-t tolerance] [-s WxH] [-o prefix] [-q] <capture.y4m|capture.raw> <320|640> <200|256|400|512> <pattern|auto> [c0 c1]\n");
+    fprintf(stderr, "  pattern is 1-7, 8-10 for De Bruijn of order 2-4, 11-14 for multi-plane,\n");
+    fprintf(stderr, "  or N:<seed> for noise as the HUD shows it\n");
+    fprintf(stderr, "  raw captures are packed RGB24 frames of the -s size\n");
+    fprintf(stderr, "  auto finds which pattern each frame shows\n");
+    fprintf(stderr, "  writes prefix.csv, prefix-mode<n>.pgm heatmaps and prefix-summary.txt\n");
+    return 1;
+}
+
+// "YUV4MPEG2 W1920 H1080 F50:1 C444 ..." followed by frames, each after a
+// "FRAME" line
+static BOOL IndexY4m(struct Capture* c)
+{
+    const char* text = (const char*)c->data;
+    const char* end = memchr(text, '\n', c->size);
+    if (c->size < 10 || memcmp(text, "YUV4MPEG2 ", 10) != 0 || end == NULL)
+        return FALSE;
+
+    c->chroma420 = TRUE;
+    for (const char* p = text + 9; p < end; p++)
+    {
+        if (*p != ' ')
+            continue;
+
+        if (p[1] == 'W')
+            c->width = atoi(p + 2);
+        else if (p[1] == 'H')
+            c->height = atoi(p + 2);
+        else if (p[1] == 'C')
+        {
+            if (strncmp(p + 2, "444", 3) == 0)
+                c->chroma420 = FALSE;
+            else if (strncmp(p + 2, "420", 3) != 0)
+                return FALSE;
+        }
+    }
+
+    if (c->width <= 0 || c->height <= 0)
+        return FALSE;
+
+    size_t luma = (size_t)c->width * c->height;
+    size_t chroma = c->chroma420 ? (size_t)((c->width + 1) / 2) * ((c->height + 1) / 2) : luma;
+    c->frameBytes = luma + (2 * chroma);
+
+    size_t pos = (end - text) + 1;
+    long capacity = 1024;
+    c->offsets = (size_t*)malloc(capacity * sizeof(size_t));
+    c->frames = 0;
+
+    while (c->offsets != NULL && pos + 5 < c->size && memcmp(c->data + pos, "FRAME", 5) == 0)
+    {
+        const UBYTE* line = memchr(c->data + pos, '\n', c->size - pos);
+        if (line == NULL)
+            break;
+
+        pos = (line - c->data) + 1;
+        if (pos + c->frameBytes > c->size)
+            break;
+
+        if (c->frames == capacity)
+        {
+            capacity *= 2;
+            c->offsets = (size_t*)realloc(c->offsets, capacity * sizeof(size_t));
+            if (c->offsets == NULL)
+                return FALSE;
+        }
+
+        c->offsets[c->frames++] = pos;
+        pos += c->frameBytes;
+    }
+
+    return c->offsets != NULL;
+}
+
+static UBYTE Clamp(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : (UBYTE)v;
+}
+
+// BT.601 with video levels, what capture tools write by default
+static void LoadY4m(const UBYTE* frame, uint32_t* rgb)
+{
+    int width = capture.width;
+    int chromaWidth = capture.chroma420 ? (width + 1) / 2 : width;
+    size_t luma = (size_t)width * capture.height;
+    size_t chroma = capture.chroma420 ? (size_t)chromaWidth * ((capture.height + 1) / 2) : luma;
+    const UBYTE* planeU = frame + luma;
+    const UBYTE* planeV = planeU + chroma;
+
+    for (int y = 0; y < capture.height; y++)
+    {
+        const UBYTE* rowY = frame + ((size_t)y * width);
+        size_t chromaRow = (size_t)(capture.chroma420 ? y / 2 : y) * chromaWidth;
+
+        for (int x = 0; x < width; x++)
+        {
+            int cx = capture.chroma420 ? x / 2 : x;
+            int c = 298 * (rowY[x] - 16);
+            int d = planeU[chromaRow + cx] - 128;
+            int e = planeV[chromaRow + cx] - 128;
+
+            UBYTE r = Clamp((c + (409 * e) + 128) >> 8);
+            UBYTE g = Clamp((c - (100 * d) - (208 * e) + 128) >> 8);
+            UBYTE b = Clamp((c + (516 * d) + 128) >> 8);
+            rgb[((size_t)y * width) + x] = ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+        }
+    }
+}
+
+static void LoadFrame(long frame, uint32_t* rgb)
+{
+    const UBYTE* p = capture.data + capture.offsets[frame];
+
+    if (capture.y4m)
+    {
+        LoadY4m(p, rgb);
+        return;
+    }
+
+    for (size_t i = 0; i < (size_t)capture.width * capture.height; i++, p += 3)
+    {
+        rgb[i] = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    }
+}
+
+static ULONG Compare(struct Worker* w, int mode, ULONG* heat)
+{
+    SparkleCompare(w->rgb, capture.width, expected[mode], capture.width, capture.width, capture.height, tolerance, &w->stats, heat);
+    return (ULONG)w->stats.mismatches;
+}
+
+// The mode whose expected frame matches best
+static int FindMode(struct Worker* w)
+{
+    int best = 1;
+    ULONG bestErrors = 0xFFFFFFFF;
+
+    for (int mode = 1; mode <= PATTERN_FIXED_MODES; mode++)
+    {
+        ULONG errors = Compare(w, mode, NULL);
+        if (errors < bestErrors)
+        {
+            best = mode;
+            bestErrors = errors;
+        }
+    }
+
+    return best;
+}
+
+static void AnalyseFrame(struct Worker* w, long frame)
+{
+    LoadFrame(frame, w->rgb);
+
+    long pixels = (long)capture.width * capture.height;
+    int mode = fixedMode != 0 ? fixedMode : w->lastMode;
+    ULONG errors = mode != 0 ? Compare(w, mode, NULL) : 0xFFFFFFFF;
+
+    if (fixedMode == 0 && errors > (ULONG)(pixels * REDETECT_PER_MILLE / 1000))
+    {
+        mode = FindMode(w);
+        w->lastMode = mode;
+        errors = Compare(w, mode, NULL);
+    }
+
+    // Only frames with errors touch the heatmap, so they are compared again
+    // with it once the mode is known
+    if (errors != 0)
+    {
+        if (w->heat[mode] == NULL)
+            w->heat[mode] = (ULONG*)calloc(pixels, sizeof(ULONG));
+
+        if (w->heat[mode] != NULL)
+            Compare(w, mode, w->heat[mode]);
+        else
+            w->failed = TRUE;
+    }
+
+    struct FrameResult* r = &results[frame];
+    r->mismatches = (ULONG)w->stats.mismatches;
+    r->rows = (UWORD)w->stats.rowsWithErrors;
+    r->mode = (UBYTE)mode;
+    r->maxDiff = (UBYTE)w->stats.maxDiff;
+}
+
+// Threads claim a few frames at a time from a shared counter, so a thread
+// that falls behind simply takes fewer
+static void* WorkerMain(void* data)
+{
+    struct Worker* w = (struct Worker*)data;
+
+    for (;;)
+    {
+        long first = __atomic_fetch_add(&nextFrame, CHUNK_FRAMES, __ATOMIC_RELAXED);
+        if (first >= capture.frames)
+            break;
+
+        for (long frame = first; frame < first + CHUNK_FRAMES && frame < capture.frames; frame++)
+        {
+            AnalyseFrame(w, frame);
+        }
+    }
+
+    return NULL;
+}
+
+// 16-bit PGM of the error count of every pixel
+static BOOL WriteHeatmap(const char* name, const ULONG* heat)
+{
+    FILE* f = fopen(name, "wb");
+    if (f == NULL)
+        return FALSE;
+
+    ULONG maxCount = 1;
+    for (long i = 0; i < (long)capture.width * capture.height; i++)
+    {
+        if (heat[i] > maxCount)
+            maxCount = heat[i];
+    }
+
+    fprintf(f, "P5\n%d %d\n%lu\n", capture.width, capture.height, (unsigned long)(maxCount > 65535 ? 65535 : maxCount));
+    for (long i = 0; i < (long)capture.width * capture.height; i++)
+    {
+        ULONG v = heat[i] > 65535 ? 65535 : heat[i];
+        fputc((v >> 8) & 0xFF, f);
+        fputc(v & 0xFF, f);
+    }
+
+    return fclose(f) == 0;
+}
+
+static BOOL WriteResults(const char* prefix, struct Worker* workers, int threads, double seconds)
+{
+    char name[512];
+
+    snprintf(name, sizeof(name), "%s.csv", prefix);
+    FILE* f = fopen(name, "w");
+    if (f == NULL)
+        return FALSE;
+
+    fprintf(f, "frame,mode,mismatches,rows,maxdiff\n");
+    for (long i = 0; i < capture.frames; i++)
+    {
+        const struct FrameResult* r = &results[i];
+        fprintf(f, "%ld,%d,%lu,%u,%u\n", i, r->mode, (unsigned long)r->mismatches, r->rows, r->maxDiff);
+    }
+    if (fclose(f) != 0)
+        return FALSE;
+
+    snprintf(name, sizeof(name), "%s-summary.txt", prefix);
+    FILE* summary = fopen(name, "w");
+    if (summary == NULL)
+        return FALSE;
+
+    fprintf(summary, "%ld frames of %dx%d in %.2f s on %d threads, %.1f frames/second\n", capture.frames, capture.width, capture.height, seconds, threads, capture.frames / seconds);
+    fprintf(summary, "mode frames sparkly mismatches worst-frame ppm\n");
+
+    long pixels = (long)capture.width * capture.height;
+    for (int mode = 1; mode <= PATTERN_ALL_MODES; mode++)
+    {
+        long frames = 0;
+        long sparkly = 0;
+        double mismatches = 0;
+        long worst = -1;
+
+        for (long i = 0; i < capture.frames; i++)
+        {
+            const struct FrameResult* r = &results[i];
+            if (r->mode != mode)
+                continue;
+
+            frames++;
+            sparkly += r->mismatches != 0;
+            mismatches += r->mismatches;
+            if (worst < 0 || r->mismatches > results[worst].mismatches)
+                worst = i;
+        }
+
+        if (frames == 0)
+            continue;
+
+        fprintf(summary, "%d %ld %ld %.0f %ld %.1f\n", mode, frames, sparkly, mismatches, worst, (mismatches * 1e6) / ((double)frames * pixels));
+
+        // Merge the threads' heatmaps into the first one that has this mode
+        ULONG* heat = NULL;
+        for (int t = 0; t < threads; t++)
+        {
+            if (workers[t].heat[mode] == NULL)
+                continue;
+
+            if (heat == NULL)
+            {
+                heat = workers[t].heat[mode];
+                continue;
+            }
+
+            for (long i = 0; i < pixels; i++)
+            {
+                heat[i] += workers[t].heat[mode][i];
+            }
+        }
+
+        if (heat != NULL)
+        {
+            snprintf(name, sizeof(name), "%s-mode%d.pgm", prefix, mode);
+            if (!WriteHeatmap(name, heat))
+                return FALSE;
+        }
+    }
+
+    return fclose(summary) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int rawWidth = 0;
+    int rawHeight = 0;
+    const char* prefix = "soak";
+    BOOL showHud = TRUE;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        BOOL hasValue = arg + 1 < argc;
+
+        if (strcmp(argv[arg], "-j") == 0 && hasValue)
+            threads = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-t") == 0 && hasValue)
+        {
+            int t[3];
+            int n = sscanf(argv[++arg], "%d,%d,%d", &t[0], &t[1], &t[2]);
+            if (n == 1)
+                t[1] = t[2] = t[0];
+            else if (n != 3)
+                return Usage();
+
+            tolerance = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                if (t[i] < 0 || t[i] > 255)
+                    return Usage();
+                tolerance = (tolerance << 8) | t[i];
+            }
+        }
+        else if (strcmp(argv[arg], "-s") == 0 && hasValue)
+        {
+            if (sscanf(argv[++arg], "%dx%d", &rawWidth, &rawHeight) != 2)
+                return Usage();
+        }
+        else if (strcmp(argv[arg], "-o") == 0 && hasValue)
+            prefix = argv[++arg];
+        else if (strcmp(argv[arg], "-q") == 0)
+            showHud = FALSE;
+        else
+            return Usage();
+    }
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+
+    if (argc - arg < 4)
+        return Usage();
+
+    const char* captureName = argv[arg++];
+
+    // The pattern argument may be "auto", which the parser doesn't know
+    char* stateArgs[5];
+    int stateCount = argc - arg < 5 ? argc - arg : 5;
+    memcpy(stateArgs, argv + arg, stateCount * sizeof(char*));
+    BOOL autoMode = strcmp(stateArgs[2], "auto") == 0;
+    if (autoMode)
+        stateArgs[2] = "1";
+
+    struct ExpectedState state;
+    if (ExpectedParse(&state, stateCount, stateArgs) == 0)
+        return Usage();
+    state.hud = showHud;
+
+    if (!autoMode)
+        fixedMode = state.lineMode;
+
+    int fd = open(captureName, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "can't open %s\n", captureName);
+        return 1;
+    }
+
+    capture.size = st.st_size;
+    capture.data = capture.size > 0 ? (const UBYTE*)mmap(NULL, capture.size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (capture.data == MAP_FAILED)
+    {
+        fprintf(stderr, "can't map %s\n", captureName);
+        return 1;
+    }
+    madvise((void*)capture.data, capture.size, MADV_SEQUENTIAL);
+
+    capture.y4m = capture.size >= 10 && memcmp(capture.data, "YUV4MPEG2 ", 10) == 0;
+    if (capture.y4m)
+    {
+        if (!IndexY4m(&capture))
+        {
+            fprintf(stderr, "%s: unsupported Y4M, only 4:4:4 and 4:2:0 are read\n", captureName);
+            return 1;
+        }
+    }
+    else
+    {
+        if (rawWidth <= 0 || rawHeight <= 0)
+            return Usage();
+
+        capture.width = rawWidth;
+        capture.height = rawHeight;
+        capture.frameBytes = (size_t)rawWidth * rawHeight * 3;
+        capture.frames = (long)(capture.size / capture.frameBytes);
+        capture.offsets = (size_t*)malloc((capture.frames + 1) * sizeof(size_t));
+        for (long i = 0; capture.offsets != NULL && i < capture.frames; i++)
+        {
+            capture.offsets[i] = i * capture.frameBytes;
+        }
+    }
+
+    if (capture.width > SPARKLE_MAX_WIDTH || capture.offsets == NULL)
+    {
+        fprintf(stderr, "%s: frames too wide or out of memory\n", captureName);
+        return 1;
+    }
+
+    // Expected frames for every mode the run may show, scaled to the
+    // capture. Noise needs its seed, so it is never found by auto.
+    for (int mode = 1; mode <= PATTERN_ALL_MODES; mode++)
+    {
+        if (fixedMode != 0 ? mode != fixedMode : mode > PATTERN_FIXED_MODES)
+            continue;
+
+        static struct RenderFrame frame;
+        state.lineMode = mode;
+        if (ExpectedBuild(&state) == 0 || !ExpectedRenderFrame(&frame))
+        {
+            fprintf(stderr, "can't render the expected frame for mode %d\n", mode);
+            return 1;
+        }
+
+        expected[mode] = ExpectedScale(&frame, capture.width, capture.height);
+        if (expected[mode] == NULL)
+            return 1;
+    }
+
+    results = (struct FrameResult*)calloc(capture.frames + 1, sizeof(struct FrameResult));
+    static struct Worker workers[MAX_THREADS];
+    if (results == NULL)
+        return 1;
+
+    double start = Seconds();
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].rgb = (uint32_t*)malloc((size_t)capture.width * capture.height * sizeof(uint32_t));
+        if (workers[t].rgb == NULL || pthread_create(&workers[t].thread, NULL, WorkerMain, &workers[t]) != 0)
+        {
+            fprintf(stderr, "can't start thread %d\n", t);
+            return 1;
+        }
+    }
+
+    BOOL failed = FALSE;
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t].thread, NULL);
+        failed |= workers[t].failed;
+    }
+    double seconds = Seconds() - start;
+
+    if (failed)
+        fprintf(stderr, "out of memory for a heatmap; some errors are missing from it\n");
+
+    if (!WriteResults(prefix, workers, threads, seconds))
+    {
+        fprintf(stderr, "can't write the results for %s\n", prefix);
+        return 1;
+    }
+
+    printf("%ld frames of %dx%d in %.2f s on %d threads, %.1f frames/second\n", capture.frames, capture.width, capture.height, seconds, threads, capture.frames / seconds);
+    return 0;
+}
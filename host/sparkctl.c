@@ -0,0 +1,386 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Drives Sparkler over its serial remote control: single requests, scripts,
+// or a whole test matrix of modes, patterns and color pairs. Each cell of a
+// matrix is left to settle, checked against STATE and handed to a command,
+// e.g. one that grabs a capture and runs sparkdiff on it, with the state
+// on screen exported as SPARKLER_* variables.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+#include "serlink.h"
+
+#define DEFAULT_TTY "/dev/ttyUSB0"
+#define DEFAULT_TIMEOUT 10          // seconds, long enough for a noise bitmap
+#define DEFAULT_SETTLE 10           // frames
+#define MAX_LIST 64
+
+// Frames a WAIT adds to the timeout are counted at NTSC's rate, the faster
+static const int frameMs = 17;
+
+static struct SerialLink remote = { .fd = -1 };
+static int timeoutMs = DEFAULT_TIMEOUT * 1000;
+static BOOL verbose = FALSE;
+
+static int Usage()
+{
+    fprintf(stderr, "usage: sparkctl [-d device] [-b baud] [-t seconds] [-v] <request>...\n");
+    fprintf(stderr, "       sparkctl [options] -f <script>\n");
+    fprintf(stderr, "       sparkctl [options] [-s frames] [-x command] -m <modes> -p <patterns> [-c <pairs>]\n");
+    fprintf(stderr, "  device defaults to $SPARKLER_TTY, then %s; baud to %d\n", DEFAULT_TTY, PROTOCOL_BAUD);
+    fprintf(stderr, "  requests are sent one at a time and their replies printed, e.g. \"MODE 640 256\"\n");
+    fprintf(stderr, "  a script has a request per line, # comments, and !command lines that run\n");
+    fprintf(stderr, "  through the shell with the state exported as SPARKLER_* variables\n");
+    fprintf(stderr, "  -m 320x200,640x256 -p 1,3,N:1 -c 000/fbf,000/fff runs every combination,\n");
+    fprintf(stderr, "  waits -s frames (default %d) for it to settle, checks it with STATE and runs\n", DEFAULT_SETTLE);
+    fprintf(stderr, "  the -x command with the state exported; a command that fails fails the cell\n");
+    fprintf(stderr, "  exits 1 if any request or cell failed, 2 for bad arguments or no reply\n");
+    return 2;
+}
+
+// Frames a WAIT request waits, 0 for anything else
+static ULONG WaitFrames(const char* request)
+{
+    struct ProtocolLine line;
+    struct ProtocolRequest parsed;
+    const char* error;
+
+    ProtocolLineInit(&line);
+    while (*request != '\0')
+        ProtocolFeed(&line, *request++);
+    ProtocolFeed(&line, '\n');
+
+    if (!ProtocolParse(&line, &parsed, &error) || parsed.verb != PROTOCOL_WAIT)
+        return 0;
+    return parsed.frames;
+}
+
+// Run a request; the reply is printed with -v, and always for errors
+static int Request(const char* request)
+{
+    int timeout = timeoutMs + (int)(WaitFrames(request) * frameMs);
+    fflush(stdout);
+
+    int result = LinkRequest(&remote, request, timeout);
+    if (result == LINK_TIMEOUT)
+        fprintf(stderr, "%s: no reply\n", request);
+    else if (result == LINK_FAILED)
+        fprintf(stderr, "%s: %s\n", request, strerror(errno));
+    else if (result == LINK_ERR || verbose)
+        fprintf(result == LINK_ERR ? stderr : stdout, "%s: %s\n", request, remote.reply);
+
+    return result;
+}
+
+// Every key=value of a STATE reply as SPARKLER_<KEY>=value
+static BOOL ExportState()
+{
+    if (Request("STATE") != LINK_OK)
+        return FALSE;
+
+    char* copy = strdup(remote.reply);
+    for (char* word = strtok(copy, " "); word != NULL; word = strtok(NULL, " "))
+    {
+        char* equals = strchr(word, '=');
+        if (equals == NULL)
+            continue;
+
+        char name[64];
+        int length = snprintf(name, sizeof(name), "SPARKLER_%.*s", (int)(equals - word), word);
+        for (int i = 9; i < length && i < (int)sizeof(name) - 1; i++)
+        {
+            if (name[i] >= 'a' && name[i] <= 'z')
+                name[i] -= 'a' - 'A';
+        }
+        setenv(name, equals + 1, 1);
+    }
+    free(copy);
+    return TRUE;
+}
+
+static int RunCommand(const char* command)
+{
+    fflush(stdout);
+    int status = system(command);
+    if (status == -1)
+        return -1;
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128;
+}
+
+static int RunScript(const char* path)
+{
+    FILE* file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "can't open %s\n", path);
+        return 2;
+    }
+
+    int failures = 0;
+    char line[PROTOCOL_LINE_MAX];
+    int number = 0;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        number++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char* text = line + strspn(line, " \t");
+        if (text[0] == '\0' || text[0] == '#')
+            continue;
+
+        if (text[0] == '!')
+        {
+            if (!ExportState())
+                return 2;
+
+            int status = RunCommand(text + 1);
+            if (status != 0)
+            {
+                fprintf(stderr, "line %d: command exited with %d\n", number, status);
+                failures++;
+            }
+            continue;
+        }
+
+        int result = Request(text);
+        if (result == LINK_TIMEOUT || result == LINK_FAILED)
+            return 2;
+        if (result == LINK_ERR)
+            failures++;
+    }
+
+    if (file != stdin)
+        fclose(file);
+    return failures > 0 ? 1 : 0;
+}
+
+// Split a comma separated list in place
+static int SplitList(char* text, char** items)
+{
+    int count = 0;
+    for (char* item = strtok(text, ","); item != NULL && count < MAX_LIST; item = strtok(NULL, ","))
+    {
+        items[count++] = item;
+    }
+    return count;
+}
+
+// Check a STATE reply against what the cell asked for
+static BOOL StateMatches(int width, int height, const char* pattern, const char* c0, const char* c1)
+{
+    char value[32];
+    int lineMode;
+    int shownMode;
+    ULONG seed;
+    ULONG shownSeed;
+
+    if (LinkValue(&remote, "width", 0) != (ULONG)width || LinkValue(&remote, "height", 0) != (ULONG)height)
+        return FALSE;
+
+    if (!ProtocolValue(remote.reply, "pattern", value, sizeof(value)) || !ProtocolParsePattern(value, &shownMode, &shownSeed))
+        return FALSE;
+    ProtocolParsePattern(pattern, &lineMode, &seed);
+    if (lineMode != shownMode || seed != shownSeed)
+        return FALSE;
+
+    if (c0 == NULL)
+        return TRUE;
+
+    if (!ProtocolValue(remote.reply, "c0", value, sizeof(value)) || strtoul(value, NULL, 16) != strtoul(c0, NULL, 16))
+        return FALSE;
+    return ProtocolValue(remote.reply, "c1", value, sizeof(value)) && strtoul(value, NULL, 16) == strtoul(c1, NULL, 16);
+}
+
+static int RunMatrix(char* modeList, char* patternList, char* pairList, int settle, const char* command)
+{
+    char* modes[MAX_LIST];
+    char* patterns[MAX_LIST];
+    char* pairs[MAX_LIST];
+    int modeCount = SplitList(modeList, modes);
+    int patternCount = SplitList(patternList, patterns);
+    int pairCount = pairList != NULL ? SplitList(pairList, pairs) : 1;
+
+    // A sweep or cycle would move the colors under the cells
+    if (Request("STOP") != LINK_OK)
+        return 2;
+
+    int cells = 0;
+    int failures = 0;
+    for (int m = 0; m < modeCount; m++)
+    {
+        int width;
+        int height;
+        if (sscanf(modes[m], "%dx%d", &width, &height) != 2)
+        {
+            fprintf(stderr, "bad mode %s\n", modes[m]);
+            return 2;
+        }
+
+        for (int p = 0; p < patternCount; p++)
+        {
+            for (int c = 0; c < pairCount; c++)
+            {
+                char c0[8] = "";
+                char c1[8] = "";
+                char request[PROTOCOL_LINE_MAX];
+                BOOL ok = TRUE;
+                ULONG shown = 0;
+
+                if (pairList != NULL && sscanf(pairs[c], "%7[0-9a-fA-F]/%7[0-9a-fA-F]", c0, c1) != 2)
+                {
+                    fprintf(stderr, "bad color pair %s\n", pairs[c]);
+                    return 2;
+                }
+
+                snprintf(request, sizeof(request), "MODE %d %d", width, height);
+                int result = Request(request);
+                shown = LinkValue(&remote, "frame", shown);
+
+                if (result == LINK_OK)
+                {
+                    snprintf(request, sizeof(request), "PATTERN %s", patterns[p]);
+                    result = Request(request);
+                    shown = LinkValue(&remote, "frame", shown);
+                }
+
+                if (result == LINK_OK && pairList != NULL)
+                {
+                    snprintf(request, sizeof(request), "COLORS %s %s", c0, c1);
+                    result = Request(request);
+                    shown = LinkValue(&remote, "frame", shown);
+                }
+
+                if (result == LINK_TIMEOUT || result == LINK_FAILED)
+                    return 2;
+                ok = result == LINK_OK;
+
+                if (ok && settle > 0)
+                {
+                    snprintf(request, sizeof(request), "WAIT %d", settle);
+                    if (Request(request) != LINK_OK)
+                        return 2;
+                }
+
+                // The frame the cell went up on, for matching to a capture
+                char frame[16];
+                snprintf(frame, sizeof(frame), "%lu", (unsigned long)shown);
+                setenv("SPARKLER_SHOWN", frame, 1);
+
+                if (ok && !ExportState())
+                    return 2;
+
+                if (ok && !StateMatches(width, height, patterns[p], pairList != NULL ? c0 : NULL, c1))
+                {
+                    fprintf(stderr, "state does not match: %s\n", remote.reply);
+                    ok = FALSE;
+                }
+
+                int status = 0;
+                if (ok && command != NULL)
+                {
+                    status = RunCommand(command);
+                    ok = status == 0;
+                }
+
+                printf("%dx%d %s", width, height, patterns[p]);
+                if (pairList != NULL)
+                    printf(" %s/%s", c0, c1);
+                printf(" frame %lu: %s", (unsigned long)shown, ok ? "ok" : "FAIL");
+                if (status != 0)
+                    printf(" (exit %d)", status);
+                printf("\n");
+
+                cells++;
+                failures += ok ? 0 : 1;
+            }
+        }
+    }
+
+    printf("%d cells, %d failed\n", cells, failures);
+    return failures > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* device = getenv("SPARKLER_TTY") != NULL ? getenv("SPARKLER_TTY") : DEFAULT_TTY;
+    long baud = PROTOCOL_BAUD;
+    const char* script = NULL;
+    char* modes = NULL;
+    char* patterns = NULL;
+    char* pairs = NULL;
+    const char* command = NULL;
+    int settle = DEFAULT_SETTLE;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc)
+            device = argv[++arg];
+        else if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc)
+            baud = atol(argv[++arg]);
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc)
+            timeoutMs = atoi(argv[++arg]) * 1000;
+        else if (strcmp(argv[arg], "-v") == 0)
+            verbose = TRUE;
+        else if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc)
+            script = argv[++arg];
+        else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc)
+            modes = argv[++arg];
+        else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc)
+            patterns = argv[++arg];
+        else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc)
+            pairs = argv[++arg];
+        else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc)
+            settle = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-x") == 0 && arg + 1 < argc)
+            command = argv[++arg];
+        else
+            return Usage();
+    }
+
+    BOOL matrix = modes != NULL || patterns != NULL;
+    if (matrix && (modes == NULL || patterns == NULL))
+        return Usage();
+    if (!matrix && script == NULL && arg == argc)
+        return Usage();
+
+    if (!LinkOpen(&remote, device, baud))
+    {
+        fprintf(stderr, "can't open %s: %s\n", device, strerror(errno));
+        return 2;
+    }
+
+    int status;
+    if (matrix)
+    {
+        status = RunMatrix(modes, patterns, pairs, settle, command);
+    }
+    else if (script != NULL)
+    {
+        status = RunScript(script);
+    }
+    else
+    {
+        // Replies are the output
+        verbose = TRUE;
+        status = 0;
+        for (; arg < argc; arg++)
+        {
+            int result = Request(argv[arg]);
+            if (result == LINK_TIMEOUT || result == LINK_FAILED)
+            {
+                status = 2;
+                break;
+            }
+            if (result == LINK_ERR)
+                status = 1;
+        }
+    }
+
+    LinkClose(&remote);
+    return status;
+}
@@ -0,0 +1,221 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Compares a captured frame with the frame Sparkler should show for the
+// state in its status line and reports the sparkles. The capture must be
+// cropped to the display window; the expected frame is scaled up to it.
+// With -b, times the compare on 1080p frames instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "expected.h"
+#include "ppm.h"
+#include "sparkle.h"
+
+static struct RenderFrame source;
+static struct SparkleStats stats;
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: sparkdiff [-t tolerance] [-p period] [-f field] [-d diff.ppm] <capture.ppm> <320|640> <200|256|400|512> <pattern> [c0 c1]\n");
+    fprintf(stderr, "       sparkdiff -b <320|640> <200|256|400|512> <pattern> [c0 c1]\n");
+    fprintf(stderr, "  pattern is 1-7, 8-10 for De Bruijn of order 2-4, 11-14 for multi-plane,\n");
+    fprintf(stderr, "  or N:<seed> for noise as the HUD shows it\n");
+    fprintf(stderr, "  tolerance is one value for every channel or r,g,b (default 24)\n");
+    fprintf(stderr, "  period groups errors by Amiga pixel column (default 4)\n");
+    fprintf(stderr, "  field compares against one field of an interlaced mode instead of both woven\n");
+    fprintf(stderr, "  -q leaves the HUD out of the expected frame\n");
+    return 1;
+}
+
+// Expected pixels dimmed, mismatches in red
+static BOOL WriteDiff(const char* name, const uint32_t* captured, const uint32_t* expected, int width, int height, uint32_t tolerance)
+{
+    uint32_t* pixels = (uint32_t*)malloc((size_t)width * height * sizeof(uint32_t));
+    if (pixels == NULL)
+        return FALSE;
+
+    for (long i = 0; i < (long)width * height; i++)
+    {
+        BOOL mismatch = FALSE;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            int d = (int)((captured[i] >> shift) & 0xFF) - (int)((expected[i] >> shift) & 0xFF);
+            if ((d < 0 ? -d : d) > (int)((tolerance >> shift) & 0xFF))
+                mismatch = TRUE;
+        }
+
+        pixels[i] = mismatch ? 0xFF0000 : (expected[i] >> 2) & 0x3F3F3F;
+    }
+
+    BOOL ok = PpmWrite(name, pixels, width, height);
+    free(pixels);
+    return ok;
+}
+
+static void PrintStats(const struct SparkleStats* s, int width, int sourceWidth, int period)
+{
+    printf("pixels %ld mismatched %ld rows %ld max diff %d score %.1f ppm\n", s->pixels, s->mismatches, s->rowsWithErrors, s->maxDiff, s->score);
+
+    ULONG phases[SPARKLE_MAX_PERIOD];
+    SparklePhaseErrors(s, width, sourceWidth, period, phases);
+    printf("column phase errors:");
+    for (int i = 0; i < period; i++)
+    {
+        printf(" %lu", (unsigned long)phases[i]);
+    }
+    printf("\n");
+}
+
+// 1080p frames from the expected one with a known number of sparkles
+static int Bench(const struct RenderFrame* frame, uint32_t tolerance, int period)
+{
+    const int width = 1920;
+    const int height = 1080;
+    const int sparkles = 1000;
+
+    uint32_t* expected = ExpectedScale(frame, width, height);
+    uint32_t* captured = (uint32_t*)malloc((size_t)width * height * sizeof(uint32_t));
+    if (expected == NULL || captured == NULL)
+        return 1;
+
+    memcpy(captured, expected, (size_t)width * height * sizeof(uint32_t));
+    srand(1);
+    for (int i = 0; i < sparkles; i++)
+    {
+        long at;
+        do
+        {
+            at = (((long)rand() << 16) ^ rand()) % ((long)width * height);
+        }
+        while (captured[at] != expected[at]);
+        captured[at] ^= 0x808080;
+    }
+
+    int frames = 0;
+    double start = Seconds();
+    double elapsed;
+    do
+    {
+        SparkleCompare(captured, width, expected, width, width, height, tolerance, &stats, NULL);
+        frames++;
+        elapsed = Seconds() - start;
+    }
+    while (elapsed < 1.0);
+
+    PrintStats(&stats, width, frame->width, period);
+    printf("%dx%d: %.0f frames/second, %d sparkles planted\n", width, height, frames / elapsed, sparkles);
+
+    free(expected);
+    free(captured);
+    return stats.mismatches == sparkles ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    int tolerances[3] = { 24, 24, 24 };
+    int period = 4;
+    int field = -1;
+    const char* diffName = NULL;
+    BOOL bench = FALSE;
+    BOOL showHud = TRUE;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        BOOL hasValue = arg + 1 < argc;
+
+        if (strcmp(argv[arg], "-t") == 0 && hasValue)
+        {
+            int n = sscanf(argv[++arg], "%d,%d,%d", &tolerances[0], &tolerances[1], &tolerances[2]);
+            if (n == 1)
+                tolerances[1] = tolerances[2] = tolerances[0];
+            else if (n != 3)
+                return Usage();
+        }
+        else if (strcmp(argv[arg], "-p") == 0 && hasValue)
+            period = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-f") == 0 && hasValue)
+            field = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-d") == 0 && hasValue)
+            diffName = argv[++arg];
+        else if (strcmp(argv[arg], "-b") == 0)
+            bench = TRUE;
+        else if (strcmp(argv[arg], "-q") == 0)
+            showHud = FALSE;
+        else
+            return Usage();
+    }
+
+    if (period < 1 || period > SPARKLE_MAX_PERIOD)
+        return Usage();
+
+    uint32_t tolerance = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (tolerances[i] < 0 || tolerances[i] > 255)
+            return Usage();
+        tolerance = (tolerance << 8) | tolerances[i];
+    }
+
+    const char* captureName = NULL;
+    if (!bench)
+    {
+        if (arg >= argc)
+            return Usage();
+        captureName = argv[arg++];
+    }
+
+    struct ExpectedState state;
+    if (ExpectedParse(&state, argc - arg, argv + arg) == 0)
+        return Usage();
+    state.hud = showHud;
+
+    int fields = ExpectedBuild(&state);
+    if (fields == 0 || field >= fields)
+        return Usage();
+
+    BOOL rendered = field >= 0 ? ExpectedRenderField(field, &source) : ExpectedRenderFrame(&source);
+    if (!rendered)
+    {
+        fprintf(stderr, "copper ran off the end of chip RAM\n");
+        return 1;
+    }
+
+    if (bench)
+        return Bench(&source, tolerance, period);
+
+    int width;
+    int height;
+    uint32_t* captured = PpmRead(captureName, &width, &height);
+    if (captured == NULL)
+    {
+        fprintf(stderr, "can't read %s as an 8-bit PPM\n", captureName);
+        return 1;
+    }
+
+    uint32_t* expected = ExpectedScale(&source, width, height);
+    if (expected == NULL)
+        return 1;
+
+    SparkleCompare(captured, width, expected, width, width, height, tolerance, &stats, NULL);
+    PrintStats(&stats, width, source.width, period);
+
+    if (diffName != NULL && !WriteDiff(diffName, captured, expected, width, height, tolerance))
+    {
+        fprintf(stderr, "can't write %s\n", diffName);
+        return 1;
+    }
+
+    free(captured);
+    free(expected);
+    return stats.mismatches != 0 ? 2 : 0;
+}
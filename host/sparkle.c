@@ -0,0 +1,130 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Sparkle detector, see sparkle.h
+
+#include <string.h>
+
+#include "sparkle.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static int ChannelDiff(uint32_t a, uint32_t b, int shift)
+{
+    int d = (int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF);
+    return d < 0 ? -d : d;
+}
+
+// Pixels from x on, one at a time. Returns the mismatches.
+static long CompareTail(const uint32_t* captured, const uint32_t* expected, int x, int width, uint32_t tolerance, int* maxDiff, ULONG* columnErrors, ULONG* heatRow)
+{
+    long errors = 0;
+
+    for (; x < width; x++)
+    {
+        BOOL mismatch = FALSE;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            int d = ChannelDiff(captured[x], expected[x], shift);
+            if (d > *maxDiff)
+                *maxDiff = d;
+            if (d > (int)((tolerance >> shift) & 0xFF))
+                mismatch = TRUE;
+        }
+
+        if (mismatch)
+        {
+            columnErrors[x]++;
+            errors++;
+            if (heatRow != NULL)
+                heatRow[x]++;
+        }
+    }
+
+    return errors;
+}
+
+#ifdef __SSE2__
+
+// Saturating subtracts both ways give the absolute difference of every
+// channel; whatever is left after subtracting the tolerance is an error
+static long CompareRow(const uint32_t* captured, const uint32_t* expected, int width, uint32_t tolerance, int* maxDiff, ULONG* columnErrors, ULONG* heatRow)
+{
+    const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i tol = _mm_set1_epi32((int)(tolerance & 0x00FFFFFF));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i maxVector = zero;
+    long errors = 0;
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(captured + x));
+        __m128i b = _mm_loadu_si128((const __m128i*)(expected + x));
+        __m128i diff = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)), rgb);
+        maxVector = _mm_max_epu8(maxVector, diff);
+
+        __m128i over = _mm_subs_epu8(diff, tol);
+        int mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(over, zero))) & 0xF;
+
+        // Sparkles are rare, so the column bookkeeping is off the fast path
+        while (mask != 0)
+        {
+            int i = __builtin_ctz(mask);
+            columnErrors[x + i]++;
+            errors++;
+            if (heatRow != NULL)
+                heatRow[x + i]++;
+            mask &= mask - 1;
+        }
+    }
+
+    UBYTE lanes[16];
+    _mm_storeu_si128((__m128i*)lanes, maxVector);
+    for (int i = 0; i < 16; i++)
+    {
+        if (lanes[i] > *maxDiff)
+            *maxDiff = lanes[i];
+    }
+
+    return errors + CompareTail(captured, expected, x, width, tolerance, maxDiff, columnErrors, heatRow);
+}
+
+#else
+
+static long CompareRow(const uint32_t* captured, const uint32_t* expected, int width, uint32_t tolerance, int* maxDiff, ULONG* columnErrors, ULONG* heatRow)
+{
+    return CompareTail(captured, expected, 0, width, tolerance, maxDiff, columnErrors, heatRow);
+}
+
+#endif
+
+void SparkleCompare(const uint32_t* captured, int capturedStride, const uint32_t* expected, int expectedStride, int width, int height, uint32_t tolerance, struct SparkleStats* stats, ULONG* heatmap)
+{
+    if (width > SPARKLE_MAX_WIDTH)
+        width = SPARKLE_MAX_WIDTH;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->pixels = (long)width * height;
+
+    for (int y = 0; y < height; y++)
+    {
+        ULONG* heatRow = heatmap != NULL ? heatmap + ((long)y * width) : NULL;
+        long errors = CompareRow(captured + ((long)y * capturedStride), expected + ((long)y * expectedStride), width, tolerance, &stats->maxDiff, stats->columnErrors, heatRow);
+        stats->mismatches += errors;
+        stats->rowsWithErrors += errors != 0;
+    }
+
+    stats->score = stats->pixels > 0 ? (stats->mismatches * 1e6) / stats->pixels : 0;
+}
+
+void SparklePhaseErrors(const struct SparkleStats* stats, int width, int sourceWidth, int period, ULONG* phaseErrors)
+{
+    memset(phaseErrors, 0, period * sizeof(ULONG));
+
+    for (int x = 0; x < width && x < SPARKLE_MAX_WIDTH; x++)
+    {
+        int source = (int)(((long)x * sourceWidth) / width);
+        phaseErrors[source % period] += stats->columnErrors[x];
+    }
+}
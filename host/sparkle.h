@@ -0,0 +1,37 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Sparkle detector: compares a captured frame against the expected one and
+// counts the pixels where any channel is further off than its tolerance,
+// per frame and per column. The compare runs four pixels per step with
+// SSE2 where the CPU has it.
+
+#ifndef SPARKLER_SPARKLE_H
+#define SPARKLER_SPARKLE_H
+
+#include <stdint.h>
+#include <exec/types.h>
+
+#define SPARKLE_MAX_WIDTH 4096
+#define SPARKLE_MAX_PERIOD 64
+
+struct SparkleStats
+{
+    long pixels;
+    long mismatches;
+    long rowsWithErrors;
+    int maxDiff;                // largest channel difference of any pixel
+    double score;               // mismatched pixels per million
+    ULONG columnErrors[SPARKLE_MAX_WIDTH];
+};
+
+// Frames are 0x00RRGGBB with strides in pixels; the top byte is ignored.
+// tolerance is per channel, packed the same way. Width is clamped to
+// SPARKLE_MAX_WIDTH. If heatmap is not NULL it holds width x height counters,
+// and the counter of every mismatched pixel goes up by one.
+void SparkleCompare(const uint32_t* captured, int capturedStride, const uint32_t* expected, int expectedStride, int width, int height, uint32_t tolerance, struct SparkleStats* stats, ULONG* heatmap);
+
+// Sum the column errors of a frame scaled up from sourceWidth Amiga
+// pixels by the phase of the source column within period, since a sampling
+// fault usually repeats with the pixel clock
+void SparklePhaseErrors(const struct SparkleStats* stats, int width, int sourceWidth, int period, ULONG* phaseErrors);
+
+#endif
@@ -0,0 +1,409 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Stand-in for the Amiga end of the serial remote control. Opens a pseudo
+// terminal and answers requests the way Sparkler does, with the same parser
+// and replies, counting frames at 50 or 60 a second from the mode. Lets
+// sparkctl, scripts and matrix runs be tried out without an Amiga.
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pattern.h"
+#include "sweep.h"
+#include "protocol.h"
+
+// What Sparkler would show
+struct SimState
+{
+    int width;
+    int height;
+    int lineMode;
+    ULONG seed;
+    UWORD colors[16];
+    BOOL sweeping;
+    struct SweepCheckpoint sweep;
+    ULONG sweepFirstFrame;
+    BOOL cycling;
+    ULONG swaps;
+};
+
+static struct SimState sim;
+static volatile sig_atomic_t stopping = 0;
+
+static double frameBase = 0;
+static double rateStart = 0;
+static int frameRate = 60;
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static ULONG Frame()
+{
+    return (ULONG)(frameBase + ((Seconds() - rateStart) * frameRate));
+}
+
+static void SetRate(int rate)
+{
+    frameBase = frameBase + ((Seconds() - rateStart) * frameRate);
+    rateStart = Seconds();
+    frameRate = rate;
+}
+
+static void WaitForFrame(ULONG frame)
+{
+    while (Frame() < frame)
+    {
+        usleep(2000);
+    }
+}
+
+// Changes go up at the start of the next frame, as the server puts them up
+static ULONG ShowChange()
+{
+    ULONG frame = Frame() + 1;
+    WaitForFrame(frame);
+    return frame;
+}
+
+static void SetMode(int width, int height)
+{
+    sim.width = width;
+    sim.height = height;
+    SetRate(height == 256 || height == 512 ? 50 : 60);
+    sim.swaps++;
+}
+
+// Step on screen; a sweep that runs off the end stops on its last pair
+static ULONG SweepStep()
+{
+    ULONG step = sim.sweep.step + ((Frame() - sim.sweepFirstFrame) / sim.sweep.holdFrames);
+    if (step >= SWEEP_STEPS)
+    {
+        step = SWEEP_STEPS - 1;
+    }
+    return step;
+}
+
+static ULONG ColorPair()
+{
+    if (sim.sweeping)
+        return SweepPairFunction(sim.sweep.order)(SweepStep());
+
+    return ((ULONG)sim.colors[0] << 12) | sim.colors[1];
+}
+
+static void StopSweep()
+{
+    ULONG pair = ColorPair();
+    sim.sweep.step = SweepStep();
+    sim.sweeping = FALSE;
+    sim.colors[0] = (UWORD)(pair >> 12);
+    sim.colors[1] = (UWORD)(pair & 0xFFF);
+}
+
+static void ReplyState(char* reply)
+{
+    char pattern[16];
+    ULONG pair = ColorPair();
+
+    ProtocolReplyOk(reply, Frame());
+    ProtocolAdd(reply, "width", sim.width);
+    ProtocolAdd(reply, "height", sim.height);
+    ProtocolFormatPattern(pattern, sim.lineMode, sim.seed);
+    ProtocolAddText(reply, "pattern", pattern);
+    ProtocolAdd(reply, "coverage", PatternCoverage(sim.lineMode, PATTERN_MAX_DEPTH, sim.width, sim.height));
+    ProtocolAddHex(reply, "c0", (UWORD)(pair >> 12));
+    ProtocolAddHex(reply, "c1", (UWORD)(pair & 0xFFF));
+    ProtocolAdd(reply, "bands", 0);
+    ProtocolAdd(reply, "sweep", sim.sweeping);
+    ProtocolAdd(reply, "order", sim.sweep.order);
+    ProtocolAdd(reply, "hold", sim.sweep.holdFrames);
+    ProtocolAdd(reply, "step", sim.sweeping ? SweepStep() : sim.sweep.step);
+    ProtocolAdd(reply, "cycle", sim.cycling);
+    ProtocolAdd(reply, "scroll", 0);
+    ProtocolAdd(reply, "stress", 0);
+}
+
+static void ReplyTiming(char* reply)
+{
+    static const char* phases[] = { "pattern", "setup", "hud", "sleep" };
+
+    ProtocolReplyOk(reply, Frame());
+    ProtocolAdd(reply, "swaps", sim.swaps);
+    ProtocolAdd(reply, "lateswaps", 0);
+    ProtocolAdd(reply, "lateapplies", 0);
+    ProtocolAdd(reply, "lateframes", 0);
+    for (int i = 0; i < 4; i++)
+    {
+        ProtocolAddText(reply, phases[i], "0/0/0");
+    }
+}
+
+// The keys that change what is on screen; the rest are taken and ignored
+static void PressKey(int key)
+{
+    int width = sim.width;
+    int height = sim.height;
+    BOOL pal = height == 256 || height == 512;
+    BOOL interlaced = height > 256;
+
+    switch (key)
+    {
+        case 0x50: // F1
+            width = width == 640 ? 320 : 640;
+            break;
+
+        case 0x51: // F2
+            interlaced = !interlaced;
+            break;
+
+        case 0x40: // SPACE
+            pal = !pal;
+            break;
+
+        case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07:
+            sim.lineMode = key;
+            return;
+
+        case 0x33: // C
+            if (sim.sweeping)
+                StopSweep();
+            sim.cycling = !sim.cycling;
+            return;
+
+        case 0x45: // ESC
+            stopping = 1;
+            return;
+
+        default:
+            return;
+    }
+
+    height = (pal ? 256 : 200) * (interlaced ? 2 : 1);
+    SetMode(width, height);
+}
+
+static void Answer(const struct ProtocolLine* line, char* reply)
+{
+    struct ProtocolRequest request;
+    const char* error;
+
+    if (!ProtocolParse(line, &request, &error))
+    {
+        ProtocolReplyError(reply, error);
+        return;
+    }
+
+    switch (request.verb)
+    {
+        case PROTOCOL_PING:
+            ProtocolReplyOk(reply, Frame());
+            break;
+
+        case PROTOCOL_STATE:
+            ReplyState(reply);
+            break;
+
+        case PROTOCOL_TIMING:
+            ReplyTiming(reply);
+            break;
+
+        case PROTOCOL_MODE:
+            SetMode(request.width, request.height);
+            ProtocolReplyOk(reply, ShowChange());
+            break;
+
+        case PROTOCOL_PATTERN:
+            // as if Sparkler was started without an image
+            if (request.lineMode == PATTERN_IMAGE)
+            {
+                ProtocolReplyError(reply, "no image");
+                break;
+            }
+            sim.lineMode = request.lineMode;
+            sim.seed = request.seed;
+            ProtocolReplyOk(reply, ShowChange());
+            break;
+
+        case PROTOCOL_COLORS:
+        case PROTOCOL_COLOR:
+        {
+            int index = request.verb == PROTOCOL_COLOR ? request.index : 0;
+            if (sim.sweeping && index < 2)
+            {
+                ProtocolReplyError(reply, "sweeping");
+                break;
+            }
+
+            sim.colors[index] = request.colors[0];
+            if (request.verb == PROTOCOL_COLORS)
+                sim.colors[1] = request.colors[1];
+            ProtocolReplyOk(reply, ShowChange());
+            break;
+        }
+
+        case PROTOCOL_SWEEP:
+            sim.cycling = FALSE;
+            sim.sweep.order = request.order;
+            sim.sweep.holdFrames = request.holdFrames;
+            sim.sweep.step = request.step;
+            sim.sweeping = TRUE;
+            sim.sweepFirstFrame = ShowChange();
+            ProtocolReplyOk(reply, sim.sweepFirstFrame);
+            break;
+
+        case PROTOCOL_STOP:
+            if (sim.sweeping)
+                StopSweep();
+            sim.cycling = FALSE;
+            ProtocolReplyOk(reply, ShowChange());
+            break;
+
+        case PROTOCOL_KEY:
+            PressKey(request.key);
+            ProtocolReplyOk(reply, ShowChange());
+            break;
+
+        case PROTOCOL_WAIT:
+            WaitForFrame(Frame() + request.frames);
+            ProtocolReplyOk(reply, Frame());
+            break;
+    }
+}
+
+static void Stop(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: sparksim [-l link] [-p] [-v]\n");
+    fprintf(stderr, "  opens a pseudo terminal that answers Sparkler's remote requests and prints\n");
+    fprintf(stderr, "  its name; -l also makes a symlink to it, -p starts in PAL, -v logs requests\n");
+    fprintf(stderr, "  runs until KEY 45 (ESC) or Ctrl-C\n");
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    const char* linkPath = NULL;
+    BOOL pal = FALSE;
+    BOOL verbose = FALSE;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "-l") == 0 && arg + 1 < argc)
+            linkPath = argv[++arg];
+        else if (strcmp(argv[arg], "-p") == 0)
+            pal = TRUE;
+        else if (strcmp(argv[arg], "-v") == 0)
+            verbose = TRUE;
+        else
+            return Usage();
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        perror("pseudo terminal");
+        return 1;
+    }
+    const char* name = ptsname(master);
+
+    // Held open so the master never sees a hangup between clients, and raw
+    // so nothing is echoed before a client sets it up
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio) != 0)
+    {
+        perror(name);
+        return 1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    if (linkPath != NULL)
+    {
+        unlink(linkPath);
+        if (symlink(name, linkPath) != 0)
+        {
+            perror(linkPath);
+            return 1;
+        }
+    }
+
+    // Sparkler's startup state
+    static const UWORD colors[16] = { 0, 0xfbf, 0x710, 0xC10, 0x910, 0xE20, 0xFCB, 0xFFF, 0xF42, 0x0, 0xF98, 0xF65, 0xC54, 0x322, 0x444, 0x888 };
+    memcpy(sim.colors, colors, sizeof(colors));
+    sim.lineMode = 1;
+    sim.sweep.order = SWEEP_GRAY;
+    sim.sweep.holdFrames = SWEEP_HOLD_FRAMES;
+    SweepInit();
+    rateStart = Seconds();
+    SetMode(640, pal ? 256 : 200);
+    sim.swaps = 0;
+
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+    printf("%s\n", name);
+    fflush(stdout);
+
+    struct ProtocolLine line;
+    ProtocolLineInit(&line);
+
+    while (!stopping)
+    {
+        struct pollfd pfd = { master, POLLIN, 0 };
+        if (poll(&pfd, 1, 200) <= 0)
+            continue;
+
+        char buffer[64];
+        ssize_t got = read(master, buffer, sizeof(buffer));
+        if (got < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("read");
+            break;
+        }
+
+        for (ssize_t i = 0; i < got && !stopping; i++)
+        {
+            if (!ProtocolFeed(&line, buffer[i]))
+                continue;
+
+            char reply[PROTOCOL_LINE_MAX + 1];
+            Answer(&line, reply);
+            if (verbose)
+                printf("%s -> %s\n", line.text, reply);
+
+            strcat(reply, "\n");
+            if (write(master, reply, strlen(reply)) < 0)
+                perror("write");
+        }
+    }
+
+    // Closing the master throws away a reply the client has not read yet
+    usleep(200000);
+
+    if (linkPath != NULL)
+        unlink(linkPath);
+    close(slave);
+    close(master);
+    return 0;
+}
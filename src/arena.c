@@ -0,0 +1,105 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Chip RAM arena, see arena.h
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/exec.h>
+
+#include "arena.h"
+
+static UBYTE* pBlock = NULL;
+static ULONG blockBytes = 0;
+static ULONG fixedUsed = 0;
+static ULONG fixedBytes = 0;
+
+// The region as a private memory list of its own
+static struct MemHeader region;
+
+BOOL ArenaInit(ULONG fixed, ULONG regionBytes)
+{
+    fixedBytes = ARENA_ROUND(fixed);
+    regionBytes = ARENA_ROUND(regionBytes);
+    blockBytes = fixedBytes + regionBytes;
+
+    // AllocMem() blocks are always ARENA_ALIGN aligned
+    pBlock = (UBYTE*)AllocMem(blockBytes, MEMF_CHIP|MEMF_CLEAR);
+    if (pBlock == NULL)
+    {
+        blockBytes = 0;
+        return FALSE;
+    }
+    fixedUsed = 0;
+
+    struct MemChunk* pFirst = (struct MemChunk*)(pBlock + fixedBytes);
+    pFirst->mc_Next = NULL;
+    pFirst->mc_Bytes = regionBytes;
+
+    region.mh_Node.ln_Type = NT_MEMORY;
+    region.mh_Node.ln_Name = "Sparkler Chip Arena";
+    region.mh_Attributes = MEMF_CHIP;
+    region.mh_First = pFirst;
+    region.mh_Lower = (APTR)pFirst;
+    region.mh_Upper = (APTR)(pBlock + blockBytes);
+    region.mh_Free = regionBytes;
+
+    return TRUE;
+}
+
+void ArenaCleanup()
+{
+    if (pBlock != NULL)
+    {
+        FreeMem(pBlock, blockBytes);
+        pBlock = NULL;
+        blockBytes = 0;
+    }
+}
+
+APTR ArenaAllocFixed(ULONG bytes)
+{
+    bytes = ARENA_ROUND(bytes);
+    if (pBlock == NULL || fixedUsed + bytes > fixedBytes)
+    {
+        return NULL;
+    }
+
+    APTR memory = (APTR)(pBlock + fixedUsed);
+    fixedUsed += bytes;
+    return memory;
+}
+
+APTR ArenaAlloc(ULONG bytes)
+{
+    if (pBlock == NULL || bytes == 0)
+    {
+        return NULL;
+    }
+
+    return Allocate(&region, ARENA_ROUND(bytes));
+}
+
+void ArenaFree(APTR memory, ULONG bytes)
+{
+    if (memory != NULL)
+    {
+        Deallocate(&region, memory, ARENA_ROUND(bytes));
+    }
+}
+
+ULONG ArenaLargestFree()
+{
+    ULONG largest = 0;
+
+    if (pBlock == NULL)
+    {
+        return 0;
+    }
+
+    for (struct MemChunk* pChunk = region.mh_First; pChunk != NULL; pChunk = pChunk->mc_Next)
+    {
+        if (pChunk->mc_Bytes > largest)
+            largest = pChunk->mc_Bytes;
+    }
+
+    return largest;
+}
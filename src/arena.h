@@ -0,0 +1,34 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// One block of chip RAM, reserved at startup, for everything the display
+// shows. Fixed parts such as the copper lists and the HUD plane are taken
+// off the front and kept until exit. The rest is a region the pattern cache
+// takes bitmaps from and gives them back to, managed by exec's Allocate()
+// and Deallocate(). The whole block goes back with one FreeMem().
+
+#ifndef SPARKLER_ARENA_H
+#define SPARKLER_ARENA_H
+
+#include <exec/types.h>
+
+// Every part starts and ends on this boundary
+#define ARENA_ALIGN 8
+#define ARENA_ROUND(bytes) (((bytes) + (ARENA_ALIGN - 1)) & ~(ULONG)(ARENA_ALIGN - 1))
+
+// Reserve fixedBytes for fixed parts and regionBytes for the region, both
+// rounded. The block is cleared. FALSE if there is not enough chip RAM.
+BOOL ArenaInit(ULONG fixedBytes, ULONG regionBytes);
+
+// Give the block back. Nothing in it may still be on screen.
+void ArenaCleanup(void);
+
+// A fixed part, kept until exit; NULL if the fixed space is used up
+APTR ArenaAllocFixed(ULONG bytes);
+
+// Part of the region, not cleared; NULL if no free run is long enough
+APTR ArenaAlloc(ULONG bytes);
+void ArenaFree(APTR memory, ULONG bytes);
+
+// Longest free run in the region
+ULONG ArenaLargestFree(void);
+
+#endif
@@ -1 +1 @@
-m68k-amigaos-gcc sparkler.c -o sparkler -Os -noixemul -w
\ No newline at end of file
+m68k-amigaos-gcc sparkler.c pattern.c patcache.c copper.c vblank.c input.c hud.c font.c sweep.c cycle.c stress.c profile.c arena.c protocol.c remote.c image.c -o sparkler -Os -noixemul -w
\ No newline at end of file
@@ -0,0 +1,356 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Copper list builder, see copper.h
+
+#include "copper.h"
+
+void CopperInit(struct CopperList* cl, UWORD* words, ULONG sizeBytes)
+{
+    cl->words = words;
+    cl->capacity = words != NULL ? (int)(sizeBytes / 2) : 0;
+    cl->count = 0;
+    cl->written = 0;
+    cl->overflow = FALSE;
+
+    for (int i = 0; i < COPSLOT_COUNT; i++)
+    {
+        cl->slots[i] = COPPER_NO_SLOT;
+    }
+}
+
+// Every instruction is two words. Two more are always held back for the
+// end-of-list WAIT so an overflowing list still terminates.
+static int Emit(struct CopperList* cl, UWORD first, UWORD second)
+{
+    int index = cl->count;
+    cl->count += 2;
+
+    if (cl->words == NULL || cl->overflow)
+        return COPPER_NO_SLOT;
+
+    if (index + 4 > cl->capacity)
+    {
+        cl->overflow = TRUE;
+        return COPPER_NO_SLOT;
+    }
+
+    cl->words[index] = first;
+    cl->words[index + 1] = second;
+    cl->written = index + 2;
+    return index;
+}
+
+void CopperMove(struct CopperList* cl, UWORD reg, UWORD value)
+{
+    Emit(cl, reg & 0x1FE, value);
+}
+
+void CopperMoveSlot(struct CopperList* cl, int slot, UWORD reg, UWORD value)
+{
+    int index = Emit(cl, reg & 0x1FE, value);
+    cl->slots[slot] = index != COPPER_NO_SLOT ? index + 1 : COPPER_NO_SLOT;
+}
+
+void CopperMovePointer(struct CopperList* cl, int slot, UWORD reg, ULONG value)
+{
+    CopperMoveSlot(cl, slot, reg, (UWORD)(value >> 16));
+    CopperMoveSlot(cl, slot + 1, reg + 2, (UWORD)(value & 0xFFFF));
+}
+
+// Beam compare with all enable bits set, so only vpos/hpos matter
+#define WAIT_WORD(vpos, hpos) ((UWORD)((((vpos) & 0xFF) << 8) | ((hpos) & 0xFE) | 1))
+
+void CopperWait(struct CopperList* cl, int vpos, int hpos)
+{
+    Emit(cl, WAIT_WORD(vpos, hpos), 0xFFFE);
+}
+
+void CopperWaitSlot(struct CopperList* cl, int slot, int vpos, int hpos)
+{
+    cl->slots[slot] = Emit(cl, WAIT_WORD(vpos, hpos), 0xFFFE);
+}
+
+void CopperSkip(struct CopperList* cl, int vpos, int hpos)
+{
+    Emit(cl, WAIT_WORD(vpos, hpos), 0xFFFF);
+}
+
+void CopperEnd(struct CopperList* cl)
+{
+    int index = cl->written;
+    cl->count += 2;
+
+    if (cl->words == NULL || index + 2 > cl->capacity)
+        return;
+
+    cl->words[index] = 0xFFFF;
+    cl->words[index + 1] = 0xFFFE;
+    cl->written = index + 2;
+}
+
+BOOL CopperPatch(struct CopperList* cl, int slot, UWORD value)
+{
+    int index = cl->slots[slot];
+    if (index == COPPER_NO_SLOT)
+        return FALSE;
+
+    cl->words[index] = value;
+    return TRUE;
+}
+
+BOOL CopperPatchPointer(struct CopperList* cl, int slot, ULONG value)
+{
+    if (cl->slots[slot] == COPPER_NO_SLOT || cl->slots[slot + 1] == COPPER_NO_SLOT)
+        return FALSE;
+
+    cl->words[cl->slots[slot]] = (UWORD)(value >> 16);
+    cl->words[cl->slots[slot + 1]] = (UWORD)(value & 0xFFFF);
+    return TRUE;
+}
+
+BOOL CopperPatchWait(struct CopperList* cl, int slot, int vpos, int hpos)
+{
+    return CopperPatch(cl, slot, WAIT_WORD(vpos, hpos));
+}
+
+ULONG CopperSplitPlane(ULONG plane, UWORD hudLines, UWORD rowBytes, UWORD modulo)
+{
+    return plane + ((ULONG)hudLines * (rowBytes + modulo));
+}
+
+ULONG CopperScrollWidth(const struct CopperDisplay* display)
+{
+    // BPLCON1 counts lores pixels, so a hires step is two
+    return (ULONG)display->rowBytes * (display->hires ? 4 : 8);
+}
+
+ULONG CopperScrollHeight(const struct CopperDisplay* display)
+{
+    ULONG step = display->interlaced ? 2 : 1;
+    ULONG rows = (display->pal ? 256 : 200) * step;
+
+    // Even, so going round keeps the row parity of two-row patterns
+    return (rows - ((display->hudLines + 2) * step)) & ~1UL;
+}
+
+void CopperScrollTo(struct CopperScroll* scroll, const struct CopperDisplay* display, int field)
+{
+    ULONG x = display->scrollX % CopperScrollWidth(display);
+    ULONG y = display->scrollY % CopperScrollHeight(display);
+
+    // Whole words move the pointers on, BPLCON1 delays the planes back by
+    // what is left over
+    ULONG wordSteps = display->hires ? 8 : 16;
+    ULONG words = (x + wordSteps - 1) / wordSteps;
+    UWORD delay = (UWORD)((words * wordSteps) - x);
+    ULONG across = (words * 2) - COPPER_SCROLL_LEAD;
+
+    scroll->bplcon1 = delay | (delay << 4);
+
+    // Each line of an interlaced field moves down two rows
+    ULONG step = display->interlaced ? 2 : 1;
+    ULONG rows = (display->pal ? 256 : 200) * step;
+    ULONG first = y + field;
+    scroll->split = ((first + ((display->hudLines + 1) * step)) * display->rowBytes) + across;
+
+    ULONG lines = (rows - first + step - 1) / step;
+    scroll->wrapLine = COPPER_DISPLAY_TOP + (int)lines;
+    scroll->wrap = (((first + (lines * step)) - rows) * display->rowBytes) + across;
+}
+
+void CopperPatchScroll(struct CopperList* cl, const struct CopperDisplay* display, int field)
+{
+    struct CopperScroll scroll;
+    CopperScrollTo(&scroll, display, field);
+
+    CopperPatchWait(cl, COPSLOT_SCROLLWAIT, COPPER_DISPLAY_TOP + display->hudLines, 0xDC);
+    for (int i = 0; i < 3; i++)
+    {
+        CopperPatchPointer(cl, COPSLOT_SCROLLPTH_N(i), display->planes[i] + scroll.split);
+    }
+    CopperPatchPointer(cl, COPSLOT_BPLPTH(3), display->planes[3] + scroll.split);
+    CopperPatch(cl, COPSLOT_BPLCON1, scroll.bplcon1);
+
+    // WAIT only compares 8 bits of vpos; the first WAIT gets past line 255
+    // when the wrap is below it
+    if (scroll.wrapLine > 0xFF)
+        CopperPatchWait(cl, COPSLOT_WRAPWAIT255, 0xFF, 0xDE);
+    else
+        CopperPatchWait(cl, COPSLOT_WRAPWAIT255, scroll.wrapLine, 0);
+
+    CopperPatchWait(cl, COPSLOT_WRAPWAIT, scroll.wrapLine, 0);
+    for (int i = 0; i < 4; i++)
+    {
+        CopperPatchPointer(cl, COPSLOT_WRAPPTH_N(i), display->planes[i] + scroll.wrap);
+    }
+}
+
+// Give plane 4 and colors 8-15 back to the bitmap from hudLine on. The ten
+// MOVEs take 40 color clocks, so they are done before the first fetch of
+// the line at DDFSTRT.
+//
+// A scrolling display also moves planes 1-3 and sets BPLCON1, too much for
+// the start of a line, so its band is one line longer. The HUD plane is
+// blank on that line, so colors 8-15 are loaded at its start and the
+// pointers once it has been fetched.
+static void EndHudBand(struct CopperList* cl, const struct CopperDisplay* display, int hudLine)
+{
+    ULONG plane = CopperSplitPlane(display->planes[3], display->hudLines, display->rowBytes, display->modulo);
+
+    CopperWaitSlot(cl, COPSLOT_HUDWAIT, hudLine, 0);
+    if (display->scroll)
+    {
+        for (int i = 8; i < 16; i++)
+        {
+            CopperMoveSlot(cl, COPSLOT_COLOR(i), COPREG(color) + (i * 2), display->colors[i]);
+        }
+
+        CopperWaitSlot(cl, COPSLOT_SCROLLWAIT, hudLine, 0xDC);
+        for (int i = 0; i < 3; i++)
+        {
+            CopperMovePointer(cl, COPSLOT_SCROLLPTH_N(i), COPREG(bplpt) + (i * 4), display->planes[i]);
+        }
+        CopperMovePointer(cl, COPSLOT_BPLPTH(3), COPREG(bplpt) + 12, display->planes[3]);
+        CopperMoveSlot(cl, COPSLOT_BPLCON1, COPREG(bplcon1), 0);
+        return;
+    }
+
+    CopperMovePointer(cl, COPSLOT_BPLPTH(3), COPREG(bplpt) + 12, plane);
+
+    for (int i = 8; i < 16; i++)
+    {
+        CopperMoveSlot(cl, COPSLOT_COLOR(i), COPREG(color) + (i * 2), display->colors[i]);
+    }
+}
+
+// Point all four planes back at the top of the bitmap on the line the
+// scrolled bitmap runs out. The eight MOVEs are done before DDFSTRT.
+static void WrapBitmap(struct CopperList* cl, const struct CopperDisplay* display)
+{
+    CopperWaitSlot(cl, COPSLOT_WRAPWAIT255, 0, 0);
+    CopperWaitSlot(cl, COPSLOT_WRAPWAIT, 0, 0);
+    for (int i = 0; i < 4; i++)
+    {
+        CopperMovePointer(cl, COPSLOT_WRAPPTH_N(i), COPREG(bplpt) + (i * 4), display->planes[i]);
+    }
+}
+
+void CopperBuild(struct CopperList* cl, const struct CopperDisplay* display)
+{
+    // Color burst, plus the plane count in bits 12-14
+    UWORD bplcon0 = display->hires ? 0x8200 : 0x0200;
+    if (display->interlaced)
+    {
+        bplcon0 |= 0x04;
+    }
+
+    // Scrolling fetches a word more, one fetch earlier, and takes it back
+    // off with the modulo
+    UWORD ddfstrt = 0x38;
+    UWORD modulo = display->modulo;
+    ULONG lead = 0;
+    if (display->scroll)
+    {
+        ddfstrt -= display->hires ? 4 : 8;
+        modulo -= COPPER_SCROLL_LEAD;
+        lead = COPPER_SCROLL_LEAD;
+    }
+
+    CopperMoveSlot(cl, COPSLOT_BPLCON0, COPREG(bplcon0), bplcon0 | (4 << 12));
+    CopperMove(cl, COPREG(bplcon1), 0);
+    CopperMoveSlot(cl, COPSLOT_BPL1MOD, COPREG(bpl1mod), modulo);
+    CopperMoveSlot(cl, COPSLOT_BPL2MOD, COPREG(bpl2mod), modulo);
+    CopperMove(cl, COPREG(ddfstrt), ddfstrt);
+    CopperMove(cl, COPREG(ddfstop), 0xd0);
+
+    // Plane 4 set selects colors 8-15, so in the HUD band they are its pen
+    for (int i = 0; i < 16; i++)
+    {
+        if (i < 8)
+            CopperMoveSlot(cl, COPSLOT_COLOR(i), COPREG(color) + (i * 2), display->colors[i]);
+        else
+            CopperMove(cl, COPREG(color) + (i * 2), display->hudColor);
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        CopperMovePointer(cl, COPSLOT_BPLPTH(i), COPREG(bplpt) + (i * 4), display->planes[i] - lead);
+    }
+    CopperMovePointer(cl, COPSLOT_HUDPTH, COPREG(bplpt) + 12, display->hudPlane - lead);
+
+    CopperMove(cl, COPREG(diwstrt), (COPPER_DISPLAY_TOP << 8) | 0x81);
+    CopperMoveSlot(cl, COPSLOT_DIWSTOP, COPREG(diwstop), display->pal ? 0x2CC1 : 0xF4C1);
+
+    // Below the HUD band plane 4 shows the bitmap, so the pattern is never
+    // drawn over and the HUD only costs its own rows of chip RAM. WAITs
+    // must come in beam order, so band changes above it go first.
+    int hudLine = COPPER_DISPLAY_TOP + display->hudLines;
+    BOOL hudDone = FALSE;
+    BOOL wrapped = FALSE;
+    int lines = display->pal ? 256 : 200;
+    int previousBand = -1;
+    int bandRows = display->scroll ? 0 : display->bandRows;
+
+    for (int line = 0; line < lines && bandRows != 0; line++)
+    {
+        int row = display->interlaced ? line * 2 : line;
+        int band = row / bandRows;
+        if (band == previousBand || band >= display->bandCount)
+            continue;
+
+        previousBand = band;
+        int vpos = COPPER_DISPLAY_TOP + line;
+
+        if (!hudDone && hudLine <= vpos)
+        {
+            EndHudBand(cl, display, hudLine);
+            hudDone = TRUE;
+        }
+
+        // WAIT only compares 8 bits of vpos; get past line 255 first
+        if (vpos > 0xFF && !wrapped)
+        {
+            CopperWait(cl, 0xFF, 0xDE);
+            wrapped = TRUE;
+        }
+
+        CopperWait(cl, vpos, 0);
+        CopperMove(cl, COPREG(color), display->bandColors[band][0]);
+        CopperMove(cl, COPREG(color) + 2, display->bandColors[band][1]);
+    }
+
+    if (!hudDone)
+    {
+        EndHudBand(cl, display, hudLine);
+    }
+
+    // The wrap is always below the HUD band
+    if (display->scroll)
+    {
+        WrapBitmap(cl, display);
+        CopperPatchScroll(cl, display, 0);
+    }
+
+    CopperEnd(cl);
+}
+
+void CopperPatchField(struct CopperList* cl, const struct CopperDisplay* display, int field)
+{
+    ULONG offset = field == 1 ? display->modulo : 0;
+    ULONG lead = display->scroll ? COPPER_SCROLL_LEAD : 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        CopperPatchPointer(cl, COPSLOT_BPLPTH(i), display->planes[i] + offset - lead);
+    }
+    CopperPatchPointer(cl, COPSLOT_HUDPTH, display->hudPlane + offset - lead);
+
+    if (display->scroll)
+    {
+        CopperPatchScroll(cl, display, field);
+    }
+    else
+    {
+        ULONG plane = CopperSplitPlane(display->planes[3], display->hudLines, display->rowBytes, display->modulo);
+        CopperPatchPointer(cl, COPSLOT_BPLPTH(3), plane + offset);
+    }
+}
@@ -0,0 +1,162 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Small copper list builder. Instructions are appended with bounds checking
+// against the real allocation, and the value words of interesting moves are
+// remembered in named slots so they can be patched in place later without
+// rebuilding the list. Kept free of OS calls so the host tools can build it.
+
+#ifndef SPARKLER_COPPER_H
+#define SPARKLER_COPPER_H
+
+#include <stddef.h>
+#include <exec/types.h>
+#include <hardware/custom.h>
+
+// Register offset for a copper MOVE, e.g. COPREG(bplcon0) == 0x100
+#define COPREG(field) ((UWORD)offsetof(struct Custom, field))
+
+// First display line, as set in DIWSTRT
+#define COPPER_DISPLAY_TOP 0x2c
+
+// Named patch slots. Pointer slots cover the high word; the low word is the
+// next slot. Wait slots cover the first word of the WAIT. The slots for
+// colors 8-15 and plane 4 are the ones below the HUD band. BPLCON1 and the
+// scroll and wrap slots are only in lists built for scrolling.
+enum CopperSlot
+{
+    COPSLOT_BPLCON0,
+    COPSLOT_BPLCON1,
+    COPSLOT_BPL1MOD,
+    COPSLOT_BPL2MOD,
+    COPSLOT_DIWSTOP,
+    COPSLOT_HUDWAIT,
+    COPSLOT_SCROLLWAIT,
+    COPSLOT_WRAPWAIT255,
+    COPSLOT_WRAPWAIT,
+    COPSLOT_COLOR00,
+    COPSLOT_BPL1PTH = COPSLOT_COLOR00 + 16,
+    COPSLOT_HUDPTH = COPSLOT_BPL1PTH + 8,
+    COPSLOT_SCROLLPTH = COPSLOT_HUDPTH + 2,
+    COPSLOT_WRAPPTH = COPSLOT_SCROLLPTH + 6,
+    COPSLOT_COUNT = COPSLOT_WRAPPTH + 8
+};
+
+#define COPSLOT_COLOR(n) (COPSLOT_COLOR00 + (n))
+#define COPSLOT_BPLPTH(n) (COPSLOT_BPL1PTH + ((n) * 2))
+
+// Planes 1-3 below the HUD band, and all four after the bitmap wraps
+#define COPSLOT_SCROLLPTH_N(n) (COPSLOT_SCROLLPTH + ((n) * 2))
+#define COPSLOT_WRAPPTH_N(n) (COPSLOT_WRAPPTH + ((n) * 2))
+
+#define COPPER_NO_SLOT (-1)
+
+struct CopperList
+{
+    UWORD* words;
+    int capacity;       // in words
+    int count;          // words emitted so far, including any that did not fit
+    int written;        // words actually stored
+    BOOL overflow;
+    WORD slots[COPSLOT_COUNT];
+};
+
+// Start a list in the given memory. With words == NULL nothing is written
+// and count only measures how big the list would be.
+void CopperInit(struct CopperList* cl, UWORD* words, ULONG sizeBytes);
+
+void CopperMove(struct CopperList* cl, UWORD reg, UWORD value);
+
+// MOVE whose value word can later be changed with CopperPatch()
+void CopperMoveSlot(struct CopperList* cl, int slot, UWORD reg, UWORD value);
+
+// Two MOVEs loading a 32-bit pointer register pair; slot is the high word
+void CopperMovePointer(struct CopperList* cl, int slot, UWORD reg, ULONG value);
+
+void CopperWait(struct CopperList* cl, int vpos, int hpos);
+
+// WAIT whose beam position can later be changed with CopperPatchWait()
+void CopperWaitSlot(struct CopperList* cl, int slot, int vpos, int hpos);
+void CopperSkip(struct CopperList* cl, int vpos, int hpos);
+
+// Terminate the list. Space for this is always kept, even on overflow.
+void CopperEnd(struct CopperList* cl);
+
+// Bytes needed to hold a list that measured count words
+#define COPPER_LIST_BYTES(cl) ((ULONG)(cl)->count * 2)
+
+// Rewrite the value word of a slot; FALSE if the list has no such slot
+BOOL CopperPatch(struct CopperList* cl, int slot, UWORD value);
+BOOL CopperPatchPointer(struct CopperList* cl, int slot, ULONG value);
+BOOL CopperPatchWait(struct CopperList* cl, int slot, int vpos, int hpos);
+
+// What the Sparkler display lists are built from
+struct CopperDisplay
+{
+    BOOL hires;
+    BOOL interlaced;
+    BOOL pal;
+    UWORD modulo;       // bytes skipped per line, one line for interlace
+    UWORD rowBytes;     // bytes in a bitmap row
+    ULONG planes[4];
+    ULONG hudPlane;     // shown as plane 4 in the HUD band
+    UWORD colors[16];
+    UWORD hudColor;     // colors 8-15 in the HUD band
+    UWORD hudLines;     // lines at the top that show the HUD overlay
+    UWORD bandRows;     // bitmap rows per color band, 0 for no bands
+    UWORD bandCount;
+    const UWORD (*bandColors)[2];   // COLOR00 and COLOR01 for each band
+    BOOL scroll;        // hardware scrolling below the HUD band, no bands
+    ULONG scrollX;      // in BPLCON1 steps, one lores or two hires pixels
+    ULONG scrollY;      // in bitmap rows
+};
+
+// A scrolling display fetches one more word per line, starting that word
+// early, so its plane pointers start that many bytes further left
+#define COPPER_SCROLL_LEAD 2
+
+// Where one field of a scrolling display shows its scroll position. Offsets
+// are from the start of each plane.
+struct CopperScroll
+{
+    UWORD bplcon1;
+    ULONG split;        // plane offset on the first line below the HUD band
+    ULONG wrap;         // plane offset once the bitmap has wrapped
+    int wrapLine;       // line the copper wraps the bitmap on
+};
+
+// Build the list for a display. An interlaced display runs the same list
+// for both fields; it is built for field 0 and CopperPatchField() points it
+// at the other one. For the first hudLines lines plane 4 is the HUD overlay
+// and colors 8-15 are its pen; after that the copper points plane 4 at the
+// bitmap's row and loads the bitmap's colors 8-15. With bands, COLOR00 and
+// COLOR01 are reloaded on the line each band starts, counted in field 0
+// rows, so interlaced bands need an even bandRows to suit both fields. With
+// scroll the HUD band stays put and is one line longer, showing a blank row
+// of the HUD plane, and everything below it shows the scroll position,
+// wrapping to the top of the bitmap on the line it runs out.
+void CopperBuild(struct CopperList* cl, const struct CopperDisplay* display);
+
+// Point a list at the planes of a field: planes 1-3 and the HUD plane at
+// the top, and plane 4 below the HUD band, or the scroll position when the
+// list scrolls. Field 1 starts one line further down.
+void CopperPatchField(struct CopperList* cl, const struct CopperDisplay* display, int field);
+
+// Where the copper points plane 4 below the HUD band, before the field
+// offset. modulo is the one the display runs with.
+ULONG CopperSplitPlane(ULONG plane, UWORD hudLines, UWORD rowBytes, UWORD modulo);
+
+// Scroll positions across a display before they repeat: BPLCON1 steps in
+// a bitmap row, and rows the bitmap can move up before the line it wraps
+// on would reach the HUD band. A scrolled line that runs off the end of
+// its row shows the start of the next one, so the bitmap needs one more
+// row holding a copy of row 0.
+ULONG CopperScrollWidth(const struct CopperDisplay* display);
+ULONG CopperScrollHeight(const struct CopperDisplay* display);
+
+// Work out scrollX and scrollY of a scrolling display for a field
+void CopperScrollTo(struct CopperScroll* scroll, const struct CopperDisplay* display, int field);
+
+// Point a list built for scrolling at display's scroll position for a field
+// and its HUD band; nothing else in the list changes
+void CopperPatchScroll(struct CopperList* cl, const struct CopperDisplay* display, int field);
+
+#endif
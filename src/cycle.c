@@ -0,0 +1,70 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Color cycle programs, see cycle.h
+
+#include "cycle.h"
+
+static const char* kindNames[CYCLE_KIND_COUNT] = { "Flip", "Ramp", "Rotate", "Invert" };
+
+const char* CycleKindName(int kind)
+{
+    return kind >= 0 && kind < CYCLE_KIND_COUNT ? kindNames[kind] : "?";
+}
+
+int CycleBuild(int kind, const UWORD* palette, UWORD (*palettes)[16])
+{
+    int steps = 0;
+
+    switch (kind)
+    {
+    case CYCLE_FLIP:
+    case CYCLE_INVERT:
+        steps = 2;
+        break;
+
+    case CYCLE_RAMP:
+        steps = 16;
+        break;
+
+    case CYCLE_ROTATE:
+        steps = 15;
+        break;
+    }
+
+    for (int step = 0; step < steps; step++)
+    {
+        UWORD* colors = palettes[step];
+
+        for (int i = 0; i < 16; i++)
+        {
+            colors[i] = palette[i];
+        }
+
+        switch (kind)
+        {
+        case CYCLE_FLIP:
+            colors[0] = palette[step];
+            colors[1] = palette[step ^ 1];
+            break;
+
+        case CYCLE_RAMP:
+            colors[1] = (UWORD)(step * 0x111);
+            break;
+
+        case CYCLE_ROTATE:
+            for (int i = 1; i < 16; i++)
+            {
+                colors[i] = palette[1 + ((i - 1 + step) % 15)];
+            }
+            break;
+
+        case CYCLE_INVERT:
+            for (int i = 0; step == 1 && i < 16; i++)
+            {
+                colors[i] = palette[i] ^ 0xFFF;
+            }
+            break;
+        }
+    }
+
+    return steps;
+}
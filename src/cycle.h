@@ -0,0 +1,31 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Color cycle programs: short loops of whole palettes, built up front from
+// the palette on screen so the vertical blank server only has to step
+// through a table. Kept free of OS calls so the host tools can build it too.
+
+#ifndef SPARKLER_CYCLE_H
+#define SPARKLER_CYCLE_H
+
+#include <exec/types.h>
+
+#define CYCLE_MAX_STEPS 16
+
+#define CYCLE_HOLD_FRAMES 1
+#define CYCLE_MAX_HOLD_FRAMES 64
+
+enum CycleKind
+{
+    CYCLE_FLIP,         // C0 and C1 swap places every step
+    CYCLE_RAMP,         // C1 through the 16 grays, C0 held
+    CYCLE_ROTATE,       // colors 1-15 rotate one place every step
+    CYCLE_INVERT,       // the palette and its complement
+    CYCLE_KIND_COUNT
+};
+
+const char* CycleKindName(int kind);
+
+// Fill palettes with the steps of kind, starting from palette. Returns the
+// number of steps.
+int CycleBuild(int kind, const UWORD* palette, UWORD (*palettes)[16]);
+
+#endif
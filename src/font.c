@@ -0,0 +1,206 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Built-in fixed width font, drawn straight into a bitplane. Kept free of
+// OS calls so the host tools can build it too.
+
+#include "font.h"
+
+// Printable ASCII, one byte per row, leftmost pixel in bit 7. Glyphs are
+// five pixels wide in columns 1-5; row 7 is for descenders.
+static const UBYTE fontGlyphs[FONT_LAST_CHAR - FONT_FIRST_CHAR + 1][FONT_HEIGHT] =
+{
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // ' '
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x00 },  // '!'
+    { 0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00 },  // '"'
+    { 0x28, 0x28, 0x7c, 0x28, 0x7c, 0x28, 0x28, 0x00 },  // '#'
+    { 0x10, 0x3c, 0x50, 0x38, 0x14, 0x78, 0x10, 0x00 },  // '$'
+    { 0x60, 0x64, 0x08, 0x10, 0x20, 0x4c, 0x0c, 0x00 },  // '%'
+    { 0x30, 0x48, 0x50, 0x20, 0x54, 0x48, 0x34, 0x00 },  // '&'
+    { 0x10, 0x10, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00 },  // apostrophe
+    { 0x08, 0x10, 0x20, 0x20, 0x20, 0x10, 0x08, 0x00 },  // '('
+    { 0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00 },  // ')'
+    { 0x00, 0x10, 0x54, 0x38, 0x54, 0x10, 0x00, 0x00 },  // '*'
+    { 0x00, 0x10, 0x10, 0x7c, 0x10, 0x10, 0x00, 0x00 },  // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x20 },  // ','
+    { 0x00, 0x00, 0x00, 0x7c, 0x00, 0x00, 0x00, 0x00 },  // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x30, 0x00 },  // '.'
+    { 0x00, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, 0x00 },  // '/'
+    { 0x38, 0x44, 0x4c, 0x54, 0x64, 0x44, 0x38, 0x00 },  // '0'
+    { 0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },  // '1'
+    { 0x38, 0x44, 0x04, 0x08, 0x10, 0x20, 0x7c, 0x00 },  // '2'
+    { 0x7c, 0x08, 0x10, 0x08, 0x04, 0x44, 0x38, 0x00 },  // '3'
+    { 0x08, 0x18, 0x28, 0x48, 0x7c, 0x08, 0x08, 0x00 },  // '4'
+    { 0x7c, 0x40, 0x78, 0x04, 0x04, 0x44, 0x38, 0x00 },  // '5'
+    { 0x18, 0x20, 0x40, 0x78, 0x44, 0x44, 0x38, 0x00 },  // '6'
+    { 0x7c, 0x04, 0x08, 0x10, 0x20, 0x20, 0x20, 0x00 },  // '7'
+    { 0x38, 0x44, 0x44, 0x38, 0x44, 0x44, 0x38, 0x00 },  // '8'
+    { 0x38, 0x44, 0x44, 0x3c, 0x04, 0x08, 0x30, 0x00 },  // '9'
+    { 0x00, 0x30, 0x30, 0x00, 0x30, 0x30, 0x00, 0x00 },  // ':'
+    { 0x00, 0x30, 0x30, 0x00, 0x30, 0x30, 0x20, 0x00 },  // ';'
+    { 0x08, 0x10, 0x20, 0x40, 0x20, 0x10, 0x08, 0x00 },  // '<'
+    { 0x00, 0x00, 0x7c, 0x00, 0x7c, 0x00, 0x00, 0x00 },  // '='
+    { 0x20, 0x10, 0x08, 0x04, 0x08, 0x10, 0x20, 0x00 },  // '>'
+    { 0x38, 0x44, 0x04, 0x08, 0x10, 0x00, 0x10, 0x00 },  // '?'
+    { 0x38, 0x44, 0x04, 0x34, 0x54, 0x54, 0x38, 0x00 },  // '@'
+    { 0x38, 0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x00 },  // 'A'
+    { 0x78, 0x44, 0x44, 0x78, 0x44, 0x44, 0x78, 0x00 },  // 'B'
+    { 0x38, 0x44, 0x40, 0x40, 0x40, 0x44, 0x38, 0x00 },  // 'C'
+    { 0x70, 0x48, 0x44, 0x44, 0x44, 0x48, 0x70, 0x00 },  // 'D'
+    { 0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7c, 0x00 },  // 'E'
+    { 0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00 },  // 'F'
+    { 0x38, 0x44, 0x40, 0x5c, 0x44, 0x44, 0x3c, 0x00 },  // 'G'
+    { 0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x44, 0x00 },  // 'H'
+    { 0x38, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },  // 'I'
+    { 0x1c, 0x08, 0x08, 0x08, 0x08, 0x48, 0x30, 0x00 },  // 'J'
+    { 0x44, 0x48, 0x50, 0x60, 0x50, 0x48, 0x44, 0x00 },  // 'K'
+    { 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7c, 0x00 },  // 'L'
+    { 0x44, 0x6c, 0x54, 0x54, 0x44, 0x44, 0x44, 0x00 },  // 'M'
+    { 0x44, 0x44, 0x64, 0x54, 0x4c, 0x44, 0x44, 0x00 },  // 'N'
+    { 0x38, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00 },  // 'O'
+    { 0x78, 0x44, 0x44, 0x78, 0x40, 0x40, 0x40, 0x00 },  // 'P'
+    { 0x38, 0x44, 0x44, 0x44, 0x54, 0x48, 0x34, 0x00 },  // 'Q'
+    { 0x78, 0x44, 0x44, 0x78, 0x50, 0x48, 0x44, 0x00 },  // 'R'
+    { 0x3c, 0x40, 0x40, 0x38, 0x04, 0x04, 0x78, 0x00 },  // 'S'
+    { 0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 },  // 'T'
+    { 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00 },  // 'U'
+    { 0x44, 0x44, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00 },  // 'V'
+    { 0x44, 0x44, 0x44, 0x54, 0x54, 0x54, 0x28, 0x00 },  // 'W'
+    { 0x44, 0x44, 0x28, 0x10, 0x28, 0x44, 0x44, 0x00 },  // 'X'
+    { 0x44, 0x44, 0x44, 0x28, 0x10, 0x10, 0x10, 0x00 },  // 'Y'
+    { 0x7c, 0x04, 0x08, 0x10, 0x20, 0x40, 0x7c, 0x00 },  // 'Z'
+    { 0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x38, 0x00 },  // '['
+    { 0x00, 0x40, 0x20, 0x10, 0x08, 0x04, 0x00, 0x00 },  // backslash
+    { 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00 },  // ']'
+    { 0x10, 0x28, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00 },  // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c },  // '_'
+    { 0x20, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00 },  // '`'
+    { 0x00, 0x00, 0x38, 0x04, 0x3c, 0x44, 0x3c, 0x00 },  // 'a'
+    { 0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x78, 0x00 },  // 'b'
+    { 0x00, 0x00, 0x38, 0x40, 0x40, 0x44, 0x38, 0x00 },  // 'c'
+    { 0x04, 0x04, 0x34, 0x4c, 0x44, 0x44, 0x3c, 0x00 },  // 'd'
+    { 0x00, 0x00, 0x38, 0x44, 0x7c, 0x40, 0x38, 0x00 },  // 'e'
+    { 0x18, 0x24, 0x20, 0x70, 0x20, 0x20, 0x20, 0x00 },  // 'f'
+    { 0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x38 },  // 'g'
+    { 0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00 },  // 'h'
+    { 0x10, 0x00, 0x30, 0x10, 0x10, 0x10, 0x38, 0x00 },  // 'i'
+    { 0x08, 0x00, 0x18, 0x08, 0x08, 0x08, 0x48, 0x30 },  // 'j'
+    { 0x40, 0x40, 0x48, 0x50, 0x60, 0x50, 0x48, 0x00 },  // 'k'
+    { 0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },  // 'l'
+    { 0x00, 0x00, 0x68, 0x54, 0x54, 0x44, 0x44, 0x00 },  // 'm'
+    { 0x00, 0x00, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00 },  // 'n'
+    { 0x00, 0x00, 0x38, 0x44, 0x44, 0x44, 0x38, 0x00 },  // 'o'
+    { 0x00, 0x00, 0x78, 0x44, 0x44, 0x78, 0x40, 0x40 },  // 'p'
+    { 0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x04 },  // 'q'
+    { 0x00, 0x00, 0x58, 0x64, 0x40, 0x40, 0x40, 0x00 },  // 'r'
+    { 0x00, 0x00, 0x3c, 0x40, 0x38, 0x04, 0x78, 0x00 },  // 's'
+    { 0x20, 0x20, 0x70, 0x20, 0x20, 0x24, 0x18, 0x00 },  // 't'
+    { 0x00, 0x00, 0x44, 0x44, 0x44, 0x4c, 0x34, 0x00 },  // 'u'
+    { 0x00, 0x00, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00 },  // 'v'
+    { 0x00, 0x00, 0x44, 0x44, 0x54, 0x54, 0x28, 0x00 },  // 'w'
+    { 0x00, 0x00, 0x44, 0x28, 0x10, 0x28, 0x44, 0x00 },  // 'x'
+    { 0x00, 0x00, 0x44, 0x44, 0x44, 0x3c, 0x04, 0x38 },  // 'y'
+    { 0x00, 0x00, 0x7c, 0x08, 0x10, 0x20, 0x7c, 0x00 },  // 'z'
+    { 0x08, 0x10, 0x10, 0x20, 0x10, 0x10, 0x08, 0x00 },  // '{'
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 },  // '|'
+    { 0x20, 0x10, 0x10, 0x08, 0x10, 0x10, 0x20, 0x00 },  // '}'
+    { 0x00, 0x00, 0x20, 0x54, 0x08, 0x00, 0x00, 0x00 },  // '~'
+};
+
+static const UBYTE* Glyph(char c)
+{
+    UBYTE code = (UBYTE)c;
+    if (code < FONT_FIRST_CHAR || code > FONT_LAST_CHAR)
+    {
+        code = '?';
+    }
+
+    return fontGlyphs[code - FONT_FIRST_CHAR];
+}
+
+int FontDrawText(UBYTE* plane, int bytesPerRow, int rows, int x, int top, const char* text, int maxWidth)
+{
+    if (x < 0 || top < 0 || top + FONT_HEIGHT > rows)
+        return 0;
+
+    // Whole characters only, inside both the box and the row
+    int fits = maxWidth / FONT_WIDTH;
+    int rowFits = (bytesPerRow * 8 - x) / FONT_WIDTH;
+    if (rowFits < fits)
+        fits = rowFits;
+
+    UBYTE* line = plane + top * bytesPerRow;
+    int shift = x & 7;
+    int count = 0;
+
+    // Cells on byte boundaries are a single store per row. Anywhere else a
+    // cell straddles two bytes and is merged in with masks.
+    UBYTE leftMask = (UBYTE)(0xFF >> shift);
+    UBYTE rightMask = (UBYTE)~leftMask;
+
+    for (; count < fits && text[count] != '\0'; count++)
+    {
+        const UBYTE* glyph = Glyph(text[count]);
+        UBYTE* dst = line + (x >> 3) + count;
+
+        if (shift == 0)
+        {
+            for (int row = 0; row < FONT_HEIGHT; row++)
+            {
+                *dst = glyph[row];
+                dst += bytesPerRow;
+            }
+        }
+        else
+        {
+            // The right half falls off the end of the row for the last cell
+            BOOL right = (x >> 3) + count + 1 < bytesPerRow;
+
+            for (int row = 0; row < FONT_HEIGHT; row++)
+            {
+                dst[0] = (UBYTE)((dst[0] & ~leftMask) | (glyph[row] >> shift));
+                if (right)
+                    dst[1] = (UBYTE)((dst[1] & ~rightMask) | (glyph[row] << (8 - shift)));
+                dst += bytesPerRow;
+            }
+        }
+    }
+
+    return count * FONT_WIDTH;
+}
+
+void FontClearBox(UBYTE* plane, int bytesPerRow, int x, int top, int width, int height)
+{
+    int left = x;
+    int right = x + width;          // exclusive
+
+    if (left < 0)
+        left = 0;
+    if (right > bytesPerRow * 8)
+        right = bytesPerRow * 8;
+    if (left >= right || height <= 0)
+        return;
+
+    int firstByte = left >> 3;
+    int lastByte = (right - 1) >> 3;
+    UBYTE firstMask = (UBYTE)(0xFF >> (left & 7));
+    UBYTE lastMask = (UBYTE)(0xFF << (7 - ((right - 1) & 7)));
+
+    if (firstByte == lastByte)
+    {
+        firstMask &= lastMask;
+    }
+
+    UBYTE* line = plane + top * bytesPerRow;
+    for (int row = 0; row < height; row++)
+    {
+        line[firstByte] &= (UBYTE)~firstMask;
+        if (lastByte > firstByte)
+        {
+            for (int i = firstByte + 1; i < lastByte; i++)
+            {
+                line[i] = 0;
+            }
+            line[lastByte] &= (UBYTE)~lastMask;
+        }
+        line += bytesPerRow;
+    }
+}
@@ -0,0 +1,27 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Built-in 8x8 font for the HUD. Replaces diskfont.library and Text() with
+// a renderer that writes glyph rows straight into one bitplane, so the
+// host tools can draw the same pixels.
+
+#ifndef SPARKLER_FONT_H
+#define SPARKLER_FONT_H
+
+#include <exec/types.h>
+
+#define FONT_WIDTH 8
+#define FONT_HEIGHT 8
+#define FONT_BASELINE 6         // row of the baseline within a cell
+
+#define FONT_FIRST_CHAR 32
+#define FONT_LAST_CHAR 126
+
+// Draw text with its cells' top row at top. Cells are opaque, so whatever
+// was under them is replaced. Stops at the first character that would
+// cross maxWidth or the end of the row; returns the width drawn. Characters
+// outside printable ASCII draw as '?'.
+int FontDrawText(UBYTE* plane, int bytesPerRow, int rows, int x, int top, const char* text, int maxWidth);
+
+// Clear a box of pixels
+void FontClearBox(UBYTE* plane, int bytesPerRow, int x, int top, int width, int height);
+
+#endif
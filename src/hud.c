@@ -0,0 +1,181 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Debug text overlay, see hud.h
+
+#include <exec/types.h>
+#include <string.h>
+
+#include "font.h"
+#include "hud.h"
+
+#define HUD_LINE_HEIGHT 10
+#define HUD_HELP_LINE_HEIGHT 9
+
+struct HudFieldState
+{
+    WORD x;
+    WORD top;
+    WORD width;         // cleared before every redraw
+    ULONG key;
+    BOOL valid;         // key and text are up to date
+    BOOL dirty;
+    char text[HUD_FIELD_CHARS];
+};
+
+// Characters each field is given, plus two for the gap to the next one,
+// sized for values of up to four digits. Text for larger ones is cut at
+// HUD_FIELD_CHARS - 1 characters and drawn only as wide as the field,
+// apart from the last field on a line, which takes the rest of it.
+static const UBYTE fieldChars[HUD_FIELD_COUNT] =
+{
+    16,     // NTSC 640x400 I:0
+    11,     // P:8 k:4 96%
+    15,     // C0(R:0 G:0 B:0)
+    15,     // C1(R:0 G:0 B:0)
+    16,     // E15(R:0 G:0 B:0)
+    16,     // Scroll X:-8 Y:-8
+    26,     // Cache H:0000 M:0000 E:0000
+    37,     // Bands 16 rows: 000/000 to 000/000
+    39,     // Sweep BitDiff 16777215/16777216 x256 on
+    39,     // Stress BSC bus:100% blit:100% cpu:100%
+    39,     // Lines Pattern min:9999 avg:9999 max:9999
+};
+
+static const char* helpLines[] =
+{
+    "F1: Toggle lores/hires, F2: Toggle interlaced",
+    "F3, F4, F5: Color 0 RGB - hold SHIFT for reverse direction",
+    "F8, F9, F10: Color 1 RGB - hold SHIFT for reverse direction",
+    "Number keys 1-7: Change image pattern, 8: De Bruijn, 9: Order",
+    "0: Multi-plane pattern, N: Noise with a new seed, TAB: Palette entry",
+    "R, G, B: Palette entry RGB - hold SHIFT for reverse direction",
+    "F6: Color bands, F7: Band height, [ ]: Previous/next bands",
+    "S: Start/stop sweep, O: Sweep order, - =: Frames per step",
+    "C: Color cycle, V: Cycle kind, H: Frames per step",
+    "M: Hardware scroll, Cursor keys: Speed, I: Image file",
+    "Q, W, E: Stress blitter, sprites, CPU, P: Profiled phase",
+    "SPACE: NTSC/PAL, ESC: Exit, HELP: Help",
+};
+
+#define HELP_LINE_COUNT ((int)(sizeof(helpLines) / sizeof(helpLines[0])))
+
+static UBYTE* pPlane = NULL;
+static int bytesPerRow = 80;
+static struct HudFieldState fields[HUD_FIELD_COUNT];
+static int hudRows = 0;
+
+static void DrawLine(int x, int top, const char* text, int maxWidth)
+{
+    FontDrawText(pPlane, bytesPerRow, HUD_MAX_ROWS, x, top, text, maxWidth);
+}
+
+void HudInit(UBYTE* plane)
+{
+    pPlane = plane;
+    hudRows = 0;
+}
+
+UBYTE* HudPlane()
+{
+    return pPlane;
+}
+
+int HudLayout(int width, BOOL showHelp)
+{
+    // Clear what the last layout drew, with its row length
+    FontClearBox(pPlane, bytesPerRow, 0, 0, bytesPerRow * 8, hudRows);
+
+    // Laid out with the display's row length so the copper modulo works
+    // for both
+    bytesPerRow = width / 8;
+
+    // Byte aligned cells draw fastest
+    int margin = width >= 640 ? 16 : 0;
+    int top = 2;
+
+    DrawLine(margin, top, "Sparkler V1.0 - RGB2HDMI Test Tool - by Bloodmosher", width - margin);
+
+    // Flow the fields after the title, wrapping where the display is too
+    // narrow; the cache line always starts a line of its own
+    int x = margin;
+    top += HUD_LINE_HEIGHT;
+
+    for (int i = 0; i < HUD_FIELD_COUNT; i++)
+    {
+        struct HudFieldState* pField = &fields[i];
+        int fieldWidth = (fieldChars[i] + 2) * FONT_WIDTH;
+
+        if (x > margin && (i == HUD_CACHE || x + fieldWidth > width))
+        {
+            x = margin;
+            top += HUD_LINE_HEIGHT;
+        }
+
+        pField->x = x;
+        pField->top = top;
+        pField->width = fieldWidth;
+        pField->valid = FALSE;
+        pField->dirty = FALSE;
+        x += fieldWidth;
+    }
+
+    // The last field on each line may use the rest of it
+    for (int i = 0; i < HUD_FIELD_COUNT; i++)
+    {
+        if (i == HUD_FIELD_COUNT - 1 || fields[i + 1].top != fields[i].top)
+            fields[i].width = width - fields[i].x;
+    }
+
+    if (showHelp)
+    {
+        int helpX = width >= 640 ? 16 : 8;
+        int lineTop = top + HUD_LINE_HEIGHT + 3;
+
+        for (int i = 0; i < HELP_LINE_COUNT && lineTop + FONT_HEIGHT <= HUD_MAX_ROWS; i++)
+        {
+            DrawLine(helpX, lineTop, helpLines[i], width - helpX);
+            top = lineTop;
+            lineTop += HUD_HELP_LINE_HEIGHT;
+        }
+    }
+
+    // one blank row under the last line
+    hudRows = top + FONT_HEIGHT + 1;
+    if (hudRows > HUD_MAX_ROWS)
+        hudRows = HUD_MAX_ROWS;
+
+    return hudRows;
+}
+
+int HudRows()
+{
+    return hudRows;
+}
+
+char* HudFieldText(int field, ULONG key)
+{
+    struct HudFieldState* pField = &fields[field];
+
+    if (pField->valid && pField->key == key)
+        return NULL;
+
+    pField->key = key;
+    pField->valid = TRUE;
+    pField->dirty = TRUE;
+    return pField->text;
+}
+
+void HudRender()
+{
+    for (int i = 0; i < HUD_FIELD_COUNT; i++)
+    {
+        struct HudFieldState* pField = &fields[i];
+        if (!pField->dirty)
+            continue;
+
+        // Cells are opaque, so only the part past the new text needs clearing
+        int drawn = FontDrawText(pPlane, bytesPerRow, HUD_MAX_ROWS, pField->x, pField->top, pField->text, pField->width);
+        FontClearBox(pPlane, bytesPerRow, pField->x + drawn, pField->top, pField->width - drawn, FONT_HEIGHT);
+
+        pField->dirty = FALSE;
+    }
+}
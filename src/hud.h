@@ -0,0 +1,61 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Debug text overlay. The text lives in its own bitplane, shown as plane 4
+// in a band at the top of the display, so the test pattern is never drawn
+// over. Each status field keeps its last value and is only redrawn when
+// that value changes. Drawing uses the built-in font and no OS calls, so
+// the host tools can render the same overlay.
+
+#ifndef SPARKLER_HUD_H
+#define SPARKLER_HUD_H
+
+#include <exec/types.h>
+
+// Overlay plane size, wide enough for hires, with two blank rows below the
+// last for the line a scrolling display adds to the band. A full band still
+// leaves rows of a 200 line display to scroll.
+#define HUD_MAX_ROWS 194
+#define HUD_PLANE_BYTES (80L * (HUD_MAX_ROWS + 2))
+
+// Text pen; plane 4 set selects colors 8-15, which hold it in the HUD band
+#define HUD_TEXT_COLOR 0x888
+
+// Room for a field's text and its terminating zero
+#define HUD_FIELD_CHARS 40
+
+enum HudField
+{
+    HUD_VIDEO,          // standard, size and interlace
+    HUD_PATTERN,
+    HUD_COLOR0,
+    HUD_COLOR1,
+    HUD_PALETTE,        // palette entry being edited
+    HUD_SCROLL,         // scroll speeds
+    HUD_CACHE,
+    HUD_BANDS,          // color band legend
+    HUD_SWEEP,          // or the color cycle while it runs
+    HUD_STRESS,         // loads on and the bus load they make
+    HUD_PROFILE,        // lines one profiled phase takes
+    HUD_FIELD_COUNT
+};
+
+// Use plane for the overlay: HUD_PLANE_BYTES of chip RAM, cleared
+void HudInit(UBYTE* plane);
+
+// The plane given to HudInit
+UBYTE* HudPlane(void);
+
+// Clear the plane for a display width, draw the title and help text, and
+// mark every field dirty. Returns the rows in use.
+int HudLayout(int width, BOOL showHelp);
+
+// Rows drawn by the last layout
+int HudRows(void);
+
+// Returns the field's text buffer to fill in if key differs from the value
+// it was last drawn for, else NULL
+char* HudFieldText(int field, ULONG key);
+
+// Draw the fields that changed
+void HudRender(void);
+
+#endif
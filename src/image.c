@@ -0,0 +1,339 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// IFF ILBM and raw planar images, see image.h. The file is read in blocks
+// of IMAGE_READ_BYTES and ByteRun1 runs are unpacked from the block into
+// the bitplane rows; nothing is built up in a chunky buffer first.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "image.h"
+
+// BMHD masking that adds a mask plane to every row of the BODY
+#define MASKING_HAS_MASK 1
+
+// BMHD compression values
+#define COMPRESSION_NONE 0
+#define COMPRESSION_BYTERUN1 1
+
+static UBYTE readBuffer[IMAGE_READ_BYTES];
+
+// The unread part of readBuffer
+struct Stream
+{
+    FILE* file;
+    const UBYTE* next;
+    const UBYTE* end;
+};
+
+static const char* errorTexts[IMAGE_ERROR_COUNT] =
+{
+    "ok",
+    "can't open",
+    "file ends early",
+    "not an ILBM",
+    "chunk runs past the FORM",
+    "bad or missing BMHD",
+    "more than 4 planes",
+    "unknown compression",
+    "run crosses a row",
+    "no BODY",
+    "not whole planes of the display",
+};
+
+static BOOL Fill(struct Stream* stream)
+{
+    size_t got = fread(readBuffer, 1, IMAGE_READ_BYTES, stream->file);
+    stream->next = readBuffer;
+    stream->end = readBuffer + got;
+    return got != 0;
+}
+
+// Next byte, or -1 at the end of the file
+static int NextByte(struct Stream* stream)
+{
+    if (stream->next == stream->end && !Fill(stream))
+        return -1;
+
+    return *stream->next++;
+}
+
+// Copy count bytes to dest, or pass over them with dest NULL. FALSE if the
+// file ends first.
+static BOOL Take(struct Stream* stream, UBYTE* dest, ULONG count)
+{
+    while (count > 0)
+    {
+        if (stream->next == stream->end && !Fill(stream))
+            return FALSE;
+
+        ULONG bytes = stream->end - stream->next;
+        if (bytes > count)
+            bytes = count;
+
+        if (dest != NULL)
+        {
+            memcpy(dest, stream->next, bytes);
+            dest += bytes;
+        }
+        stream->next += bytes;
+        count -= bytes;
+    }
+
+    return TRUE;
+}
+
+static ULONG BigLong(const UBYTE* bytes)
+{
+    return ((ULONG)bytes[0] << 24) | ((ULONG)bytes[1] << 16) | ((ULONG)bytes[2] << 8) | bytes[3];
+}
+
+static UWORD BigWord(const UBYTE* bytes)
+{
+    return (UWORD)((bytes[0] << 8) | bytes[1]);
+}
+
+// Unpack one ByteRun1 row of rowBytes bytes, keeping the first keep of them
+// at dest. Runs may not cross the end of the row.
+static int UnpackRow(struct Stream* stream, UBYTE* dest, int rowBytes, int keep)
+{
+    int x = 0;
+
+    while (x < rowBytes)
+    {
+        int n = NextByte(stream);
+        if (n < 0)
+            return IMAGE_TRUNCATED;
+
+        // 128 is a no-op
+        if (n == 128)
+            continue;
+
+        int count = n < 128 ? n + 1 : 257 - n;
+        if (x + count > rowBytes)
+            return IMAGE_BAD_RUN;
+
+        int kept = keep - x;
+        if (kept > count)
+            kept = count;
+        if (kept < 0)
+            kept = 0;
+
+        if (n < 128)
+        {
+            // literal bytes, straight from the read block
+            if (!Take(stream, kept > 0 ? dest + x : NULL, kept) || !Take(stream, NULL, count - kept))
+                return IMAGE_TRUNCATED;
+        }
+        else
+        {
+            int value = NextByte(stream);
+            if (value < 0)
+                return IMAGE_TRUNCATED;
+            if (kept > 0)
+                memset(dest + x, value, kept);
+        }
+
+        x += count;
+    }
+
+    return IMAGE_OK;
+}
+
+static int CopyRow(struct Stream* stream, UBYTE* dest, int rowBytes, int keep)
+{
+    if (!Take(stream, dest, keep) || !Take(stream, NULL, rowBytes - keep))
+        return IMAGE_TRUNCATED;
+
+    return IMAGE_OK;
+}
+
+// Rows past the bitmap are never read, so a tall image costs no more than
+// the part that is shown
+static int ReadBody(struct Stream* stream, const struct ImageInfo* info, int masking, int compression,
+                        UBYTE** planes, int depth, int bytesPerRow, int height)
+{
+    int rowBytes = ((info->width + 15) >> 4) << 1;
+    int keep = rowBytes < bytesPerRow ? rowBytes : bytesPerRow;
+    int rows = info->height < height ? info->height : height;
+    int filePlanes = info->depth + (masking == MASKING_HAS_MASK ? 1 : 0);
+
+    for (int y = 0; y < rows; y++)
+    {
+        for (int p = 0; p < filePlanes; p++)
+        {
+            BOOL shown = p < info->depth && p < depth;
+            UBYTE* dest = shown ? planes[p] + ((ULONG)y * bytesPerRow) : NULL;
+
+            int error = compression == COMPRESSION_BYTERUN1
+                            ? UnpackRow(stream, dest, rowBytes, shown ? keep : 0)
+                            : CopyRow(stream, dest, rowBytes, shown ? keep : 0);
+            if (error != IMAGE_OK)
+                return error;
+        }
+    }
+
+    // Clear what the image does not cover
+    for (int p = 0; p < depth; p++)
+    {
+        if (p >= info->depth)
+        {
+            memset(planes[p], 0, (ULONG)bytesPerRow * height);
+            continue;
+        }
+
+        if (keep < bytesPerRow)
+        {
+            for (int y = 0; y < rows; y++)
+            {
+                memset(planes[p] + ((ULONG)y * bytesPerRow) + keep, 0, bytesPerRow - keep);
+            }
+        }
+
+        if (rows < height)
+            memset(planes[p] + ((ULONG)rows * bytesPerRow), 0, (ULONG)(height - rows) * bytesPerRow);
+    }
+
+    return IMAGE_OK;
+}
+
+// One plane after the other, each read in one go
+static int LoadRaw(FILE* file, struct ImageInfo* info, UBYTE** planes, int depth, int bytesPerRow, int height)
+{
+    if (fseek(file, 0, SEEK_END) != 0)
+        return IMAGE_TRUNCATED;
+    long length = ftell(file);
+    if (length <= 0 || fseek(file, 0, SEEK_SET) != 0)
+        return IMAGE_BAD_SIZE;
+
+    info->raw = TRUE;
+    info->rawBytes = (ULONG)length;
+    if (planes == NULL)
+        return IMAGE_OK;
+
+    ULONG planeBytes = (ULONG)bytesPerRow * height;
+    if (info->rawBytes % planeBytes != 0 || info->rawBytes / planeBytes > (ULONG)depth)
+        return IMAGE_BAD_SIZE;
+
+    info->depth = (UWORD)(info->rawBytes / planeBytes);
+    for (int p = 0; p < depth; p++)
+    {
+        if (p >= info->depth)
+            memset(planes[p], 0, planeBytes);
+        else if (fread(planes[p], 1, planeBytes, file) != planeBytes)
+            return IMAGE_TRUNCATED;
+    }
+
+    return IMAGE_OK;
+}
+
+int ImageLoad(FILE* file, struct ImageInfo* info, UBYTE** planes, int depth, int bytesPerRow, int height)
+{
+    struct Stream stream = { file, readBuffer, readBuffer };
+    UBYTE header[12];
+
+    memset(info, 0, sizeof(*info));
+
+    if (!Take(&stream, header, 4) || memcmp(header, "FORM", 4) != 0)
+        return LoadRaw(file, info, planes, depth, bytesPerRow, height);
+
+    if (!Take(&stream, header + 4, 8))
+        return IMAGE_TRUNCATED;
+    if (memcmp(header + 8, "ILBM", 4) != 0)
+        return IMAGE_NOT_ILBM;
+
+    ULONG formLeft = BigLong(header + 4);
+    if (formLeft < 4)
+        return IMAGE_BAD_CHUNK;
+    formLeft -= 4;
+
+    BOOL haveHeader = FALSE;
+    int masking = 0;
+    int compression = COMPRESSION_NONE;
+
+    while (formLeft >= 8)
+    {
+        UBYTE chunk[8];
+        if (!Take(&stream, chunk, 8))
+            return IMAGE_TRUNCATED;
+        formLeft -= 8;
+
+        ULONG length = BigLong(chunk + 4);
+        if (length > formLeft)
+            return IMAGE_BAD_CHUNK;
+
+        // The pad byte of an odd chunk may be missing at the end of the FORM
+        ULONG padded = length + (length & 1);
+        formLeft -= padded < formLeft ? padded : formLeft;
+
+        ULONG used = 0;
+        if (memcmp(chunk, "BMHD", 4) == 0)
+        {
+            UBYTE bmhd[20];
+            if (length < sizeof(bmhd))
+                return IMAGE_BAD_HEADER;
+            if (!Take(&stream, bmhd, sizeof(bmhd)))
+                return IMAGE_TRUNCATED;
+            used = sizeof(bmhd);
+
+            info->width = BigWord(bmhd);
+            info->height = BigWord(bmhd + 2);
+            info->depth = bmhd[8];
+            masking = bmhd[9];
+            compression = bmhd[10];
+
+            if (info->width == 0 || info->height == 0 || info->depth == 0)
+                return IMAGE_BAD_HEADER;
+            if (info->depth > IMAGE_MAX_DEPTH)
+                return IMAGE_TOO_DEEP;
+            if (compression != COMPRESSION_NONE && compression != COMPRESSION_BYTERUN1)
+                return IMAGE_COMPRESSION;
+            haveHeader = TRUE;
+        }
+        else if (memcmp(chunk, "CMAP", 4) == 0)
+        {
+            // 8 bits a gun, of which the display takes the top 4
+            info->colorCount = 0;
+            while (used + 3 <= length && info->colorCount < 16)
+            {
+                UBYTE rgb[3];
+                if (!Take(&stream, rgb, 3))
+                    return IMAGE_TRUNCATED;
+                used += 3;
+
+                info->colors[info->colorCount++] = (UWORD)(((rgb[0] >> 4) << 8) | ((rgb[1] >> 4) << 4) | (rgb[2] >> 4));
+            }
+        }
+        else if (memcmp(chunk, "BODY", 4) == 0)
+        {
+            if (!haveHeader)
+                return IMAGE_BAD_HEADER;
+            if (planes == NULL)
+                return IMAGE_OK;
+
+            return ReadBody(&stream, info, masking, compression, planes, depth, bytesPerRow, height);
+        }
+
+        if (!Take(&stream, NULL, length - used))
+            return IMAGE_TRUNCATED;
+        if (length & 1)
+            NextByte(&stream);
+    }
+
+    return haveHeader ? IMAGE_NO_BODY : IMAGE_BAD_HEADER;
+}
+
+int ImageLoadFile(const char* path, struct ImageInfo* info, UBYTE** planes, int depth, int bytesPerRow, int height)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return IMAGE_NO_FILE;
+
+    int error = ImageLoad(file, info, planes, depth, bytesPerRow, height);
+    fclose(file);
+    return error;
+}
+
+const char* ImageErrorText(int error)
+{
+    return error >= 0 && error < IMAGE_ERROR_COUNT ? errorTexts[error] : "?";
+}
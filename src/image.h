@@ -0,0 +1,60 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Pattern images from files: IFF ILBM pictures, uncompressed or ByteRun1,
+// and raw planar dumps. Kept free of OS calls apart from stdio so the host
+// tools can build it too.
+
+#ifndef SPARKLER_IMAGE_H
+#define SPARKLER_IMAGE_H
+
+#include <stdio.h>
+#include <exec/types.h>
+
+// Planes an image can have; deeper ones would need colors Sparkler can't show
+#define IMAGE_MAX_DEPTH 4
+
+// Bytes taken from the file per read
+#define IMAGE_READ_BYTES 16384
+
+enum ImageError
+{
+    IMAGE_OK,
+    IMAGE_NO_FILE,          // could not be opened
+    IMAGE_TRUNCATED,        // ends inside a chunk or the body
+    IMAGE_NOT_ILBM,         // a FORM of another type
+    IMAGE_BAD_CHUNK,        // a chunk runs past the end of the FORM
+    IMAGE_BAD_HEADER,       // no BMHD before the BODY, or a zero size
+    IMAGE_TOO_DEEP,         // more planes than IMAGE_MAX_DEPTH
+    IMAGE_COMPRESSION,      // neither uncompressed nor ByteRun1
+    IMAGE_BAD_RUN,          // a ByteRun1 run crosses the end of a row
+    IMAGE_NO_BODY,          // the FORM ends before a BODY
+    IMAGE_BAD_SIZE,         // a raw file is not whole planes of the display
+    IMAGE_ERROR_COUNT
+};
+
+struct ImageInfo
+{
+    BOOL raw;           // a raw planar file, which has no header
+    UWORD width;        // ILBM only
+    UWORD height;
+    UWORD depth;
+    UWORD colorCount;   // CMAP entries kept, at most 16
+    UWORD colors[16];   // as COLORxx values
+    ULONG rawBytes;     // length of a raw file
+};
+
+// Load an image into depth planes of a bytesPerRow x height bitmap. An
+// ILBM goes in at the top left; the part of the bitmap it does not cover
+// and planes it does not have are cleared, rows and columns past the
+// bitmap are dropped. ByteRun1 rows are unpacked straight into the planes.
+// A file that does not start with FORM is raw: each plane in turn, rows of
+// bytesPerRow bytes, and its length must be 1 to depth whole planes.
+// With planes NULL only the header and CMAP are read.
+int ImageLoad(FILE* file, struct ImageInfo* info, UBYTE** planes, int depth, int bytesPerRow, int height);
+
+// ImageLoad on a file opened and closed here
+int ImageLoadFile(const char* path, struct ImageInfo* info, UBYTE** planes, int depth, int bytesPerRow, int height);
+
+// A few words for each ImageError, for messages
+const char* ImageErrorText(int error);
+
+#endif
@@ -0,0 +1,250 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Event driven keyboard input, see input.h
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/exec.h>
+#include <exec/interrupts.h>
+#include <devices/input.h>
+#include <devices/inputevent.h>
+
+#include "input.h"
+
+#define MATRIX_SIZE 16
+
+// Filled by the handler, drained by the main task. One producer and one
+// consumer, each owning one index, so no locking is needed.
+static UBYTE eventQueue[INPUT_QUEUE_SIZE];
+static volatile UBYTE queueHead = 0;
+static volatile UBYTE queueTail = 0;
+
+static struct Task* pMainTask = NULL;
+static BYTE inputSignal = -1;
+
+static struct MsgPort* pInputPort = NULL;
+static struct IOStdReq* pInputIO = NULL;
+static struct Interrupt inputInterrupt;
+static BOOL handlerAdded = FALSE;
+
+// Key state as seen by the main task
+static UBYTE keyMatrix[MATRIX_SIZE];
+
+static UBYTE repeatKeys[INPUT_REPEAT_KEYS];
+static ULONG nextRepeat[INPUT_REPEAT_KEYS];
+static int repeatKeyCount = 0;
+static UWORD repeatDelay = INPUT_REPEAT_DELAY;
+static UWORD repeatRate = INPUT_REPEAT_RATE;
+
+static BOOL Push(UBYTE code)
+{
+    UBYTE next = (queueHead + 1) & (INPUT_QUEUE_SIZE - 1);
+    if (next == queueTail)
+        return FALSE;
+
+    eventQueue[queueHead] = code;
+    queueHead = next;
+    return TRUE;
+}
+
+// Runs in the input.device task with A0 = event chain, A1 = is_Data
+static struct InputEvent* InputHandler(register struct InputEvent* events __asm("a0"), register APTR data __asm("a1"))
+{
+    BOOL queued = FALSE;
+
+    for (struct InputEvent* ev = events; ev != NULL; ev = ev->ie_NextEvent)
+    {
+        if (ev->ie_Class == IECLASS_RAWKEY)
+        {
+            // Sparkler does its own auto-repeat
+            if ((ev->ie_Qualifier & IEQUALIFIER_REPEAT) == 0)
+                queued |= Push((UBYTE)ev->ie_Code);
+
+            // Keep the keys away from whatever window is active behind us
+            ev->ie_Class = IECLASS_NULL;
+        }
+        else if (ev->ie_Class == IECLASS_RAWMOUSE && ev->ie_Code == IECODE_LBUTTON)
+        {
+            queued |= Push(KEY_MOUSE_LEFT);
+        }
+    }
+
+    if (queued)
+        Signal(pMainTask, 1L << inputSignal);
+
+    return events;
+}
+
+BOOL InputInit()
+{
+    pMainTask = FindTask(NULL);
+
+    inputSignal = AllocSignal(-1);
+    if (inputSignal == -1)
+        return FALSE;
+
+    pInputPort = CreateMsgPort();
+    if (pInputPort == NULL)
+        return FALSE;
+
+    pInputIO = (struct IOStdReq*)CreateIORequest(pInputPort, sizeof(struct IOStdReq));
+    if (pInputIO == NULL)
+        return FALSE;
+
+    if (OpenDevice("input.device", 0, (struct IORequest*)pInputIO, 0) != 0)
+    {
+        DeleteIORequest(pInputIO);
+        pInputIO = NULL;
+        return FALSE;
+    }
+
+    // Ahead of Intuition (priority 50) so it never sees our keys
+    inputInterrupt.is_Node.ln_Type = NT_INTERRUPT;
+    inputInterrupt.is_Node.ln_Pri = 100;
+    inputInterrupt.is_Node.ln_Name = "Sparkler Input";
+    inputInterrupt.is_Data = NULL;
+    inputInterrupt.is_Code = (void (*)())InputHandler;
+
+    pInputIO->io_Command = IND_ADDHANDLER;
+    pInputIO->io_Data = (APTR)&inputInterrupt;
+    DoIO((struct IORequest*)pInputIO);
+    handlerAdded = TRUE;
+
+    return TRUE;
+}
+
+void InputCleanup()
+{
+    if (handlerAdded)
+    {
+        pInputIO->io_Command = IND_REMHANDLER;
+        pInputIO->io_Data = (APTR)&inputInterrupt;
+        DoIO((struct IORequest*)pInputIO);
+        handlerAdded = FALSE;
+    }
+
+    if (pInputIO != NULL)
+    {
+        CloseDevice((struct IORequest*)pInputIO);
+        DeleteIORequest(pInputIO);
+        pInputIO = NULL;
+    }
+
+    if (pInputPort != NULL)
+    {
+        DeleteMsgPort(pInputPort);
+        pInputPort = NULL;
+    }
+
+    if (inputSignal != -1)
+    {
+        FreeSignal(inputSignal);
+        inputSignal = -1;
+    }
+}
+
+ULONG InputSignalMask()
+{
+    return inputSignal != -1 ? 1L << inputSignal : 0;
+}
+
+BOOL GetKeyState(int rawKey)
+{
+    // raw key is the bit number
+    int byteNumber = rawKey / 8;
+    int bitNumber = rawKey % 8;
+
+    if ((keyMatrix[byteNumber] & (1<<bitNumber))!=0)
+        return TRUE;
+
+    return FALSE;
+}
+
+static void SetKeyState(int rawKey, BOOL down)
+{
+    if (down)
+        keyMatrix[rawKey / 8] |= (1 << (rawKey % 8));
+    else
+        keyMatrix[rawKey / 8] &= ~(1 << (rawKey % 8));
+}
+
+void InputSetRepeat(int rawKey, BOOL repeat)
+{
+    for (int i = 0; i < repeatKeyCount; i++)
+    {
+        if (repeatKeys[i] == rawKey)
+        {
+            if (!repeat)
+            {
+                repeatKeys[i] = repeatKeys[repeatKeyCount - 1];
+                nextRepeat[i] = nextRepeat[repeatKeyCount - 1];
+                repeatKeyCount--;
+            }
+            return;
+        }
+    }
+
+    if (repeat && repeatKeyCount < INPUT_REPEAT_KEYS)
+    {
+        repeatKeys[repeatKeyCount++] = rawKey;
+    }
+}
+
+void InputSetRepeatTiming(UWORD delayFrames, UWORD rateFrames)
+{
+    repeatDelay = delayFrames;
+    repeatRate = rateFrames > 0 ? rateFrames : 1;
+}
+
+BOOL InputRepeatHeld()
+{
+    for (int i = 0; i < repeatKeyCount; i++)
+    {
+        if (GetKeyState(repeatKeys[i]))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+int InputNextKey(ULONG frame)
+{
+    while (queueTail != queueHead)
+    {
+        UBYTE code = eventQueue[queueTail];
+        queueTail = (queueTail + 1) & (INPUT_QUEUE_SIZE - 1);
+
+        if (code == KEY_MOUSE_LEFT)
+            return code;
+
+        int rawKey = code & ~IECODE_UP_PREFIX;
+        BOOL down = (code & IECODE_UP_PREFIX) == 0;
+
+        // Only edges count; a down for a key already held is ignored
+        if (down == GetKeyState(rawKey))
+            continue;
+
+        SetKeyState(rawKey, down);
+
+        if (!down)
+            continue;
+
+        for (int i = 0; i < repeatKeyCount; i++)
+        {
+            if (repeatKeys[i] == rawKey)
+                nextRepeat[i] = frame + repeatDelay;
+        }
+
+        return rawKey;
+    }
+
+    for (int i = 0; i < repeatKeyCount; i++)
+    {
+        if (GetKeyState(repeatKeys[i]) && (LONG)(frame - nextRepeat[i]) >= 0)
+        {
+            nextRepeat[i] = frame + repeatRate;
+            return repeatKeys[i];
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,46 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Event driven keyboard input. An input.device handler queues raw key
+// down/up events and signals the main task, which can then sleep in Wait()
+// instead of polling the key matrix.
+
+#ifndef SPARKLER_INPUT_H
+#define SPARKLER_INPUT_H
+
+#include <exec/types.h>
+
+// Left mouse button, queued as if it were a key
+#define KEY_MOUSE_LEFT 0x7F
+
+// Default auto-repeat for repeatable keys, in frames
+#define INPUT_REPEAT_DELAY 15
+#define INPUT_REPEAT_RATE 5
+
+// Most keys that can auto-repeat
+#define INPUT_REPEAT_KEYS 16
+
+#define INPUT_QUEUE_SIZE 64
+
+// Add the input handler; it swallows raw keys while Sparkler runs
+BOOL InputInit(void);
+void InputCleanup(void);
+
+// Signal set by the handler whenever new events are queued
+ULONG InputSignalMask(void);
+
+// TRUE while the key is held, as of the last event taken from the queue
+BOOL GetKeyState(int rawKey);
+
+// Keys that repeat while held, e.g. the color keys
+void InputSetRepeat(int rawKey, BOOL repeat);
+
+// Frames a repeatable key is held before it repeats, then between repeats
+void InputSetRepeatTiming(UWORD delayFrames, UWORD rateFrames);
+
+// TRUE while a repeatable key is held, so the caller wants frame ticks
+BOOL InputRepeatHeld(void);
+
+// Next key press, either a new key down edge from the queue or an
+// auto-repeat that is due at this frame. Returns -1 when there is none.
+int InputNextKey(ULONG frame);
+
+#endif
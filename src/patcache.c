@@ -0,0 +1,249 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Pattern bitmap cache. Bitmaps are built lazily on first use and kept
+// around; when the arena region runs out the least recently used ones are
+// given back.
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/exec.h>
+#include <graphics/gfxbase.h>
+
+#include "arena.h"
+#include "image.h"
+#include "pattern.h"
+#include "patcache.h"
+
+// All four display planes; the copper shows the HUD overlay instead of the
+// fourth one in the band at the top
+#define PATTERN_DEPTH 4
+
+struct PatternCacheStats g_patternCacheStats;
+
+static struct PatternCacheEntry cacheEntries[PATTERN_CACHE_SLOTS];
+static struct PatternCacheEntry* pActiveEntry = NULL;
+static struct PatternCacheEntry* pPreviousEntry = NULL;  // on screen until the next swap
+static ULONG useCounter = 0;
+static const char* pImagePath = NULL;
+
+// One row more than the display, for scrolling
+ULONG PatternCacheBitmapBytes(int width, int height)
+{
+    return (ULONG)(width / 8) * (height + 1) * PATTERN_DEPTH;
+}
+
+static void FreeEntry(struct PatternCacheEntry* pEntry)
+{
+    ArenaFree(pEntry->bitmap->Planes[0], PatternCacheBitmapBytes(pEntry->width, pEntry->height));
+    pEntry->bitmap = NULL;
+}
+
+// Free the least recently used entry, only taking one on screen if allowed
+static BOOL EvictOne(BOOL onScreen)
+{
+    struct PatternCacheEntry* pVictim = NULL;
+
+    for (int i = 0; i < PATTERN_CACHE_SLOTS; i++)
+    {
+        struct PatternCacheEntry* pEntry = &cacheEntries[i];
+        if (pEntry->bitmap == NULL || (!onScreen && (pEntry == pActiveEntry || pEntry == pPreviousEntry)))
+            continue;
+
+        if (pVictim == NULL || pEntry->lastUse < pVictim->lastUse)
+            pVictim = pEntry;
+    }
+
+    if (pVictim == NULL)
+        return FALSE;
+
+    if (pVictim == pActiveEntry)
+        pActiveEntry = NULL;
+    if (pVictim == pPreviousEntry)
+        pPreviousEntry = NULL;
+
+    FreeEntry(pVictim);
+    g_patternCacheStats.evictions++;
+    return TRUE;
+}
+
+static struct PatternCacheEntry* FindEntry(int width, int height, int lineMode, ULONG seed)
+{
+    for (int i = 0; i < PATTERN_CACHE_SLOTS; i++)
+    {
+        struct PatternCacheEntry* pEntry = &cacheEntries[i];
+        if (pEntry->bitmap != NULL && pEntry->width == width && pEntry->height == height && pEntry->lineMode == lineMode && pEntry->seed == seed)
+            return pEntry;
+    }
+
+    return NULL;
+}
+
+// Noise bitmap of this size with another seed that is not on screen
+static struct PatternCacheEntry* FindNoiseToReuse(int width, int height)
+{
+    for (int i = 0; i < PATTERN_CACHE_SLOTS; i++)
+    {
+        struct PatternCacheEntry* pEntry = &cacheEntries[i];
+        if (pEntry->bitmap != NULL && pEntry->width == width && pEntry->height == height && pEntry->lineMode == PATTERN_NOISE
+            && pEntry != pActiveEntry && pEntry != pPreviousEntry)
+            return pEntry;
+    }
+
+    return NULL;
+}
+
+static struct PatternCacheEntry* FindFreeSlot()
+{
+    for (int i = 0; i < PATTERN_CACHE_SLOTS; i++)
+    {
+        if (cacheEntries[i].bitmap == NULL)
+            return &cacheEntries[i];
+    }
+
+    return NULL;
+}
+
+// Build a new entry, evicting old ones until the bitmap fits if allowed
+static struct PatternCacheEntry* BuildEntry(int width, int height, int lineMode, ULONG seed, BOOL evict)
+{
+    ULONG bytes = PatternCacheBitmapBytes(width, height);
+    BOOL shownEvicted = FALSE;
+
+    if (evict)
+    {
+        while (FindFreeSlot() == NULL || ArenaLargestFree() < bytes)
+        {
+            if (!EvictOne(FALSE))
+                break;
+        }
+
+        // A region with room for one of the largest bitmaps only; the new
+        // one is drawn over the one on screen
+        struct PatternCacheEntry* pShown = pActiveEntry;
+        struct PatternCacheEntry* pShownBefore = pPreviousEntry;
+        while (ArenaLargestFree() < bytes)
+        {
+            if (!EvictOne(TRUE))
+                break;
+        }
+        shownEvicted = (pShown != NULL && pActiveEntry == NULL) || (pShownBefore != NULL && pPreviousEntry == NULL);
+    }
+
+    struct PatternCacheEntry* pEntry = FindFreeSlot();
+    if (pEntry == NULL)
+        return NULL;
+
+    UBYTE* pPlanes = (UBYTE*)ArenaAlloc(bytes);
+    if (pPlanes == NULL)
+        return NULL;
+
+    // The planes follow each other in the one part
+    ULONG planeBytes = bytes / PATTERN_DEPTH;
+    InitBitMap(&pEntry->bitmapData, PATTERN_DEPTH, width, height + 1);
+    for (int i = 0; i < PATTERN_DEPTH; i++)
+    {
+        pEntry->bitmapData.Planes[i] = pPlanes + (i * planeBytes);
+    }
+    pEntry->bitmap = &pEntry->bitmapData;
+    pEntry->width = width;
+    pEntry->height = height;
+
+    // An image is read from its file again for every size it is shown at
+    struct ImageInfo info;
+    BOOL filled = lineMode == PATTERN_IMAGE
+                    ? pImagePath != NULL && ImageLoadFile(pImagePath, &info, pEntry->bitmap->Planes, PATTERN_DEPTH, width/8, height) == IMAGE_OK
+                    : FillPatternPlanes(pEntry->bitmap->Planes, PATTERN_DEPTH, width/8, height, lineMode, seed);
+
+    // The bitmap on screen is gone, so rather than leave the display on
+    // freed memory show the first pattern in the new one
+    if (!filled && shownEvicted)
+    {
+        lineMode = 1;
+        seed = 0;
+        filled = FillPatternPlanes(pEntry->bitmap->Planes, PATTERN_DEPTH, width/8, height, lineMode, seed);
+    }
+    if (!filled)
+    {
+        FreeEntry(pEntry);
+        return NULL;
+    }
+    FillPatternWrapRow(pEntry->bitmap->Planes, PATTERN_DEPTH, width/8, height);
+
+    pEntry->lineMode = lineMode;
+    pEntry->seed = seed;
+    pEntry->lastUse = useCounter;
+    return pEntry;
+}
+
+struct PatternCacheEntry* PatternCacheGet(int width, int height, int lineMode, ULONG seed)
+{
+    if (lineMode != PATTERN_NOISE)
+    {
+        seed = 0;
+    }
+
+    struct PatternCacheEntry* pEntry = FindEntry(width, height, lineMode, seed);
+
+    if (pEntry != NULL)
+    {
+        g_patternCacheStats.hits++;
+    }
+    else
+    {
+        g_patternCacheStats.misses++;
+
+        // Each new seed would otherwise leave a bitmap behind
+        pEntry = lineMode == PATTERN_NOISE ? FindNoiseToReuse(width, height) : NULL;
+        if (pEntry != NULL)
+        {
+            FillPatternPlanes(pEntry->bitmap->Planes, PATTERN_DEPTH, width/8, height, lineMode, seed);
+            FillPatternWrapRow(pEntry->bitmap->Planes, PATTERN_DEPTH, width/8, height);
+            pEntry->seed = seed;
+        }
+        else
+        {
+            pEntry = BuildEntry(width, height, lineMode, seed, TRUE);
+            if (pEntry == NULL)
+                return NULL;
+        }
+    }
+
+    pEntry->lastUse = ++useCounter;
+    if (pEntry != pActiveEntry)
+    {
+        pPreviousEntry = pActiveEntry;
+        pActiveEntry = pEntry;
+    }
+    return pEntry;
+}
+
+void PatternCachePrefill(int width, int height)
+{
+    for (int lineMode = 1; lineMode <= PATTERN_MODE_COUNT; lineMode++)
+    {
+        if (FindEntry(width, height, lineMode, 0) != NULL)
+            continue;
+
+        if (ArenaLargestFree() < PatternCacheBitmapBytes(width, height))
+            break;
+
+        if (BuildEntry(width, height, lineMode, 0, FALSE) == NULL)
+            break;
+    }
+}
+
+void PatternCacheSetImage(const char* path)
+{
+    pImagePath = path;
+}
+
+void PatternCacheFlush()
+{
+    for (int i = 0; i < PATTERN_CACHE_SLOTS; i++)
+    {
+        if (cacheEntries[i].bitmap != NULL)
+            FreeEntry(&cacheEntries[i]);
+    }
+
+    pActiveEntry = NULL;
+    pPreviousEntry = NULL;
+}
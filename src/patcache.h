@@ -0,0 +1,61 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Cache of built pattern bitmaps so switching patterns or resolutions does
+// not build them again every time. Bitmaps live in the chip RAM arena's
+// region, so a mode change never allocates from the system.
+
+#ifndef SPARKLER_PATCACHE_H
+#define SPARKLER_PATCACHE_H
+
+#include <exec/types.h>
+#include <graphics/gfx.h>
+
+#define PATTERN_CACHE_SLOTS 8
+
+// The largest bitmap, which the arena region is sized from
+#define PATTERN_CACHE_MAX_WIDTH 640
+#define PATTERN_CACHE_MAX_HEIGHT 512
+
+struct PatternCacheEntry
+{
+    struct BitMap* bitmap;          // &bitmapData, NULL for a free slot
+    struct BitMap bitmapData;       // planes in one part of the arena region
+    UWORD width;
+    UWORD height;
+    UWORD lineMode;
+    ULONG seed;         // noise seed, 0 for the other modes
+    ULONG lastUse;
+};
+
+struct PatternCacheStats
+{
+    ULONG hits;
+    ULONG misses;
+    ULONG evictions;
+};
+
+extern struct PatternCacheStats g_patternCacheStats;
+
+// Arena bytes a bitmap of this size takes
+ULONG PatternCacheBitmapBytes(int width, int height);
+
+// Return the bitmap for the pattern, building it if needed. The returned
+// entry becomes the active one; it and the one it replaced (still on screen
+// until the copper lists swap) are only evicted when the region has no room
+// for the new bitmap otherwise, and it is then drawn over them. Returns
+// NULL if the region is too small. If the bitmap on screen had to go and
+// the new one then can't be filled, e.g. an image that can't be read, the
+// entry returned has line mode 1 instead. seed only matters for noise; a new one refills an off-screen
+// noise bitmap of the same size in place instead of allocating another.
+struct PatternCacheEntry* PatternCacheGet(int width, int height, int lineMode, ULONG seed);
+
+// File PATTERN_IMAGE is loaded from, for each size it is shown at; NULL
+// for none. Set once, before the image is first asked for.
+void PatternCacheSetImage(const char* path);
+
+// Build the other line modes for this resolution while the region has room
+void PatternCachePrefill(int width, int height);
+
+// Give every cached bitmap back to the region
+void PatternCacheFlush(void);
+
+#endif
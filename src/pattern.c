@@ -0,0 +1,405 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Row-major pattern generator. Each distinct scanline is built once with
+// longword stores, every other line is a longword copy of the line one
+// pattern period above it. De Bruijn patterns are written pixel by pixel
+// from a generated sequence, noise a longword at a time from xorshift32.
+
+#include <stdio.h>
+
+#include "pattern.h"
+
+// Column bytes repeat every colPeriod bytes, rows repeat every rowPeriod lines
+struct PatternDef
+{
+    UBYTE rowPeriod;
+    UBYTE colPeriod;
+    UBYTE bytes[2][5];
+};
+
+static const struct PatternDef patternDefs[PATTERN_MODE_COUNT + 1] =
+{
+    { 1, 1, { { 0x00 } } },                                 // unknown modes stay clear
+    { 2, 1, { { 0x55 }, { 0xAA } } },                       // 1: alternating pixels
+    { 1, 1, { { 0xAA } } },                                 // 2: vertical bars
+    { 2, 1, { { 0xFF }, { 0x00 } } },                       // 3: horizontal bars
+    { 1, 1, { { 0xFF } } },                                 // 4: solid fill
+    { 1, 3, { { 0x92, 0x49, 0x24 } } },                     // 5: vertical bars 2
+    { 1, 1, { { 0x88 } } },                                 // 6: vertical bars 3
+    { 1, 5, { { 0x84, 0x21, 0x08, 0x42, 0x10 } } },         // 7: vertical bars 4
+};
+
+// Multi-plane modes: the hand-written mode of each plane and how many
+// pixels it is shifted right
+struct PlaneSetDef
+{
+    UBYTE modes[PATTERN_MAX_DEPTH];
+    UBYTE shifts[PATTERN_MAX_DEPTH];
+};
+
+static const struct PlaneSetDef planeSetDefs[PATTERN_MULTI_COUNT + 1] =
+{
+    { { 0 }, { 0 } },
+    { { 1, 1, 1, 1 }, { 0, 0, 0, 0 } },     // 1: alternating pixels, every plane in phase
+    { { 1, 1, 1, 1 }, { 0, 1, 0, 1 } },     // 2: alternating pixels, odd planes inverted
+    { { 2, 5, 7, 3 }, { 0, 0, 0, 0 } },     // 3: bars of 2, 3 and 5 pixels over line pairs, all 16 colors
+    { { 6, 6, 6, 6 }, { 0, 1, 2, 3 } },     // 4: one pixel in four walking through the planes
+};
+
+// Write one row from a repeating byte sequence. colPeriod is 1, 3 or 5, so
+// 4 * colPeriod bytes is always a whole number of longwords.
+static void BuildRow(UBYTE* row, int bytesPerRow, const UBYTE* bytes, int colPeriod)
+{
+    union
+    {
+        UBYTE b[4 * 5];
+        ULONG l[5];
+    } cycle;
+
+    int cycleBytes = 4 * colPeriod;
+    for (int i = 0; i < cycleBytes; i++)
+    {
+        cycle.b[i] = bytes[i % colPeriod];
+    }
+
+    ULONG* dst = (ULONG*)row;
+    int longs = bytesPerRow >> 2;
+    int k = 0;
+    for (int i = 0; i < longs; i++)
+    {
+        *dst++ = cycle.l[k];
+        if (++k == colPeriod)
+        {
+            k = 0;
+        }
+    }
+
+    // Odd widths; 320 and 640 never get here
+    for (int i = longs << 2; i < bytesPerRow; i++)
+    {
+        row[i] = cycle.b[i % cycleBytes];
+    }
+}
+
+int PatternOrder(int lineMode)
+{
+    if (lineMode < PATTERN_DEBRUIJN(PATTERN_DEBRUIJN_MIN_ORDER) || lineMode > PATTERN_DEBRUIJN(PATTERN_DEBRUIJN_MAX_ORDER))
+        return 0;
+
+    return lineMode - PATTERN_DEBRUIJN(PATTERN_DEBRUIJN_MIN_ORDER) + PATTERN_DEBRUIJN_MIN_ORDER;
+}
+
+// Noise longwords are stored as the Amiga stores them, so a seed gives the
+// same bitmap on a little-endian host
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define BIG_ENDIAN_LONG(x) __builtin_bswap32(x)
+#else
+#define BIG_ENDIAN_LONG(x) (x)
+#endif
+
+static UBYTE sequence[PATTERN_DEBRUIJN_MAX_LENGTH];
+
+// Concatenate the Lyndon words whose length divides order, in
+// lexicographic order (Fredricksen, Kessler and Maiorana). Gives the cyclic
+// sequence of length symbols^order that holds every run of order symbols.
+static LONG GenerateDeBruijn(int symbols, int order)
+{
+    UBYTE a[PATTERN_DEBRUIJN_MAX_ORDER + 1];
+    LONG length = 0;
+    int period = 1;
+
+    for (int i = 0; i <= order; i++)
+    {
+        a[i] = 0;
+    }
+
+    for (;;)
+    {
+        if (order % period == 0)
+        {
+            for (int i = 1; i <= period; i++)
+            {
+                sequence[length++] = a[i];
+            }
+        }
+
+        // Next prenecklace: bump the last symbol that can go up and repeat
+        // the prefix before it
+        int i = order;
+        while (i > 0 && a[i] == symbols - 1)
+        {
+            i--;
+        }
+
+        if (i == 0)
+            break;
+
+        a[i]++;
+        for (int j = i + 1; j <= order; j++)
+        {
+            a[j] = a[j - i];
+        }
+        period = i;
+    }
+
+    return length;
+}
+
+static BOOL FillDeBruijn(UBYTE** planes, int depth, int bytesPerRow, int height, int order)
+{
+    int symbols = 1 << depth;
+    LONG length = 1;
+    for (int i = 0; i < order; i++)
+    {
+        length *= symbols;
+    }
+
+    int width = bytesPerRow * 8;
+    if (length > PATTERN_DEBRUIJN_MAX_LENGTH || width <= order)
+        return FALSE;
+
+    GenerateDeBruijn(symbols, order);
+
+    LONG start = 0;
+    for (int y = 0; y < height - 1; y++)
+    {
+        LONG pos = start;
+
+        for (int x = 0; x < bytesPerRow; x++)
+        {
+            UBYTE bytes[PATTERN_MAX_DEPTH] = { 0 };
+
+            for (int bit = 7; bit >= 0; bit--)
+            {
+                UBYTE color = sequence[pos];
+                if (++pos == length)
+                    pos = 0;
+
+                for (int p = 0; p < depth; p++)
+                {
+                    bytes[p] |= ((color >> p) & 1) << bit;
+                }
+            }
+
+            for (int p = 0; p < depth; p++)
+            {
+                planes[p][(LONG)y * bytesPerRow + x] = bytes[p];
+            }
+        }
+
+        // The next row repeats the last order-1 pixels of this one
+        start += width - (order - 1);
+        if (start >= length)
+            start = (start - length + 1) % length;
+    }
+
+    return TRUE;
+}
+
+// Solid last line marks the bottom of the display, as for one plane
+static void SolidLastRow(UBYTE** planes, int depth, int bytesPerRow, int height)
+{
+    for (int p = 0; p < depth; p++)
+    {
+        UBYTE* row = planes[p] + (LONG)(height - 1) * bytesPerRow;
+        for (int x = 0; x < bytesPerRow; x++)
+        {
+            row[x] = p == 0 ? 0xFF : 0x00;
+        }
+    }
+}
+
+static void CopyRow(UBYTE* row, const UBYTE* source, int bytesPerRow)
+{
+    if ((bytesPerRow & 3) == 0)
+    {
+        ULONG* dst = (ULONG*)row;
+        const ULONG* src = (const ULONG*)source;
+        for (int i = bytesPerRow >> 2; i > 0; i--)
+        {
+            *dst++ = *src++;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < bytesPerRow; i++)
+        {
+            row[i] = source[i];
+        }
+    }
+}
+
+// The templates of each plane's mode are shifted once; then each row is
+// built or copied from one period above, in every plane before moving on
+static void FillPlaneSet(UBYTE** planes, int depth, int bytesPerRow, int height, const UBYTE* modes, const UBYTE* shifts)
+{
+    const struct PatternDef* defs[PATTERN_MAX_DEPTH];
+    UBYTE templates[PATTERN_MAX_DEPTH][2][5];
+
+    for (int p = 0; p < depth; p++)
+    {
+        const struct PatternDef* def = &patternDefs[modes[p] <= PATTERN_MODE_COUNT ? modes[p] : 0];
+        int period = def->colPeriod;
+        int shift = shifts[p] & 7;
+        defs[p] = def;
+
+        // Every row repeats after colPeriod bytes, so the bits shifted out
+        // of the last byte come back in at the first
+        for (int y = 0; y < def->rowPeriod; y++)
+        {
+            for (int i = 0; i < period; i++)
+            {
+                UBYTE previous = def->bytes[y][(i + period - 1) % period];
+                templates[p][y][i] = shift == 0 ? def->bytes[y][i] : (UBYTE)((def->bytes[y][i] >> shift) | (previous << (8 - shift)));
+            }
+        }
+    }
+
+    for (int y = 0; y < height - 1; y++)
+    {
+        for (int p = 0; p < depth; p++)
+        {
+            const struct PatternDef* def = defs[p];
+            UBYTE* row = planes[p] + (LONG)y * bytesPerRow;
+
+            if (y < def->rowPeriod)
+                BuildRow(row, bytesPerRow, templates[p][y], def->colPeriod);
+            else
+                CopyRow(row, row - (LONG)def->rowPeriod * bytesPerRow, bytesPerRow);
+        }
+    }
+
+    SolidLastRow(planes, depth, bytesPerRow, height);
+}
+
+void FillPatternWrapRow(UBYTE** planes, int depth, int bytesPerRow, int height)
+{
+    for (int plane = 0; plane < depth; plane++)
+    {
+        CopyRow(planes[plane] + ((LONG)height * bytesPerRow), planes[plane], bytesPerRow);
+    }
+}
+
+// Marsaglia's xorshift32, one step per longword. The whole of each plane
+// is noise, then the last row is made solid like every other pattern.
+static void FillNoise(UBYTE** planes, int depth, int bytesPerRow, int height, ULONG seed)
+{
+    register ULONG x = seed != 0 ? seed : 1;
+    LONG bytes = (LONG)bytesPerRow * height;
+
+    for (int p = 0; p < depth; p++)
+    {
+        register ULONG* dst = (ULONG*)planes[p];
+        for (LONG i = bytes >> 2; i > 0; i--)
+        {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            *dst++ = BIG_ENDIAN_LONG(x);
+        }
+
+        // Odd sizes; 320 and 640 wide never get here
+        for (LONG i = bytes & ~3L; i < bytes; i++)
+        {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            planes[p][i] = (UBYTE)(x >> 24);
+        }
+    }
+
+    SolidLastRow(planes, depth, bytesPerRow, height);
+}
+
+ULONG PatternNextSeed(ULONG seed)
+{
+    ULONG x = seed != 0 ? seed : 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+BOOL FillPatternPlanes(UBYTE** planes, int depth, int bytesPerRow, int height, int lineMode, ULONG seed)
+{
+    if (depth > PATTERN_MAX_DEPTH || height < 1 || lineMode == PATTERN_IMAGE)
+        return FALSE;
+
+    if (lineMode == PATTERN_NOISE)
+    {
+        FillNoise(planes, depth, bytesPerRow, height, seed);
+        return TRUE;
+    }
+
+    int order = PatternOrder(lineMode);
+    if (order != 0)
+    {
+        if (!FillDeBruijn(planes, depth, bytesPerRow, height, order))
+            return FALSE;
+
+        SolidLastRow(planes, depth, bytesPerRow, height);
+        return TRUE;
+    }
+
+    int multi = PatternMulti(lineMode);
+    const struct PlaneSetDef* set = &planeSetDefs[multi];
+    UBYTE modes[PATTERN_MAX_DEPTH] = { 0 };
+    if (multi != 0)
+    {
+        for (int p = 0; p < depth; p++)
+        {
+            modes[p] = set->modes[p];
+        }
+    }
+    else
+    {
+        modes[0] = (UBYTE)lineMode;
+    }
+
+    FillPlaneSet(planes, depth, bytesPerRow, height, modes, set->shifts);
+    return TRUE;
+}
+
+int PatternCoverage(int lineMode, int depth, int width, int height)
+{
+    int order = PatternOrder(lineMode);
+    if (order == 0)
+        return 100;
+
+    LONG length = 1;
+    for (int i = 0; i < order; i++)
+    {
+        length *= 1 << depth;
+    }
+
+    // Rows above the solid last one each start width-(k-1) new runs
+    LONG shown = (LONG)(height - 1) * (width - (order - 1));
+    if (shown >= length)
+        return 100;
+
+    return (int)((shown * 100) / length);
+}
+
+int PatternMulti(int lineMode)
+{
+    if (lineMode < PATTERN_MULTI(1) || lineMode > PATTERN_FIXED_MODES)
+        return 0;
+
+    return lineMode - PATTERN_MULTI(1) + 1;
+}
+
+void PatternLabel(char* text, int lineMode, ULONG seed)
+{
+    int order = PatternOrder(lineMode);
+    int multi = PatternMulti(lineMode);
+
+    if (lineMode == PATTERN_NOISE)
+        sprintf(text, "N:%08lx", (unsigned long)seed);
+    else if (lineMode == PATTERN_IMAGE)
+        sprintf(text, "Image");
+    else if (order != 0)
+        sprintf(text, "P:8 k:%d", order);
+    else if (multi != 0)
+        sprintf(text, "P:0 m:%d", multi);
+    else
+        sprintf(text, "P:%d", lineMode);
+}
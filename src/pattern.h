@@ -0,0 +1,76 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Test pattern generation. Kept free of OS calls so the host tools
+// can build it too.
+
+#ifndef SPARKLER_PATTERN_H
+#define SPARKLER_PATTERN_H
+
+#include <exec/types.h>
+
+#define PATTERN_MODE_COUNT 7
+
+// Planes FillPatternPlanes can write
+#define PATTERN_MAX_DEPTH 4
+
+// Line modes after the hand-written ones are De Bruijn patterns of an order
+// k: every run of k pixel colors appears somewhere on screen
+#define PATTERN_DEBRUIJN_MIN_ORDER 2
+#define PATTERN_DEBRUIJN_MAX_ORDER 4
+#define PATTERN_DEBRUIJN(order) (PATTERN_MODE_COUNT + 1 + (order) - PATTERN_DEBRUIJN_MIN_ORDER)
+
+// Longest sequence, in pixels; limits the order for deeper bitmaps
+#define PATTERN_DEBRUIJN_MAX_LENGTH 65536L
+
+// Then the multi-plane modes, numbered from 1: a hand-written pattern in
+// every plane, each with its own mode and pixel shift
+#define PATTERN_MULTI_COUNT 4
+#define PATTERN_MULTI(n) (PATTERN_DEBRUIJN(PATTERN_DEBRUIJN_MAX_ORDER) + (n))
+
+// Modes whose bitmap follows from the line mode alone
+#define PATTERN_FIXED_MODES PATTERN_MULTI(PATTERN_MULTI_COUNT)
+
+// Last comes noise: xorshift32 output from a seed, so the seed shown in the
+// HUD is all it takes to build the same bitmap again
+#define PATTERN_NOISE (PATTERN_FIXED_MODES + 1)
+
+#define PATTERN_ALL_MODES PATTERN_NOISE
+
+// An image loaded from a file (image.c) rather than generated, so
+// FillPatternPlanes does not build it
+#define PATTERN_IMAGE (PATTERN_ALL_MODES + 1)
+
+// Fill depth planes for any line mode, every plane of a row before the
+// next row; seed is only used by PATTERN_NOISE. Planes must be longword
+// aligned; rows are bytesPerRow apart. The last row is always solid in
+// plane 0 and clear in the rest. Hand-written modes (1-7) go in plane 0
+// and clear the rest. Noise fills each plane in turn.
+// De Bruijn modes use all 2^depth colors; rows overlap by k-1 pixels so
+// every run of k colors lies within one row, and each pass over the
+// sequence starts one pixel further on so vertical neighbours differ
+// between passes. FALSE if depth is too deep for the mode.
+BOOL FillPatternPlanes(UBYTE** planes, int depth, int bytesPerRow, int height, int lineMode, ULONG seed);
+
+// Copy row 0 of each plane to row height, the extra row a bitmap needs so
+// a display scrolled sideways reads row 0 where its last row runs out
+void FillPatternWrapRow(UBYTE** planes, int depth, int bytesPerRow, int height);
+
+// De Bruijn order of a line mode, 0 for the others
+int PatternOrder(int lineMode);
+
+// Percent of the runs of k colors a De Bruijn mode shows in a bitmap of
+// this size, rounded down so a partial one never reads 100. 100 for the
+// other modes.
+int PatternCoverage(int lineMode, int depth, int width, int height);
+
+// Multi-plane mode number of a line mode, 0 for the others
+int PatternMulti(int lineMode);
+
+// Short name for the HUD, at most 10 characters: "P:3", "P:8 k:3" for
+// De Bruijn, "P:0 m:2" for multi-plane, "N:0001a2b3" for noise,
+// "Image" for an image
+void PatternLabel(char* text, int lineMode, ULONG seed);
+
+// A new noise seed following seed; never 0
+ULONG PatternNextSeed(ULONG seed);
+
+#endif
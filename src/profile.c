@@ -0,0 +1,142 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Raster line profiler, see profile.h
+
+#include <stdio.h>
+#include <exec/types.h>
+#include <exec/exec.h>
+#include <hardware/custom.h>
+#include <hardware/intbits.h>
+
+#include "vblank.h"
+#include "profile.h"
+
+extern struct Custom custom;
+
+struct BeamStamp
+{
+    ULONG frame;
+    UWORD line;
+};
+
+struct PhaseProfile
+{
+    struct BeamStamp start;
+    ULONG samples;
+    ULONG ring[PROFILE_SAMPLES];
+};
+
+static const char* phaseNames[PROFILE_PHASE_COUNT] = { "Pattern", "Setup", "HUD", "Sleep" };
+
+static struct PhaseProfile phases[PROFILE_PHASE_COUNT];
+static UWORD frameLines = 263;
+
+// Frame count and beam line together. VPOSR is read again in case line 255
+// carried between the reads, and a vertical blank that has started but not
+// yet been served counts as the next frame.
+static void ReadBeam(struct BeamStamp* pStamp)
+{
+    UWORD vpos;
+    UWORD vhpos;
+    UWORD pending;
+
+    Disable();
+    do
+    {
+        vpos = custom.vposr;
+        vhpos = custom.vhposr;
+    }
+    while ((custom.vposr & 1) != (vpos & 1));
+    pending = custom.intreqr & INTF_VERTB;
+    pStamp->frame = g_vblankTicks.frames;
+    Enable();
+
+    pStamp->line = ((vpos & 1) << 8) | (vhpos >> 8);
+    if (pending && pStamp->line < frameLines / 2)
+    {
+        pStamp->frame++;
+    }
+}
+
+const char* ProfilePhaseName(int phase)
+{
+    return phase >= 0 && phase < PROFILE_PHASE_COUNT ? phaseNames[phase] : "?";
+}
+
+void ProfileSetFrameLines(UWORD lines)
+{
+    frameLines = lines;
+}
+
+void ProfileBegin(int phase)
+{
+    ReadBeam(&phases[phase].start);
+}
+
+void ProfileEnd(int phase)
+{
+    struct PhaseProfile* pPhase = &phases[phase];
+    struct BeamStamp end;
+    ReadBeam(&end);
+
+    LONG lines = (LONG)((end.frame - pPhase->start.frame) * frameLines) + end.line - pPhase->start.line;
+    pPhase->ring[pPhase->samples % PROFILE_SAMPLES] = lines > 0 ? (ULONG)lines : 0;
+    pPhase->samples++;
+}
+
+void ProfileSummarize(int phase, struct ProfileSummary* pSummary)
+{
+    const struct PhaseProfile* pPhase = &phases[phase];
+    ULONG count = pPhase->samples < PROFILE_SAMPLES ? pPhase->samples : PROFILE_SAMPLES;
+
+    pSummary->samples = pPhase->samples;
+    pSummary->min = 0;
+    pSummary->avg = 0;
+    pSummary->max = 0;
+    if (count == 0)
+    {
+        return;
+    }
+
+    ULONG total = 0;
+    pSummary->min = pPhase->ring[0];
+    for (ULONG i = 0; i < count; i++)
+    {
+        ULONG lines = pPhase->ring[i];
+        total += lines;
+        if (lines < pSummary->min)
+            pSummary->min = lines;
+        if (lines > pSummary->max)
+            pSummary->max = lines;
+    }
+    pSummary->avg = total / count;
+}
+
+BOOL ProfileWriteLog(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        return FALSE;
+
+    fprintf(file, "Sparkler profile in raster lines, %u per frame\n", (unsigned int)frameLines);
+
+    for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++)
+    {
+        const struct PhaseProfile* pPhase = &phases[phase];
+        struct ProfileSummary summary;
+        ProfileSummarize(phase, &summary);
+
+        fprintf(file, "%s samples %lu min %lu avg %lu max %lu\n", phaseNames[phase], summary.samples, summary.min, summary.avg, summary.max);
+
+        // Oldest first; the ring only wrapped if more samples were taken
+        ULONG count = pPhase->samples < PROFILE_SAMPLES ? pPhase->samples : PROFILE_SAMPLES;
+        ULONG first = pPhase->samples - count;
+        fprintf(file, "%s last", phaseNames[phase]);
+        for (ULONG i = first; i < pPhase->samples; i++)
+        {
+            fprintf(file, " %lu", pPhase->ring[i % PROFILE_SAMPLES]);
+        }
+        fprintf(file, "\n");
+    }
+
+    return fclose(file) == 0;
+}
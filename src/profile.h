@@ -0,0 +1,48 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Raster line profiler. Each phase of a display change is timed from the
+// beam position before and after it, counting whole frames with the
+// vertical blank server's frame counter. The last PROFILE_SAMPLES times of
+// each phase are kept in a ring for the HUD and the log written on exit.
+
+#ifndef SPARKLER_PROFILE_H
+#define SPARKLER_PROFILE_H
+
+#include <exec/types.h>
+
+#define PROFILE_SAMPLES 32
+
+#define PROFILE_LOG_FILE "PROGDIR:Sparkler.profile"
+
+enum ProfilePhase
+{
+    PROFILE_PATTERN,    // getting the bitmap from the pattern cache
+    PROFILE_SETUP,      // building and committing new copper lists
+    PROFILE_HUD,        // updating the overlay
+    PROFILE_SLEEP,      // waiting for a key or the next frame
+    PROFILE_PHASE_COUNT
+};
+
+// Over the samples in the ring, in lines
+struct ProfileSummary
+{
+    ULONG samples;      // taken since startup
+    ULONG min;
+    ULONG avg;
+    ULONG max;
+};
+
+const char* ProfilePhaseName(int phase);
+
+// Lines in a frame of the display on screen, 313 for PAL and 263 for NTSC.
+// The short frames of interlace are counted one line long.
+void ProfileSetFrameLines(UWORD lines);
+
+void ProfileBegin(int phase);
+void ProfileEnd(int phase);
+
+void ProfileSummarize(int phase, struct ProfileSummary* pSummary);
+
+// Every phase's summary and ring, oldest sample first
+BOOL ProfileWriteLog(const char* path);
+
+#endif
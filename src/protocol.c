@@ -0,0 +1,328 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Remote control protocol, see protocol.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pattern.h"
+#include "sweep.h"
+#include "protocol.h"
+
+#define MAX_WORDS 4
+
+struct VerbDef
+{
+    const char* name;
+    int argCount;
+};
+
+static const struct VerbDef verbs[PROTOCOL_VERB_COUNT] =
+{
+    { "PING", 0 },
+    { "STATE", 0 },
+    { "TIMING", 0 },
+    { "MODE", 2 },
+    { "PATTERN", 1 },
+    { "COLORS", 2 },
+    { "COLOR", 2 },
+    { "SWEEP", 3 },
+    { "STOP", 0 },
+    { "KEY", 1 },
+    { "WAIT", 1 },
+};
+
+void ProtocolLineInit(struct ProtocolLine* line)
+{
+    line->length = 0;
+    line->overflow = FALSE;
+    line->complete = FALSE;
+    line->text[0] = '\0';
+}
+
+BOOL ProtocolFeed(struct ProtocolLine* line, char c)
+{
+    // A whole line is only cleared once the next byte comes in
+    if (line->complete)
+    {
+        ProtocolLineInit(line);
+    }
+
+    if (c == '\n')
+    {
+        line->text[line->length] = '\0';
+        line->complete = TRUE;
+        return TRUE;
+    }
+
+    if (c == '\r')
+        return FALSE;
+
+    if (line->length + 1 < PROTOCOL_LINE_MAX)
+        line->text[line->length++] = c;
+    else
+        line->overflow = TRUE;
+
+    return FALSE;
+}
+
+// Split at spaces and tabs, in place
+static int SplitWords(char* text, char** words)
+{
+    int count = 0;
+    char* p = text;
+
+    for (;;)
+    {
+        while (*p == ' ' || *p == '\t')
+            p++;
+
+        if (*p == '\0')
+            return count;
+
+        if (count == MAX_WORDS + 1)
+            return -1;
+
+        words[count++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t')
+            p++;
+
+        if (*p != '\0')
+            *p++ = '\0';
+    }
+}
+
+// Whole word as a number no bigger than max
+static BOOL ParseNumber(const char* text, int base, ULONG max, ULONG* value)
+{
+    char* end;
+    *value = strtoul(text, &end, base);
+    return end != text && *end == '\0' && *value <= max;
+}
+
+static BOOL SameWord(const char* a, const char* b)
+{
+    for (; *a != '\0' && *b != '\0'; a++, b++)
+    {
+        char ca = (*a >= 'a' && *a <= 'z') ? *a - 'a' + 'A' : *a;
+        if (ca != *b)
+            return FALSE;
+    }
+    return *a == *b;
+}
+
+BOOL ProtocolParsePattern(const char* text, int* lineMode, ULONG* seed)
+{
+    ULONG value;
+    *seed = 0;
+
+    if ((text[0] == 'N' || text[0] == 'n') && text[1] == ':')
+    {
+        // The generator never starts from 0, as PatternNextSeed() promises
+        if (!ParseNumber(text + 2, 16, 0xFFFFFFFFUL, &value) || value == 0)
+            return FALSE;
+
+        *lineMode = PATTERN_NOISE;
+        *seed = value;
+        return TRUE;
+    }
+
+    if ((text[0] == 'I' || text[0] == 'i') && text[1] == '\0')
+    {
+        *lineMode = PATTERN_IMAGE;
+        return TRUE;
+    }
+
+    if (!ParseNumber(text, 10, PATTERN_FIXED_MODES, &value) || value == 0)
+        return FALSE;
+
+    *lineMode = (int)value;
+    return TRUE;
+}
+
+void ProtocolFormatPattern(char* text, int lineMode, ULONG seed)
+{
+    if (lineMode == PATTERN_NOISE)
+        sprintf(text, "N:%08lx", (unsigned long)seed);
+    else if (lineMode == PATTERN_IMAGE)
+        sprintf(text, "I");
+    else
+        sprintf(text, "%d", lineMode);
+}
+
+static BOOL ParseColor(const char* text, UWORD* color)
+{
+    ULONG value;
+    if (!ParseNumber(text, 16, 0xFFF, &value))
+        return FALSE;
+
+    *color = (UWORD)value;
+    return TRUE;
+}
+
+BOOL ProtocolParse(const struct ProtocolLine* line, struct ProtocolRequest* request, const char** error)
+{
+    char text[PROTOCOL_LINE_MAX];
+    char* words[MAX_WORDS + 1];
+    ULONG value;
+
+    if (line->overflow)
+    {
+        *error = "too long";
+        return FALSE;
+    }
+
+    strcpy(text, line->text);
+    int count = SplitWords(text, words);
+    if (count <= 0)
+    {
+        *error = count == 0 ? "empty" : "too many arguments";
+        return FALSE;
+    }
+
+    request->verb = -1;
+    for (int i = 0; i < PROTOCOL_VERB_COUNT; i++)
+    {
+        if (SameWord(words[0], verbs[i].name))
+        {
+            request->verb = i;
+            break;
+        }
+    }
+
+    if (request->verb == -1)
+    {
+        *error = "unknown request";
+        return FALSE;
+    }
+
+    if (count - 1 != verbs[request->verb].argCount)
+    {
+        *error = "wrong number of arguments";
+        return FALSE;
+    }
+
+    *error = "bad argument";
+    switch (request->verb)
+    {
+        case PROTOCOL_MODE:
+            if (!ParseNumber(words[1], 10, 640, &value) || (value != 320 && value != 640))
+                return FALSE;
+            request->width = (UWORD)value;
+
+            if (!ParseNumber(words[2], 10, 512, &value) || (value != 200 && value != 256 && value != 400 && value != 512))
+                return FALSE;
+            request->height = (UWORD)value;
+            break;
+
+        case PROTOCOL_PATTERN:
+            if (!ProtocolParsePattern(words[1], &request->lineMode, &request->seed))
+                return FALSE;
+            break;
+
+        case PROTOCOL_COLORS:
+            if (!ParseColor(words[1], &request->colors[0]) || !ParseColor(words[2], &request->colors[1]))
+                return FALSE;
+            break;
+
+        case PROTOCOL_COLOR:
+            if (!ParseNumber(words[1], 10, 15, &value) || !ParseColor(words[2], &request->colors[0]))
+                return FALSE;
+            request->index = (UWORD)value;
+            break;
+
+        case PROTOCOL_SWEEP:
+            if (!ParseNumber(words[1], 10, SWEEP_ORDER_COUNT - 1, &value))
+                return FALSE;
+            request->order = (UWORD)value;
+
+            if (!ParseNumber(words[2], 10, SWEEP_MAX_HOLD_FRAMES, &value) || value == 0)
+                return FALSE;
+            request->holdFrames = (UWORD)value;
+
+            if (!ParseNumber(words[3], 10, SWEEP_STEPS - 1, &request->step))
+                return FALSE;
+            break;
+
+        case PROTOCOL_KEY:
+            if (!ParseNumber(words[1], 16, 0x7F, &value))
+                return FALSE;
+            request->key = (UWORD)value;
+            break;
+
+        case PROTOCOL_WAIT:
+            if (!ParseNumber(words[1], 10, PROTOCOL_MAX_WAIT, &request->frames))
+                return FALSE;
+            break;
+    }
+
+    *error = NULL;
+    return TRUE;
+}
+
+// Append " key=value" if it fits
+static void Append(char* reply, const char* key, const char* value)
+{
+    size_t length = strlen(reply);
+    if (length + 1 + strlen(key) + 1 + strlen(value) + 1 > PROTOCOL_LINE_MAX)
+        return;
+
+    sprintf(reply + length, " %s=%s", key, value);
+}
+
+void ProtocolReplyOk(char* reply, ULONG frame)
+{
+    sprintf(reply, "OK frame=%lu", (unsigned long)frame);
+}
+
+void ProtocolReplyError(char* reply, const char* reason)
+{
+    sprintf(reply, "ERR %.*s", PROTOCOL_LINE_MAX - 5, reason);
+}
+
+void ProtocolAdd(char* reply, const char* key, ULONG value)
+{
+    char text[12];
+    sprintf(text, "%lu", (unsigned long)value);
+    Append(reply, key, text);
+}
+
+void ProtocolAddHex(char* reply, const char* key, UWORD color)
+{
+    char text[8];
+    sprintf(text, "%03x", color);
+    Append(reply, key, text);
+}
+
+void ProtocolAddText(char* reply, const char* key, const char* value)
+{
+    Append(reply, key, value);
+}
+
+BOOL ProtocolReplyIsOk(const char* reply)
+{
+    return reply[0] == 'O' && reply[1] == 'K' && (reply[2] == '\0' || reply[2] == ' ');
+}
+
+BOOL ProtocolValue(const char* reply, const char* key, char* value, int size)
+{
+    size_t keyLength = strlen(key);
+
+    for (const char* p = strchr(reply, ' '); p != NULL; p = strchr(p + 1, ' '))
+    {
+        if (strncmp(p + 1, key, keyLength) != 0 || p[1 + keyLength] != '=')
+            continue;
+
+        const char* start = p + 1 + keyLength + 1;
+        int length = 0;
+        while (start[length] != '\0' && start[length] != ' ' && length + 1 < size)
+        {
+            value[length] = start[length];
+            length++;
+        }
+        value[length] = '\0';
+        return TRUE;
+    }
+
+    return FALSE;
+}
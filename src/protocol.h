@@ -0,0 +1,106 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Remote control protocol spoken over the serial port. Every request is one
+// line of text and gets one reply line: "OK" followed by key=value pairs,
+// or "ERR" and a reason. Lines end in LF; a CR before it is ignored. Kept
+// free of OS calls so the host tools can build it too.
+//
+//   PING                       OK frame=n
+//   STATE                      OK frame=n width=.. height=.. pattern=.. ...
+//   TIMING                     OK frame=n swaps=.. setup=min/avg/max ...
+//   MODE <width> <height>      320 or 640 by 200, 256, 400 or 512
+//   PATTERN <mode>             1-14, or N:<seed> for noise, as refframe takes,
+//                              or I for the image Sparkler was started with
+//   COLORS <c0> <c1>           colors 0 and 1 as three hex digits
+//   COLOR <n> <rgb>            palette entry 0-15
+//   SWEEP <order> <hold> <step> start a sweep; order 0-2 as in sweep.h
+//   STOP                       stop a sweep or color cycle
+//   KEY <code>                 raw key code in hex, as if it were pressed
+//   WAIT <frames>              reply once that many frames have gone by
+//
+// A request that changes the display is answered once the change is on
+// screen, with the number of the first frame that shows it as counted by
+// the vertical blank server.
+
+#ifndef SPARKLER_PROTOCOL_H
+#define SPARKLER_PROTOCOL_H
+
+#include <exec/types.h>
+
+#define PROTOCOL_BAUD 19200
+// Longest line either way, with its terminating 0
+#define PROTOCOL_LINE_MAX 256
+
+// Longest WAIT, about an hour at 50 frames a second
+#define PROTOCOL_MAX_WAIT (50L * 60L * 60L)
+
+enum ProtocolVerb
+{
+    PROTOCOL_PING,
+    PROTOCOL_STATE,
+    PROTOCOL_TIMING,
+    PROTOCOL_MODE,
+    PROTOCOL_PATTERN,
+    PROTOCOL_COLORS,
+    PROTOCOL_COLOR,
+    PROTOCOL_SWEEP,
+    PROTOCOL_STOP,
+    PROTOCOL_KEY,
+    PROTOCOL_WAIT,
+    PROTOCOL_VERB_COUNT
+};
+
+// A parsed request. Only the fields of its verb are set, and they are
+// already checked against the ranges above.
+struct ProtocolRequest
+{
+    int verb;
+    UWORD width;        // MODE
+    UWORD height;
+    int lineMode;       // PATTERN
+    ULONG seed;
+    UWORD index;        // COLOR
+    UWORD colors[2];    // COLORS, and COLOR in colors[0]
+    UWORD order;        // SWEEP
+    UWORD holdFrames;
+    ULONG step;
+    UWORD key;          // KEY
+    ULONG frames;       // WAIT
+};
+
+// Received bytes gathered into a line
+struct ProtocolLine
+{
+    char text[PROTOCOL_LINE_MAX];
+    int length;
+    BOOL overflow;      // the line was longer and has been cut off
+    BOOL complete;      // text is a whole line; the next byte starts anew
+};
+
+void ProtocolLineInit(struct ProtocolLine* line);
+
+// Add a byte; TRUE once a whole line is in text. The next byte starts a
+// new line.
+BOOL ProtocolFeed(struct ProtocolLine* line, char c);
+
+// FALSE with a short reason in error if the line is not a valid request
+BOOL ProtocolParse(const struct ProtocolLine* line, struct ProtocolRequest* request, const char** error);
+
+// A pattern as PATTERN and STATE give it
+void ProtocolFormatPattern(char* text, int lineMode, ULONG seed);
+BOOL ProtocolParsePattern(const char* text, int* lineMode, ULONG* seed);
+
+// Build a reply: "OK frame=n" or "ERR reason", then key=value pairs.
+// Pairs that would not fit in a line are left out.
+void ProtocolReplyOk(char* reply, ULONG frame);
+void ProtocolReplyError(char* reply, const char* reason);
+void ProtocolAdd(char* reply, const char* key, ULONG value);
+void ProtocolAddHex(char* reply, const char* key, UWORD color);
+void ProtocolAddText(char* reply, const char* key, const char* value);
+
+// TRUE for a reply that starts with OK
+BOOL ProtocolReplyIsOk(const char* reply);
+
+// Value of key in a reply, copied to value; FALSE if the reply has none
+BOOL ProtocolValue(const char* reply, const char* key, char* value, int size);
+
+#endif
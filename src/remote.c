@@ -0,0 +1,166 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Remote control over serial.device, see remote.h
+
+#include <string.h>
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/exec.h>
+#include <exec/io.h>
+#include <devices/serial.h>
+
+#include "remote.h"
+
+static struct MsgPort* pReadPort = NULL;
+static struct MsgPort* pWritePort = NULL;
+static struct IOExtSer* pReadIO = NULL;
+static struct IOExtSer* pWriteIO = NULL;
+static BOOL deviceOpen = FALSE;
+static BOOL readPending = FALSE;
+
+static UBYTE readByte;
+static struct ProtocolLine line;
+
+static void StartRead()
+{
+    pReadIO->IOSer.io_Command = CMD_READ;
+    pReadIO->IOSer.io_Data = (APTR)&readByte;
+    pReadIO->IOSer.io_Length = 1;
+    SendIO((struct IORequest*)pReadIO);
+    readPending = TRUE;
+}
+
+BOOL RemoteInit(ULONG baud)
+{
+    pReadPort = CreateMsgPort();
+    pWritePort = CreateMsgPort();
+    if (pReadPort == NULL || pWritePort == NULL)
+    {
+        RemoteCleanup();
+        return FALSE;
+    }
+
+    pReadIO = (struct IOExtSer*)CreateIORequest(pReadPort, sizeof(struct IOExtSer));
+    pWriteIO = (struct IOExtSer*)CreateIORequest(pWritePort, sizeof(struct IOExtSer));
+    if (pReadIO == NULL || pWriteIO == NULL)
+    {
+        RemoteCleanup();
+        return FALSE;
+    }
+
+    // No XON/XOFF, so any byte can be sent
+    pReadIO->io_SerFlags = SERF_XDISABLED;
+    if (OpenDevice("serial.device", 0, (struct IORequest*)pReadIO, 0) != 0)
+    {
+        RemoteCleanup();
+        return FALSE;
+    }
+    deviceOpen = TRUE;
+
+    pReadIO->io_Baud = baud;
+    pReadIO->io_ReadLen = 8;
+    pReadIO->io_WriteLen = 8;
+    pReadIO->io_StopBits = 1;
+    pReadIO->io_SerFlags = SERF_XDISABLED;
+    pReadIO->IOSer.io_Command = SDCMD_SETPARAMS;
+    if (DoIO((struct IORequest*)pReadIO) != 0)
+    {
+        RemoteCleanup();
+        return FALSE;
+    }
+
+    // The write request shares the open device but replies to its own port
+    pWriteIO->IOSer.io_Device = pReadIO->IOSer.io_Device;
+    pWriteIO->IOSer.io_Unit = pReadIO->IOSer.io_Unit;
+
+    ProtocolLineInit(&line);
+    StartRead();
+    return TRUE;
+}
+
+void RemoteCleanup()
+{
+    if (readPending)
+    {
+        AbortIO((struct IORequest*)pReadIO);
+        WaitIO((struct IORequest*)pReadIO);
+        readPending = FALSE;
+    }
+
+    if (deviceOpen)
+    {
+        CloseDevice((struct IORequest*)pReadIO);
+        deviceOpen = FALSE;
+    }
+
+    if (pWriteIO != NULL)
+    {
+        DeleteIORequest(pWriteIO);
+        pWriteIO = NULL;
+    }
+
+    if (pReadIO != NULL)
+    {
+        DeleteIORequest(pReadIO);
+        pReadIO = NULL;
+    }
+
+    if (pWritePort != NULL)
+    {
+        DeleteMsgPort(pWritePort);
+        pWritePort = NULL;
+    }
+
+    if (pReadPort != NULL)
+    {
+        DeleteMsgPort(pReadPort);
+        pReadPort = NULL;
+    }
+}
+
+ULONG RemoteSignalMask()
+{
+    return deviceOpen ? 1L << pReadPort->mp_SigBit : 0;
+}
+
+const struct ProtocolLine* RemoteNextLine()
+{
+    // Bytes already in the device's buffer complete the next read at once
+    while (readPending && CheckIO((struct IORequest*)pReadIO) != NULL)
+    {
+        WaitIO((struct IORequest*)pReadIO);
+        readPending = FALSE;
+
+        BOOL complete = pReadIO->IOSer.io_Error == 0 && ProtocolFeed(&line, (char)readByte);
+        StartRead();
+
+        if (complete)
+        {
+            return &line;
+        }
+    }
+
+    return NULL;
+}
+
+void RemoteReply(const char* text)
+{
+    static char buffer[PROTOCOL_LINE_MAX + 1];
+
+    if (!deviceOpen)
+    {
+        return;
+    }
+
+    int length = strlen(text);
+    if (length > PROTOCOL_LINE_MAX - 1)
+    {
+        length = PROTOCOL_LINE_MAX - 1;
+    }
+    memcpy(buffer, text, length);
+    buffer[length++] = '\n';
+
+    pWriteIO->IOSer.io_Command = CMD_WRITE;
+    pWriteIO->IOSer.io_Data = (APTR)buffer;
+    pWriteIO->IOSer.io_Length = length;
+    DoIO((struct IORequest*)pWriteIO);
+}
@@ -0,0 +1,29 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Remote control over serial.device, for scripted test runs from a host.
+// One read of a byte is kept queued so the main task can sleep in Wait()
+// on the port signal; replies are written synchronously. The requests and
+// replies are in protocol.h.
+
+#ifndef SPARKLER_REMOTE_H
+#define SPARKLER_REMOTE_H
+
+#include <exec/types.h>
+
+#include "protocol.h"
+
+// Open the serial port at baud, 8N1 with no flow control. FALSE if the
+// device is in use or missing.
+BOOL RemoteInit(ULONG baud);
+void RemoteCleanup(void);
+
+// Signal set when bytes come in, 0 when the port is not open
+ULONG RemoteSignalMask(void);
+
+// Next whole request line that has come in, or NULL. The line stays valid
+// until the next call.
+const struct ProtocolLine* RemoteNextLine(void);
+
+// Send a reply line; the line end is added
+void RemoteReply(const char* text);
+
+#endif
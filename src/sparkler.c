@@ -4,7 +4,70 @@
 // on boards that have issues.
 // Any modifications to this code must include the above comment
 // followed by documentation of the changes below.
-
+//
+// Changes:
+// - Test patterns are generated row by row with longword stores (pattern.c)
+// - Pattern bitmaps are cached; switching line mode only repoints the
+//   bitplanes in the copper lists (patcache.c)
+// - Copper lists are built and patched through a small builder with named
+//   slots, sized from a measuring pass instead of a fixed 2000 bytes (copper.c)
+// - Copper lists are double buffered; edits go to the back pair and a
+//   vertical blank interrupt server swaps them in (vblank.c)
+// - Keyboard input comes from an input.device handler; toggles act on key
+//   down edges, color keys auto-repeat after "Sparkler REPEAT <delay> <rate>"
+//   frames, and the main loop sleeps in Wait() instead of polling the key
+//   matrix (input.c)
+// - Colors and bitplane pointers are posted to a mailbox that the vertical
+//   blank server applies on the next frame (vblank.c)
+// - The debug text is drawn into its own overlay plane, shown only in a band
+//   at the top, and only fields whose value changed are redrawn (hud.c)
+// - The debug text uses a built-in 8x8 font drawn straight into the overlay
+//   plane; diskfont.library and helvetica.font are no longer needed (font.c)
+// - Color band mode: the copper reloads color 0 and 1 every few lines so one
+//   frame tests hundreds of color pairs, with a legend in the HUD (copper.c)
+// - Unattended color sweep through every C0/C1 pair, stepped by the vertical
+//   blank server and checkpointed to a file so it can be resumed (sweep.c)
+// - De Bruijn patterns on keys 8 and 9: every run of k pixel colors
+//   appears on screen (pattern.c)
+// - Pattern bitmaps have four planes. The copper switches plane 4 from the
+//   HUD to the bitmap below the HUD band and reloads colors 8-15 there.
+//   Multi-plane patterns on key 0, De Bruijn patterns over 16 colors with
+//   k from 2 to 4, the HUD showing the percent of runs on screen when a
+//   sequence is too long for the display, and every palette entry can be
+//   edited with TAB and R, G, B; edits show during a sweep too (copper.c)
+// - Noise pattern on N: xorshift32 longwords from a seed shown in the HUD,
+//   a new seed on every press, and the host tools take the seed to render
+//   the same frame (pattern.c)
+// - Hardware scrolling on M, speeds on the cursor keys: the vertical blank
+//   server moves BPLCON1 and the plane pointers in the copper lists every
+//   frame, and the copper wraps the bitmap, so no bitmap data is copied
+//   (vblank.c)
+// - Color cycling on C: a loop of whole palettes is built when it starts and
+//   the vertical blank server steps through it every N frames, counting
+//   any frame a step goes up late (cycle.c)
+// - Chip bus stress on Q, W and E: chained blitter copies, eight sprites
+//   and a CPU task hammering chip RAM, each on its own, with the bus load
+//   per frame in the HUD (stress.c)
+// - Raster line profiler: getting the bitmap, setting up the display,
+//   updating the HUD and sleeping are timed from the beam position, shown
+//   in the HUD one phase at a time on P and logged on exit (profile.c)
+// - One block of chip RAM is reserved at startup for the copper lists, the
+//   HUD plane and the pattern bitmaps, sized from the largest mode, so mode
+//   changes allocate nothing from the system (arena.c)
+// - Interlace runs one copper list for both fields instead of two lists
+//   chained through COP1LC; the vertical blank server reads the long frame
+//   bit and points its planes at the field every frame shows. Interlaced
+//   bands are at least two rows (vblank.c)
+// - Remote control with "Sparkler REMOTE [baud]": requests on the serial
+//   port set the mode, pattern, colors and sweep, press keys and read the
+//   state and timing counters, each answered with the frame its change
+//   first showed on (remote.c, protocol.c)
+// - Images from files with "Sparkler IMAGE <file>", shown on I: IFF ILBM
+//   pictures with ByteRun1 rows unpacked straight into the chip RAM planes
+//   and the CMAP loaded into the palette, or raw planar dumps (image.c)
+
+#include <stdlib.h>
+#include <string.h>
 #include <exec/types.h>
 #include <exec/memory.h>
 #include <exec/exec.h>
@@ -15,194 +78,105 @@
 #include <graphics/gfxmacros.h>
 #include <graphics/copper.h>
 #include <hardware/dmabits.h>
-#include <devices/keyboard.h>
+
+#include "pattern.h"
+#include "patcache.h"
+#include "arena.h"
+#include "copper.h"
+#include "vblank.h"
+#include "input.h"
+#include "hud.h"
+#include "sweep.h"
+#include "cycle.h"
+#include "stress.h"
+#include "profile.h"
+#include "remote.h"
+#include "image.h"
 
 struct ExecLibrary* SysBase = NULL;
 struct GfxBase* GfxBase = NULL;
-struct DiskfontBase* DiskfontBase = NULL;
 
 extern struct Custom custom;
-extern struct CIA ciaa;
-
-// Two copperlists, second used for interlaced mode
-UWORD* g_pCopperList = NULL;
-UWORD* g_pCopperList2 = NULL;
 
 // Pointer to the main bitmap used for displaying test patterns
 struct BitMap* g_pBitmap = NULL;
 
-// RastPort used by Draw() to draw on bitmaps
-struct RastPort g_rp;
-
 // Any registers that need to be restored on exit can be saved here
 struct Custom g_oldRegs;
 
-// Keyboard related stuff
-struct IOStdReq* KeyIO = NULL;
-struct MsgPort* KeyMP;
-char* keyMatrix;
-#define MATRIX_SIZE 16L
+// Chip RAM for the HUD overlay plane
+UBYTE* g_pHudPlane = NULL;
 
-void ReadKeyboard()
-{
-    KeyIO->io_Command = KBD_READMATRIX;
-    KeyIO->io_Data = (APTR)keyMatrix;
-    KeyIO->io_Length = MATRIX_SIZE;
-    
-    DoIO((struct IORequest*)KeyIO);
-}
+// Most bands one frame can show, one per row of a 512 row display
+#define BAND_MAX 512
 
-BOOL GetKeyState(int rawKey)
+struct 
 {
-    if (keyMatrix == NULL)
-        return FALSE;
-    
-    // raw key is the bit number
-    int byteNumber = rawKey / 8;
-    int bitNumber = rawKey % 8;
+    UWORD r[16];
+    UWORD g[16];
+    UWORD b[16];
+    int editColor;      // palette entry the R, G and B keys change
 
-    if ((keyMatrix[byteNumber] & (1<<bitNumber))!=0)
-        return TRUE;
+    BOOL bands;         // color band mode
+    UWORD bandRows;
+    UWORD bandRowsBuilt;    // in the current lists, even for interlace
+    UWORD bandCount;    // bands in the current lists
+    ULONG bandBuilds;   // changes whenever the band colors are rebuilt
 
-    return FALSE;
-}
+    BOOL sweeping;
+    struct SweepCheckpoint sweep;   // order, hold and the step to resume at
+    ULONG sweepChanges;             // changes whenever a sweep setting does
+    ULONG sweepSavedFrame;
 
-// Allocate and initialize a bitmap with the specified line mode
-void createBitmap(int width, int height, int lineMode)
-{
-    g_pBitmap = AllocBitMap(width, height, 4, BMF_CLEAR|BMF_DISPLAYABLE);
+    int deBruijnOrder;  // order key 8 selects
+    ULONG noiseSeed;
 
-    g_rp.BitMap = g_pBitmap;
-    struct RastPort* rp = &g_rp;
+    BOOL scrolling;     // lists are built for hardware scrolling
 
-    int bytesPerLine = width/8; 
+    BOOL cycling;
+    int cycleKind;
+    UWORD cycleHold;    // frames per cycle step
+    int cycleSteps;
+    ULONG cycleChanges; // changes whenever a cycle setting does
 
-    BOOL evenX = FALSE;
-    int xCounter = 0;
-    for (int x=0; x < bytesPerLine; x++) 
-    {
-        BOOL evenLine = TRUE;
-        for (int y=0; y < height; y++)
-        {
-            int index = (y * bytesPerLine);
-            index += x;
-            UBYTE val = 0x55;
+    int profilePhase;   // shown in the HUD
 
-            if (y == height - 1)
-            {
-                g_pBitmap->Planes[0][index] = 0xff;
-            }
-            else if (lineMode == 1) // alternating pixels
-            {
-                if (evenLine)
-                {
-                    g_pBitmap->Planes[0][index] = 0x55;
-                } 
-                else
-                {
-                    g_pBitmap->Planes[0][index] = 0xAA;
-                }
-            }
-            else if (lineMode == 2) // vertical bars
-            {
-                if (evenX)
-                {
-                    g_pBitmap->Planes[0][index] = 0xAA;
-                }
-                else
-                {
-                    g_pBitmap->Planes[0][index] = 0xAA;
-                }
-            }
-            else if (lineMode == 3) // horizontal bars
-            {
-                if (evenLine)
-                {
-                    g_pBitmap->Planes[0][index] = 0xFF;
-                }
-                else
-                {
-                    g_pBitmap->Planes[0][index] = 0x00;
-                }
-            }
-            else if (lineMode == 4) // solid fill
-            {
-                g_pBitmap->Planes[0][index] = 0xff;
-            }
-            else if (lineMode == 5) // vertical bars 2
-            {
-                if (xCounter == 0)
-                {
-                    g_pBitmap->Planes[0][index] = 0x92;
-                }
-                else if (xCounter == 1)
-                {
-                    g_pBitmap->Planes[0][index] = 0x49;
-                }
-                else if (xCounter == 2)
-                {
-                    g_pBitmap->Planes[0][index] = 0x24;
-                }
-                
-            }
-            else if (lineMode == 6) // vertical bars 3
-            {
-                g_pBitmap->Planes[0][index] = 0x88;
-            }
-            else if (lineMode == 7) // vertical bars 3
-            {
-                if (xCounter == 0)
-                {
-                    g_pBitmap->Planes[0][index] = 0x84;
-                }
-                else if (xCounter == 1)
-                {
-                        g_pBitmap->Planes[0][index] = 0x21;
-                }
-                else if (xCounter == 2)
-                {
-                    g_pBitmap->Planes[0][index] = 0x8;
-                }
-                else if (xCounter == 3)
-                {
-                    g_pBitmap->Planes[0][index] = 0x42;
-                }
-                else if (xCounter == 4)
-                {
-                    g_pBitmap->Planes[0][index] = 0x10;
-                }
-            }
+    BOOL remote;        // taking requests on the serial port
+    int remoteReply;    // how the request being run gets its answer
+    ULONG remoteSince;  // frame it was taken on
+    ULONG remoteWaitFrame;
+    int remoteKey;      // KEY to run as if pressed, or -1
 
-            evenLine = !evenLine;
-        }
-        evenX = !evenX;
-        xCounter++;
-        if (lineMode == 5 && xCounter == 3)
-        {
-            xCounter = 0;
-        }
-        if (lineMode == 7 && xCounter == 5)
-        {
-            xCounter = 0;
-        }
-    }
-}
+    const char* imagePath;  // image shown on I, NULL if none was given
+    struct ImageInfo image; // its header and CMAP
 
-void freeBitmap()
-{
-    FreeBitMap(g_pBitmap);
-}
+} Globals;
 
-struct 
+// A remote request is answered at once, once its change is on screen, or
+// once its WAIT is over. The next one is only taken after that.
+enum RemoteReplyKind
 {
-    int copperList1ColorStartIndex;
-    int copperList2ColorStartIndex;
-    
-    UWORD r[2];
-    UWORD g[2];
-    UWORD b[2];
+    REMOTE_IDLE,
+    REMOTE_WHEN_SHOWN,
+    REMOTE_AFTER_WAIT
+};
 
-} Globals;
+// The palettes the server cycles through
+UWORD g_cyclePalettes[CYCLE_MAX_STEPS][16];
+
+// Fastest scroll, in BPLCON1 steps or rows per frame
+#define SCROLL_MAX_SPEED 8
+
+// COLOR00 and COLOR01 for each band
+UWORD g_bandColors[BAND_MAX][2];
+
+// Arguments of the last setupDisplay() call
+struct
+{
+    BOOL hires;
+    BOOL interlaced;
+    BOOL pal;
+} g_lastDisplay;
 
 struct DebugInfo
 {
@@ -213,288 +187,321 @@ struct DebugInfo
     int lineMode;
     BOOL colorOrTextChanged;
     BOOL showhelp;
-    char debugText[255];
     BOOL pal;
-    struct TextFont* pFont1;
 };
 
-// Create copperlists and start the display
-void setupDisplay(BOOL hires, BOOL interlaced, BOOL pal)
+// The mode and pattern on screen, put back when a change can't be shown
+struct ShownPattern
 {
-    const int loresInterlacedBpl = 0x28;
-    const int hiresInterlacedBpl = 0x50;
+    BOOL hires;
+    BOOL interlaced;
+    BOOL pal;
+    int lineMode;
+    ULONG noiseSeed;
+    int deBruijnOrder;
+};
+
+void keepShownPattern(struct ShownPattern* pShown, const struct DebugInfo* dbgInfo)
+{
+    pShown->hires = dbgInfo->hires;
+    pShown->interlaced = dbgInfo->interlaced;
+    pShown->pal = dbgInfo->pal;
+    pShown->lineMode = dbgInfo->lineMode;
+    pShown->noiseSeed = Globals.noiseSeed;
+    pShown->deBruijnOrder = Globals.deBruijnOrder;
+}
+
+void restoreShownPattern(const struct ShownPattern* pShown, struct DebugInfo* dbgInfo)
+{
+    dbgInfo->hires = pShown->hires;
+    dbgInfo->interlaced = pShown->interlaced;
+    dbgInfo->pal = pShown->pal;
+    dbgInfo->lineMode = pShown->lineMode;
+    Globals.noiseSeed = pShown->noiseSeed;
+    Globals.deBruijnOrder = pShown->deBruijnOrder;
+}
 
-    if (pal)
+void putBitplanePointers(struct DisplayState* pState)
+{
+    for (int plane = 0; plane < 4; plane++)
     {
-        custom.beamcon0 = 0x20;
+        pState->planes[plane] = (ULONG)g_pBitmap->Planes[plane];
     }
-    else
+    pState->rowBytes = g_pBitmap->BytesPerRow;
+}
+
+// The HUD overlay replaces the fourth plane in a band as tall as its text
+void putHud(struct DisplayState* pState, BOOL interlaced)
+{
+    pState->hudPlane = (ULONG)HudPlane();
+
+    // each field shows every other row of the overlay
+    pState->hudLines = interlaced ? (HudRows() + 1) / 2 : HudRows();
+}
+
+void putCopperColors(struct DisplayState* pState)
+{
+    for (int i = 0; i < 16; i++)
     {
-        custom.beamcon0 = 0x00;
+        pState->colors[i] = (UWORD)((Globals.r[i] << 8) | (Globals.g[i] << 4) | Globals.b[i]);
     }
-    
-    custom.dmacon = DMAF_ALL;
-    UWORD oldIntena = custom.intenar;
-    custom.intena = 0x7fff; // disable interrupts
+}
 
-    UWORD bplmod = 0;
-    if (interlaced)
+// Show the planes of g_pBitmap from the next frame on. Only valid when the
+// bitmap has the same size as the one setupDisplay() was called with.
+void setBitplanePointers()
+{
+    putBitplanePointers(DisplayBeginChange());
+    DisplayPostChange();
+}
+
+// Resize the HUD band after a layout from the next frame on
+void setHud(BOOL interlaced)
+{
+    putHud(DisplayBeginChange(), interlaced);
+    DisplayPostChange();
+}
+
+// Show the palette from Globals from the next frame on
+void setCopperColors()
+{
+    putCopperColors(DisplayBeginChange());
+    DisplayPostChange();
+}
+
+// Load the startup palette for colors 2-15 and post it with colors 0 and 1
+void initDisplayState()
+{
+    static const UWORD colorValues[] = { 0, 0xfbf, 0x710, 0xC10, 0x910, 0xE20, 0xFCB, 0xFFF, 0xF42, 0x0, 0xF98, 0xF65, 0xC54, 0x322, 0x444, 0x888 };
+
+    for (int i = 2; i < 16; i++)
     {
-        if (hires)
-        {
-            bplmod = hiresInterlacedBpl;
-        }
-        else
-        {
-            bplmod = loresInterlacedBpl;
-        }
+        Globals.r[i] = colorValues[i] >> 8;
+        Globals.g[i] = (colorValues[i] >> 4) & 0xF;
+        Globals.b[i] = colorValues[i] & 0xF;
     }
-    
-    int i = 0;
-    g_pCopperList[i++] = 0x100; // bplcon0
-    
-    UWORD bplcon0 = 0x4200;
-    if (hires)
+
+    putCopperColors(DisplayBeginChange());
+    DisplayPostChange();
+}
+
+// C0 and C1 from Globals as one 24 bit value, C0 in the upper half
+ULONG getColorPair()
+{
+    ULONG c0 = (Globals.r[0] << 8) | (Globals.g[0] << 4) | Globals.b[0];
+    ULONG c1 = (Globals.r[1] << 8) | (Globals.g[1] << 4) | Globals.b[1];
+    return (c0 << 12) | c1;
+}
+
+void setColorPair(ULONG pair)
+{
+    for (int i = 0; i < 2; i++)
     {
-        bplcon0 = 0xC200;
+        UWORD color = (UWORD)((i == 0 ? pair >> 12 : pair) & 0xFFF);
+        Globals.r[i] = (color >> 8) & 0xF;
+        Globals.g[i] = (color >> 4) & 0xF;
+        Globals.b[i] = color & 0xF;
     }
-    if (interlaced)
+}
+
+// Band n, counted from the top, shows the pair n steps after the one in
+// Globals. Returns the number of bands of rows rows for a display of height
+// rows.
+int fillBandColors(int height, int rows)
+{
+    int count = (height + rows - 1) / rows;
+    if (count > BAND_MAX)
     {
-        bplcon0 |= 0x04;
+        count = BAND_MAX;
     }
-    g_pCopperList[i++] = bplcon0;
 
-    g_pCopperList[i++] = 0x108; // bpl1mod
-    g_pCopperList[i++] = bplmod;
-
-    g_pCopperList[i++] = 0x10A; // bpl2mod
-    g_pCopperList[i++] = bplmod;
-    
-    g_pCopperList[i++] = 0x092; // DDFSTART
-    g_pCopperList[i++] = 0x38;
+    ULONG pair = getColorPair();
+    for (int i = 0; i < count; i++)
+    {
+        ULONG bandPair = (pair + i) & 0xFFFFFF;
+        g_bandColors[i][0] = (UWORD)(bandPair >> 12);
+        g_bandColors[i][1] = (UWORD)(bandPair & 0xFFF);
+    }
 
-    g_pCopperList[i++] = 0x094; // DDFSTOP
-    g_pCopperList[i++] = 0xd0;
+    Globals.bandBuilds++;
+    return count;
+}
 
-    UWORD colorIndex = 0x180;
+// Everything the copper lists are built from
+void getCopperDisplay(struct CopperDisplay* display, const struct DisplayState* pState, BOOL hires, BOOL interlaced, BOOL pal, UWORD bplmod)
+{
+    display->hires = hires;
+    display->interlaced = interlaced;
+    display->pal = pal;
+    display->modulo = bplmod;
+    display->rowBytes = pState->rowBytes;
+    display->hudPlane = pState->hudPlane;
+    display->hudColor = HUD_TEXT_COLOR;
+    display->hudLines = pState->hudLines;
+    display->bandRows = 0;
+    display->bandCount = 0;
+    display->bandColors = g_bandColors;
+    display->scroll = Globals.scrolling;
+    display->scrollX = g_scrollMotion.x;
+    display->scrollY = g_scrollMotion.y;
+
+    if (Globals.bands)
+    {
+        // Both fields of an interlaced display run the same list, so a
+        // band covers at least the two rows of a line
+        int height = (pal ? 256 : 200) * (interlaced ? 2 : 1);
+        Globals.bandRowsBuilt = interlaced && Globals.bandRows < 2 ? 2 : Globals.bandRows;
+        Globals.bandCount = fillBandColors(height, Globals.bandRowsBuilt);
+        display->bandRows = Globals.bandRowsBuilt;
+        display->bandCount = Globals.bandCount;
+    }
 
-    // Setup a color palette; has more colors than we actually use
-    UWORD colorValues[] = { 0, 0xfbf, 0x710, 0xC10, 0x910, 0xE20, 0xFCB, 0xFFF, 0xF42, 0x0, 0xF98, 0xF65, 0xC54, 0x322, 0x444, 0x888 };
-    Globals.copperList1ColorStartIndex = i;
+    for (int i = 0; i < 4; i++)
+    {
+        display->planes[i] = pState->planes[i];
+    }
 
-    for (int j=0;j < 16;j++)
+    for (int i = 0; i < 16; i++)
     {
-        g_pCopperList[i++] = colorIndex;
-        colorIndex+=2;
-        g_pCopperList[i++] = colorValues[j];
+        display->colors[i] = pState->colors[i];
     }
+}
 
-    int bitplaneIndex = 0;
-    g_pCopperList[i++] = 0x00E0;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF0000) >> 16;
+// Create copperlists and start the display
+void setupDisplay(BOOL hires, BOOL interlaced, BOOL pal)
+{
+    const int loresInterlacedBpl = 0x28;
+    const int hiresInterlacedBpl = 0x50;
 
-    i++;
-    g_pCopperList[i++] = 0x00E2;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF);
-    i++;
+    ProfileSetFrameLines(pal ? 313 : 263);
+    ProfileBegin(PROFILE_SETUP);
 
-    bitplaneIndex++;
-    g_pCopperList[i++] = 0x00E4;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF0000) >> 16;
-    
-    i++;
-    g_pCopperList[i++] = 0x00E6;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF);
-    i++;
-
-    bitplaneIndex++;
-    g_pCopperList[i++] = 0x00E8;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF0000) >> 16;
-
-    i++;
-    g_pCopperList[i++] = 0x00EA;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF);
-    i++;
-
-    bitplaneIndex++;
-    g_pCopperList[i++] = 0x00EC;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF0000) >> 16;
-
-    i++;
-    g_pCopperList[i++] = 0x00EE;
-    g_pCopperList[i] = ((unsigned int)(g_pBitmap->Planes[bitplaneIndex]) & 0xFFFF);
-    i++;
-
-    // move #$3481, $dff08e (DIWSTRT)
-    g_pCopperList[i++] = 0x008e;
-    // g_pCopperList[i++] = 0x3481;
-    g_pCopperList[i++] = 0x2c81;
-
-    //0090 FCC1 move #$FCC1,$DFF090 (DIWSTOP)
-    g_pCopperList[i++] = 0x0090;
-    
-    if (pal)
-        g_pCopperList[i++] = 0x2CC1;
-    else
-        g_pCopperList[i++] = 0xF4C1;
+    g_lastDisplay.hires = hires;
+    g_lastDisplay.interlaced = interlaced;
+    g_lastDisplay.pal = pal;
+
+    // Only sprite, audio and disk DMA are stopped; the display keeps running
+    // on the front copper lists until the new ones are swapped in
+    custom.dmacon = DMAF_ALL & ~(DMAF_RASTER|DMAF_COPPER|DMAF_BLITTER);
 
-    // For interlaced mode we need another copperlist for the other field
+    UWORD bplmod = 0;
     if (interlaced)
     {
-        int j = 0;
-        g_pCopperList2[j++] = 0x100; // bplcon0
-        
-        bplcon0 = 0x4200;
         if (hires)
         {
-            bplcon0 = 0xC200;
+            bplmod = hiresInterlacedBpl;
         }
-        if (interlaced)
+        else
         {
-            bplcon0 |= 0x04;
+            bplmod = loresInterlacedBpl;
         }
-        g_pCopperList2[j++] = bplcon0;
+    }
 
-        g_pCopperList2[j++] = 0x108; // bpl1mod
-        g_pCopperList2[j++] = bplmod;
+    // The new lists start out with the current colors and bitmap, posted
+    // together with them so the server never applies the new bitmap to the
+    // old lists
+    struct DisplayState* pState = DisplayBeginChange();
+    putCopperColors(pState);
+    putBitplanePointers(pState);
+    putHud(pState, interlaced);
 
-        g_pCopperList2[j++] = 0x10A; // bpl2mod
-        g_pCopperList2[j++] = bplmod;
-        
-        g_pCopperList2[j++] = 0x092; // DDFSTART
-        g_pCopperList2[j++] = 0x38;
+    struct CopperDisplay display;
+    getCopperDisplay(&display, pState, hires, interlaced, pal, bplmod);
 
-        g_pCopperList2[j++] = 0x094; // DDFSTOP
-        g_pCopperList2[j++] = 0xd0;
+    CopperBeginEdit(TRUE);
 
-        Globals.copperList2ColorStartIndex = j;
+    // Interlace runs this list for both fields; the server points it at
+    // the field each frame shows
+    CopperInit(CopperBack(), CopperBackWords(), g_copper.listSize);
+    CopperBuild(CopperBack(), &display);
 
-        for (int k=0;k < 16;k++)
-        {
-            g_pCopperList2[j++] = colorIndex;
-            colorIndex+=2;
-            g_pCopperList2[j++] = colorValues[k];
-        }
+    CopperSetMode(pal ? 0x20 : 0x00, hires, interlaced, bplmod, Globals.scrolling);
+    CopperCommitWithDisplay();
+    
+    // DMAF_BLITTER is required if you want to use various RastPort functions like Text and SetRast
+    // Sprite DMA comes back on if the sprite stress is running
+    custom.dmacon = DMAF_SETCLR|DMAF_RASTER|DMAF_COPPER|DMAF_BLITTER|StressDmaBits();
+    custom.intena = INTF_SETCLR|INTF_INTEN|INTF_VERTB;
 
-        bitplaneIndex = 0;
-        g_pCopperList2[j++] = 0x00E0;
-        
-        unsigned int bitplaneOffset = bplmod; 
-        
-        unsigned int addr = g_pBitmap->Planes[bitplaneIndex];
-        addr += bitplaneOffset; // start on the next line for this field
-        
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF0000) >> 16;
-
-        j++;
-        g_pCopperList2[j++] = 0x00E2;
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF);
-        j++;
-
-        bitplaneIndex++;
-        addr = g_pBitmap->Planes[bitplaneIndex];
-        addr += bitplaneOffset; // start on the next line for this field
-
-        g_pCopperList2[j++] = 0x00E4;
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF0000) >> 16;
-        j++;
-
-        g_pCopperList2[j++] = 0x00E6;
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF);
-        j++;
-
-        bitplaneIndex++;
-        addr = g_pBitmap->Planes[bitplaneIndex];
-        addr += bitplaneOffset; // start on the next line for this field
-
-        g_pCopperList2[j++] = 0x00E8;
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF0000) >> 16;
-        j++;
-
-        g_pCopperList2[j++] = 0x00EA;
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF);
-        j++;
-
-        bitplaneIndex++;
-        addr = g_pBitmap->Planes[bitplaneIndex];
-        addr += bitplaneOffset; // start on the next line for this field
-
-        g_pCopperList2[j++] = 0x00EC;
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF0000) >> 16;
-        j++;
-
-        g_pCopperList2[j++] = 0x00EE;
-        g_pCopperList2[j] = ((unsigned int)(addr) & 0xFFFF);
-        j++;
-
-        // move #$3481, $dff08e (DIWSTRT)
-        g_pCopperList2[j++] = 0x008e;
-        // g_pCopperList[i++] = 0x3481;
-        g_pCopperList2[j++] = 0x2c81;
-
-        //0090 FCC1 move #$FCC1,$DFF090 (DIWSTOP)
-        g_pCopperList2[j++] = 0x0090;
-        
-        if (pal)
-        {
-            g_pCopperList2[j++] = 0x2CC1;
-        }
-        else
-        {
-            g_pCopperList2[j++] = 0xF4C1;
-        }
+    ProfileEnd(PROFILE_SETUP);
+}
 
-        // F401 FFFE wait HP=0(0x00),VP=244(0xF4) (VE=127,HE=127,BlitterFinishDisable=1)
-        g_pCopperList2[j++] = 0xf401;
-        g_pCopperList2[j++] = 0xfffe;
+// Rebuild the lists for the display on screen, e.g. after the bands changed
+void rebuildDisplay()
+{
+    setupDisplay(g_lastDisplay.hires, g_lastDisplay.interlaced, g_lastDisplay.pal);
+}
 
-        // 0084 0002 move #$0002,$DFF084 (COP1LCH)
-        g_pCopperList2[j++] = 0x080;
-        g_pCopperList2[j++] = (UWORD)(((unsigned int)g_pCopperList & 0xFFFF0000) >> 16);
+void startSweep()
+{
+    ColorSequenceStart(SweepPairFunction(Globals.sweep.order), SWEEP_STEPS, Globals.sweep.step, Globals.sweep.holdFrames);
+    Globals.sweeping = TRUE;
+    Globals.sweepSavedFrame = g_vblankTicks.frames;
+    Globals.sweepChanges++;
+}
 
-        // 0086 1050 move #$1050,$DFF086 (COP1LCL)
-        g_pCopperList2[j++] = 0x082;
-        g_pCopperList2[j++] = (UWORD)((unsigned int)g_pCopperList & 0xFFFF);
+// Note where the sweep is, so stopping, a checkpoint and a restart all
+// continue from the pair on screen
+void saveSweep()
+{
+    if (Globals.sweeping)
+    {
+        Globals.sweep.step = g_colorSequence.finished ? 0 : g_colorSequence.step;
+    }
 
-        //FFFF FFFE wait HP=254(0xFE),VP=255(0xFF) (VE=127,HE=127,BlitterFinishDisable=1)
-        g_pCopperList2[j++] = 0xFFFF;
-        g_pCopperList2[j++] = 0xFFFE;
+    SweepSaveCheckpoint(&Globals.sweep);
+    Globals.sweepSavedFrame = g_vblankTicks.frames;
+}
 
-        // the part that applies to the first copperlist
-        // F401 FFFE wait HP=0(0x00),VP=244(0xF4) (VE=127,HE=127,BlitterFinishDisable=1)
-        g_pCopperList[i++] = 0xf401;
-        g_pCopperList[i++] = 0xfffe;
+void stopSweep()
+{
+    ColorSequenceStop();
+    saveSweep();
+    Globals.sweeping = FALSE;
+    Globals.sweepChanges++;
+
+    // Leave the last pair on screen through the normal path
+    setColorPair(g_colorSequence.pair);
+    setCopperColors();
+}
 
-        // 0084 0002 move #$0002,$DFF084 (COP1LCH)
-        g_pCopperList[i++] = 0x080;
-        g_pCopperList[i++] = (UWORD)(((unsigned int)g_pCopperList2 & 0xFFFF0000) >> 16);
+// Build the cycle from the palette in Globals and hand it to the server,
+// starting at step
+void startCycle(ULONG step)
+{
+    // The server must be done with the old table before it is rebuilt
+    ColorSequenceStop();
 
-        // 0086 1050 move #$1050,$DFF086 (COP1LCL)
-        g_pCopperList[i++] = 0x082;
-        g_pCopperList[i++] = (UWORD)((unsigned int)g_pCopperList2 & 0xFFFF);
+    UWORD palette[16];
+    for (int i = 0; i < 16; i++)
+    {
+        palette[i] = (UWORD)((Globals.r[i] << 8) | (Globals.g[i] << 4) | Globals.b[i]);
     }
 
-    // copper list end
-    g_pCopperList[i++] = 0xFFFF;
-    g_pCopperList[i++] = 0xFFFE;
+    Globals.cycleSteps = CycleBuild(Globals.cycleKind, palette, g_cyclePalettes);
+    ColorCycleStart(g_cyclePalettes, Globals.cycleSteps, step, Globals.cycleHold);
+    Globals.cycling = TRUE;
+    Globals.cycleChanges++;
+}
 
+void stopCycle()
+{
+    ColorSequenceStop();
+    Globals.cycling = FALSE;
+    Globals.cycleChanges++;
 
-    int offset = 1; // color00, (write to value)
-    // fix the colors to match what the user has set
-    g_pCopperList[Globals.copperList1ColorStartIndex + offset] = (UWORD)((Globals.r[0] << 8) | (Globals.g[0] << 4) | Globals.b[0]);
-    g_pCopperList2[Globals.copperList2ColorStartIndex + offset] = (UWORD)((Globals.r[0] << 8) | (Globals.g[0] << 4) | Globals.b[0]);
+    // Put the palette in Globals back
+    setCopperColors();
+}
 
-    offset = 3; // color00, value, color1 (2 bytes each), and now write to value (3 because this is a UWORD*)
-    // fix the colors to match what the user has set
-    g_pCopperList[Globals.copperList1ColorStartIndex + offset] = (UWORD)((Globals.r[1] << 8) | (Globals.g[1] << 4) | Globals.b[1]);
-    g_pCopperList2[Globals.copperList2ColorStartIndex + offset] = (UWORD)((Globals.r[1] << 8) | (Globals.g[1] << 4) | Globals.b[1]);
-    
-    custom.cop1lc = g_pCopperList;
-    custom.copjmp1 = 0;
-    
-    // DMAF_BLITTER is required if you want to use various RastPort functions like Text and SetRast
-    custom.dmacon = DMAF_SETCLR|DMAF_RASTER|DMAF_COPPER|DMAF_BLITTER;
-    custom.intena = INTF_SETCLR|INTF_INTEN|INTF_VERTB | oldIntena;
+// Scroll speeds step by one up to SCROLL_MAX_SPEED either way
+void ChangeScrollSpeed(volatile WORD* speed, int change)
+{
+    int next = *speed + change;
+    if (next >= -SCROLL_MAX_SPEED && next <= SCROLL_MAX_SPEED)
+    {
+        *speed = (WORD)next;
+    }
 }
 
 void ChangeColorValue(UWORD* colorValue, BOOL* colorOrTextChanged)
@@ -517,65 +524,432 @@ void ChangeColorValue(UWORD* colorValue, BOOL* colorOrTextChanged)
     }
 }
 
-// Simple delay that works reasonably well on all Amigas
-void Delay()
+// Read the header and CMAP of the image to show on I. A raw file has to be
+// whole planes of at least one display size.
+void openImage(const char* path)
 {
-    for (int i=0;i<5;i++)
+    int error = ImageLoadFile(path, &Globals.image, NULL, 0, 0, 0);
+    if (error == IMAGE_OK && Globals.image.raw)
     {
-        WaitTOF();
+        static const int widths[] = { 320, 640 };
+        static const int heights[] = { 200, 256, 400, 512 };
+
+        error = IMAGE_BAD_SIZE;
+        for (int w = 0; w < 2; w++)
+        {
+            for (int h = 0; h < 4; h++)
+            {
+                ULONG planeBytes = (ULONG)(widths[w] / 8) * heights[h];
+                ULONG planes = Globals.image.rawBytes / planeBytes;
+                if (Globals.image.rawBytes % planeBytes == 0 && planes <= IMAGE_MAX_DEPTH)
+                {
+                    error = IMAGE_OK;
+                }
+            }
+        }
     }
+
+    if (error != IMAGE_OK)
+    {
+        printf("%s: %s, no image\n", path, ImageErrorText(error));
+        return;
+    }
+
+    Globals.imagePath = path;
+    PatternCacheSetImage(path);
 }
 
-void DrawDebugInfo(struct RastPort* rp, struct DebugInfo* dbgInfo)
+// Show the image with its CMAP in the palette; a running sweep keeps
+// colors 0 and 1
+void selectImage(struct DebugInfo* dbgInfo)
 {
-    SetAPen(rp, 255);
-    SetBPen(rp, 0);
-    rp->DrawMode = JAM2;
-    rp->cp_x = dbgInfo->hires ? 20 : 0;
-    
-    rp->cp_y = 10;
-    char title[] = "Sparkler V1.0 - RGB2HDMI Test Tool - by Bloodmosher";
-    Text(rp, title, strlen(title));
-
-    rp->cp_x = dbgInfo->hires ? 20 : 0;
-    rp->cp_y = 22;
-
-    sprintf(dbgInfo->debugText, "%s %dx%d I:%d P:%d C0(R:%x G:%x B:%x) C1(R:%x G:%x B:%x)", 
-                dbgInfo->pal ? "PAL" : "NTSC", 
-                dbgInfo->width, 
-                dbgInfo->height, 
-                dbgInfo->interlaced, 
-                dbgInfo->lineMode, 
-                Globals.r[0], Globals.g[0], Globals.b[0], 
-                Globals.r[1], Globals.g[1], Globals.b[1]);
-
-    Text(rp, dbgInfo->debugText, strlen(dbgInfo->debugText));
-
-    if (dbgInfo->showhelp)
-    {
-         char* helpLines[] = {
-            {"F1: Toggle lores/hires"},
-            {"F2: Toggle interlaced"},
-            {"F3, F4, F5: Color 0 RGB - hold SHIFT for reverse direction"},
-            {"F8, F9, F10: Color 1 RGB - hold SHIFT for reverse direction"},
-            {"Number keys 1-7: Change image pattern"},
-            {"SPACE: Toggle NTSC/PAL"},
-            {"ESC: Exit"},
-            {"HELP: Toggle help visibility"},
-        };
-        
-        int helpLineCount = 8;
-        int startY = 35;
-        int positionX = 20;
-        int lineSpacing = 10;
-
-        for (int i=0;i<helpLineCount;i++)
+    dbgInfo->lineMode = PATTERN_IMAGE;
+
+    for (int i = Globals.sweeping ? 2 : 0; i < Globals.image.colorCount; i++)
+    {
+        Globals.r[i] = Globals.image.colors[i] >> 8;
+        Globals.g[i] = (Globals.image.colors[i] >> 4) & 0xF;
+        Globals.b[i] = Globals.image.colors[i] & 0xF;
+    }
+    dbgInfo->colorOrTextChanged = TRUE;
+}
+
+// Back to taking requests. Wait() may have taken the port signal for a
+// line that came in while the reply was pending, so it is raised again and
+// the main loop looks for that line before sleeping.
+void finishRemoteReply()
+{
+    ULONG mask = RemoteSignalMask();
+
+    Globals.remoteReply = REMOTE_IDLE;
+    SetSignal(mask, mask);
+}
+
+void replyRemoteError(const char* pReason)
+{
+    char reply[PROTOCOL_LINE_MAX];
+    ProtocolReplyError(reply, pReason);
+    RemoteReply(reply);
+    finishRemoteReply();
+}
+
+// What the HUD shows, for STATE
+void replyRemoteState(const struct DebugInfo* dbgInfo)
+{
+    char reply[PROTOCOL_LINE_MAX];
+    char pattern[16];
+
+    ProtocolReplyOk(reply, g_vblankTicks.frames);
+    ProtocolAdd(reply, "width", dbgInfo->width);
+    ProtocolAdd(reply, "height", dbgInfo->height);
+    ProtocolFormatPattern(pattern, dbgInfo->lineMode, Globals.noiseSeed);
+    ProtocolAddText(reply, "pattern", pattern);
+    ProtocolAdd(reply, "coverage", PatternCoverage(dbgInfo->lineMode, PATTERN_MAX_DEPTH, dbgInfo->width, dbgInfo->height));
+    ProtocolAddHex(reply, "c0", (UWORD)(getColorPair() >> 12));
+    ProtocolAddHex(reply, "c1", (UWORD)(getColorPair() & 0xFFF));
+    ProtocolAdd(reply, "bands", Globals.bands ? Globals.bandRowsBuilt : 0);
+    ProtocolAdd(reply, "sweep", Globals.sweeping);
+    ProtocolAdd(reply, "order", Globals.sweep.order);
+    ProtocolAdd(reply, "hold", Globals.sweep.holdFrames);
+    ProtocolAdd(reply, "step", Globals.sweeping ? g_colorSequence.step : Globals.sweep.step);
+    ProtocolAdd(reply, "cycle", Globals.cycling);
+    ProtocolAdd(reply, "scroll", Globals.scrolling);
+    ProtocolAdd(reply, "stress", StressLoads());
+    RemoteReply(reply);
+}
+
+// Swap and frame counters, and min/avg/max lines of every profiled phase
+void replyRemoteTiming()
+{
+    char reply[PROTOCOL_LINE_MAX];
+
+    ProtocolReplyOk(reply, g_vblankTicks.frames);
+    ProtocolAdd(reply, "swaps", g_copper.swaps);
+    ProtocolAdd(reply, "lateswaps", g_copper.lateSwaps);
+    ProtocolAdd(reply, "lateapplies", g_displayMailbox.lateApplies);
+    ProtocolAdd(reply, "lateframes", g_colorSequence.lateFrames);
+
+    for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++)
+    {
+        struct ProfileSummary summary;
+        char key[16];
+        char lines[40];
+
+        ProfileSummarize(phase, &summary);
+        const char* pName = ProfilePhaseName(phase);
+        int i;
+        for (i = 0; pName[i] != '\0' && i < sizeof(key) - 1; i++)
+        {
+            key[i] = (pName[i] >= 'A' && pName[i] <= 'Z') ? pName[i] - 'A' + 'a' : pName[i];
+        }
+        key[i] = '\0';
+
+        sprintf(lines, "%lu/%lu/%lu", summary.min, summary.avg, summary.max);
+        ProtocolAddText(reply, key, lines);
+    }
+    RemoteReply(reply);
+}
+
+// Carry out a remote request the way its keys would. Requests that change
+// the display are answered by answerRemote() once the change is on screen.
+void runRemoteRequest(const struct ProtocolLine* pLine, struct DebugInfo* dbgInfo, BOOL* pChangeDisplay, BOOL* pRebuildBands)
+{
+    struct ProtocolRequest request;
+    const char* pError;
+
+    Globals.remoteSince = g_vblankTicks.frames;
+    Globals.remoteReply = REMOTE_WHEN_SHOWN;
+    if (!ProtocolParse(pLine, &request, &pError))
+    {
+        replyRemoteError(pError);
+        return;
+    }
+
+    switch (request.verb)
+    {
+        case PROTOCOL_PING:
+        {
+            char reply[PROTOCOL_LINE_MAX];
+            ProtocolReplyOk(reply, g_vblankTicks.frames);
+            RemoteReply(reply);
+            Globals.remoteReply = REMOTE_IDLE;
+            break;
+        }
+
+        case PROTOCOL_STATE:
+            replyRemoteState(dbgInfo);
+            Globals.remoteReply = REMOTE_IDLE;
+            break;
+
+        case PROTOCOL_TIMING:
+            replyRemoteTiming();
+            Globals.remoteReply = REMOTE_IDLE;
+            break;
+
+        case PROTOCOL_MODE:
+            dbgInfo->hires = request.width == 640;
+            dbgInfo->interlaced = request.height > 256;
+            dbgInfo->pal = request.height == 256 || request.height == 512;
+            *pChangeDisplay = TRUE;
+            break;
+
+        case PROTOCOL_PATTERN:
+            if (request.lineMode == PATTERN_IMAGE)
+            {
+                if (Globals.imagePath == NULL)
+                {
+                    replyRemoteError("no image");
+                    return;
+                }
+                selectImage(dbgInfo);
+            }
+            dbgInfo->lineMode = request.lineMode;
+            if (request.lineMode == PATTERN_NOISE)
+            {
+                Globals.noiseSeed = request.seed;
+            }
+            if (PatternOrder(request.lineMode) != 0)
+            {
+                Globals.deBruijnOrder = PatternOrder(request.lineMode);
+            }
+            *pChangeDisplay = TRUE;
+            break;
+
+        case PROTOCOL_COLORS:
+        case PROTOCOL_COLOR:
+        {
+            int index = request.verb == PROTOCOL_COLOR ? request.index : 0;
+
+            // the sweep owns colors 0 and 1; 2-15 are posted as usual and
+            // answered once applied
+            if (Globals.sweeping && index < 2)
+            {
+                replyRemoteError("sweeping");
+                return;
+            }
+
+            int count = request.verb == PROTOCOL_COLORS ? 2 : 1;
+            for (int i = 0; i < count; i++)
+            {
+                Globals.r[index + i] = request.colors[i] >> 8;
+                Globals.g[index + i] = (request.colors[i] >> 4) & 0xF;
+                Globals.b[index + i] = request.colors[i] & 0xF;
+            }
+            dbgInfo->colorOrTextChanged = TRUE;
+            break;
+        }
+
+        case PROTOCOL_SWEEP:
+            // as S does, from the given place
+            if (Globals.cycling)
+            {
+                stopCycle();
+            }
+            if (Globals.bands)
+            {
+                Globals.bands = FALSE;
+                *pRebuildBands = TRUE;
+            }
+            Globals.sweep.order = request.order;
+            Globals.sweep.holdFrames = request.holdFrames;
+            Globals.sweep.step = request.step;
+            startSweep();
+            break;
+
+        case PROTOCOL_STOP:
+            if (Globals.sweeping)
+            {
+                stopSweep();
+            }
+            if (Globals.cycling)
+            {
+                stopCycle();
+            }
+            break;
+
+        case PROTOCOL_KEY:
+            Globals.remoteKey = request.key;
+            break;
+
+        case PROTOCOL_WAIT:
+            Globals.remoteReply = REMOTE_AFTER_WAIT;
+            Globals.remoteWaitFrame = Globals.remoteSince + request.frames;
+            break;
+    }
+}
+
+// A KEY request's key, once
+int takeRemoteKey()
+{
+    int key = Globals.remoteKey;
+    Globals.remoteKey = -1;
+    return key;
+}
+
+// Answer the request being run if its change is on screen or its WAIT is
+// over. On exit whatever is left is answered at once.
+void answerRemote(BOOL exiting)
+{
+    char reply[PROTOCOL_LINE_MAX];
+
+    if (Globals.remoteReply == REMOTE_IDLE)
+    {
+        return;
+    }
+
+    if (exiting)
+    {
+        ProtocolReplyOk(reply, g_vblankTicks.frames);
+    }
+    else if (Globals.remoteReply == REMOTE_WHEN_SHOWN)
+    {
+        ProtocolReplyOk(reply, DisplayWaitShown(Globals.remoteSince));
+    }
+    else if (g_vblankTicks.frames >= Globals.remoteWaitFrame)
+    {
+        ProtocolReplyOk(reply, g_vblankTicks.frames);
+    }
+    else
+    {
+        return;
+    }
+
+    RemoteReply(reply);
+    finishRemoteReply();
+}
+
+// Update the HUD fields; only the ones whose value changed get redrawn.
+// Counters can outgrow a field, so text is cut at HUD_FIELD_CHARS.
+void DrawDebugInfo(struct DebugInfo* dbgInfo)
+{
+    char* pText;
+
+    ULONG videoKey = ((ULONG)dbgInfo->width << 16) | (dbgInfo->height << 2) | (dbgInfo->pal << 1) | dbgInfo->interlaced;
+    if ((pText = HudFieldText(HUD_VIDEO, videoKey)) != NULL)
+    {
+        snprintf(pText, HUD_FIELD_CHARS, "%s %dx%d I:%d", dbgInfo->pal ? "PAL" : "NTSC", dbgInfo->width, dbgInfo->height, dbgInfo->interlaced);
+    }
+
+    // A De Bruijn sequence too long for the display shows only part of it
+    int coverage = PatternCoverage(dbgInfo->lineMode, PATTERN_MAX_DEPTH, dbgInfo->width, dbgInfo->height);
+    ULONG patternKey = ((ULONG)dbgInfo->lineMode << 24) ^ (dbgInfo->lineMode == PATTERN_NOISE ? Globals.noiseSeed : (ULONG)coverage);
+    if ((pText = HudFieldText(HUD_PATTERN, patternKey)) != NULL)
+    {
+        PatternLabel(pText, dbgInfo->lineMode, Globals.noiseSeed);
+        if (coverage < 100)
+        {
+            int length = strlen(pText);
+            snprintf(pText + length, HUD_FIELD_CHARS - length, " %d%%", coverage);
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        ULONG colorKey = (Globals.r[i] << 8) | (Globals.g[i] << 4) | Globals.b[i];
+        if ((pText = HudFieldText(HUD_COLOR0 + i, colorKey)) != NULL)
+        {
+            snprintf(pText, HUD_FIELD_CHARS, "C%d(R:%x G:%x B:%x)", i, Globals.r[i], Globals.g[i], Globals.b[i]);
+        }
+    }
+
+    int e = Globals.editColor;
+    ULONG editKey = ((ULONG)e << 12) | (Globals.r[e] << 8) | (Globals.g[e] << 4) | Globals.b[e];
+    if ((pText = HudFieldText(HUD_PALETTE, editKey)) != NULL)
+    {
+        snprintf(pText, HUD_FIELD_CHARS, "E%d(R:%x G:%x B:%x)", e, Globals.r[e], Globals.g[e], Globals.b[e]);
+    }
+
+    ULONG scrollKey = Globals.scrolling ? 0x10000 | ((g_scrollMotion.dx & 0xFF) << 8) | (g_scrollMotion.dy & 0xFF) : 0;
+    if ((pText = HudFieldText(HUD_SCROLL, scrollKey)) != NULL)
+    {
+        if (Globals.scrolling)
+            snprintf(pText, HUD_FIELD_CHARS, "Scroll X:%d Y:%d", g_scrollMotion.dx, g_scrollMotion.dy);
+        else
+            pText[0] = '\0';
+    }
+
+    // The counters only go up, so their sum changes whenever one does
+    ULONG cacheKey = g_patternCacheStats.hits + g_patternCacheStats.misses + g_patternCacheStats.evictions;
+    if ((pText = HudFieldText(HUD_CACHE, cacheKey)) != NULL)
+    {
+        snprintf(pText, HUD_FIELD_CHARS, "Cache H:%lu M:%lu E:%lu",
+                    g_patternCacheStats.hits,
+                    g_patternCacheStats.misses,
+                    g_patternCacheStats.evictions);
+    }
+
+    // Band n shows the pair n after the first, so first and last say it all
+    if ((pText = HudFieldText(HUD_BANDS, Globals.bands ? Globals.bandBuilds : 0)) != NULL)
+    {
+        if (Globals.bands)
+        {
+            ULONG first = getColorPair();
+            ULONG last = (first + Globals.bandCount - 1) & 0xFFFFFF;
+            snprintf(pText, HUD_FIELD_CHARS, "Bands %d rows: %03lx/%03lx to %03lx/%03lx",
+                        Globals.bandRowsBuilt,
+                        first >> 12, first & 0xFFF,
+                        last >> 12, last & 0xFFF);
+        }
+        else
+        {
+            pText[0] = '\0';
+        }
+    }
+
+    // The cycle shares the server's color sequence with the sweep, and its
+    // field. It steps too fast to follow, so only the late frames are shown.
+    if (Globals.cycling)
+    {
+        ULONG cycleKey = 0x80000000 | (Globals.cycleChanges << 16) | (g_colorSequence.lateFrames & 0xFFFF);
+        if ((pText = HudFieldText(HUD_SWEEP, cycleKey)) != NULL)
         {
-            rp->cp_x = positionX;
-            rp->cp_y = startY + (i * lineSpacing);
-            Text(rp, helpLines[i], strlen(helpLines[i]));
+            snprintf(pText, HUD_FIELD_CHARS, "Cycle %s %d x%u late:%lu",
+                        CycleKindName(Globals.cycleKind),
+                        Globals.cycleSteps,
+                        Globals.cycleHold,
+                        g_colorSequence.lateFrames);
         }
     }
+
+    ULONG sweepStep = Globals.sweeping ? g_colorSequence.step : Globals.sweep.step;
+    if (!Globals.cycling && (pText = HudFieldText(HUD_SWEEP, sweepStep ^ (Globals.sweepChanges << 24))) != NULL)
+    {
+        snprintf(pText, HUD_FIELD_CHARS, "Sweep %s %lu/%lu x%u%s",
+                    SweepOrderName(Globals.sweep.order),
+                    sweepStep,
+                    SWEEP_STEPS,
+                    Globals.sweep.holdFrames,
+                    Globals.sweeping ? " on" : "");
+    }
+
+    // The counts are averaged over a few frames, so only redrawn that often
+    UWORD loads = StressLoads();
+    if ((pText = HudFieldText(HUD_STRESS, (g_stressStats.updates << 3) | loads)) != NULL)
+    {
+        struct StressBusLoad busLoad;
+        StressGetBusLoad(dbgInfo->hires, dbgInfo->pal, dbgInfo->interlaced ? dbgInfo->height / 2 : dbgInfo->height, &busLoad);
+        snprintf(pText, HUD_FIELD_CHARS, "Stress %c%c%c bus:%u%% blit:%u%% cpu:%u%%",
+                    (loads & STRESS_FLAG(STRESS_BLITTER)) ? 'B' : '-',
+                    (loads & STRESS_FLAG(STRESS_SPRITES)) ? 'S' : '-',
+                    (loads & STRESS_FLAG(STRESS_CPU)) ? 'C' : '-',
+                    busLoad.total,
+                    busLoad.blitter,
+                    busLoad.cpu);
+    }
+
+    // A new sample or another phase
+    struct ProfileSummary summary;
+    ProfileSummarize(Globals.profilePhase, &summary);
+    if ((pText = HudFieldText(HUD_PROFILE, ((ULONG)Globals.profilePhase << 28) ^ summary.samples)) != NULL)
+    {
+        snprintf(pText, HUD_FIELD_CHARS, "Lines %s min:%lu avg:%lu max:%lu",
+                    ProfilePhaseName(Globals.profilePhase),
+                    summary.min,
+                    summary.avg,
+                    summary.max);
+    }
+
+    HudRender();
 }
 
 int openstuff()
@@ -585,21 +959,22 @@ int openstuff()
         printf("graphics open failed.\n");
         die();
     }
-    
-    DiskfontBase = OpenLibrary("diskfont.library", 0L);
 
-    KeyIO = AllocMem(sizeof(struct IOStdReq), MEMF_CLEAR);
+    if (!InputInit())
+    {
+        printf("input.device handler could not be added.\n");
+        die();
+    }
 
-    if (!OpenDevice("keyboard.device", 0, (struct IORequest*)KeyIO, 0))
+    // The color keys step while held
+    static const UBYTE colorKeys[] = { 0x52, 0x53, 0x54, 0x57, 0x58, 0x59, 0x13, 0x24, 0x35 };
+    for (int i = 0; i < sizeof(colorKeys); i++)
     {
-        if (KeyIO != NULL)
-        {
-            keyMatrix = AllocMem(MATRIX_SIZE, MEMF_CHIP|MEMF_CLEAR);
-            KeyIO->io_Command = KBD_READMATRIX;
-            KeyIO->io_Data = (APTR)keyMatrix;
-            KeyIO->io_Length = MATRIX_SIZE;
-        }
+        InputSetRepeat(colorKeys[i], TRUE);
     }
+
+    // Holding N shows a new noise bitmap every few frames
+    InputSetRepeat(0x36, TRUE);
     
     return 1;
 }
@@ -611,22 +986,8 @@ closestuff()
         CloseLibrary (GfxBase);
     }
     
-    if (DiskfontBase)
-    {
-        CloseLibrary(DiskfontBase);
-    }
-    
-    if (keyMatrix != NULL)
-    {
-        CloseDevice((struct IORequest*)KeyIO);
-        FreeMem(keyMatrix, MATRIX_SIZE);
-    }
-
-    if (KeyIO != NULL)
-    {
-        FreeMem(KeyIO, sizeof(struct IOStdReq));
-        KeyIO = NULL;
-    }
+    InputCleanup();
+    RemoteCleanup();
 }
 
 die()
@@ -635,18 +996,100 @@ die()
     exit(-1);
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
     SysBase = *((struct Library**)0x00000004);
 
     printf("Sparkler V1.0 by Bloodmosher\n");
 
-    int copperListSize = 2000;
-    g_pCopperList = (UWORD*)AllocMem(copperListSize, MEMF_CHIP|MEMF_CLEAR);
-    g_pCopperList2 = (UWORD*)AllocMem(copperListSize, MEMF_CHIP|MEMF_CLEAR);
+    // Measure the largest (interlaced PAL, a band on every line) list to
+    // size both allocations
+    struct CopperList measure;
+    struct CopperDisplay largest = { 0 };
+    largest.interlaced = TRUE;
+    largest.pal = TRUE;
+    largest.bandRows = 2;
+    largest.bandCount = BAND_MAX;
+    largest.bandColors = g_bandColors;
+    CopperInit(&measure, NULL, 0);
+    CopperBuild(&measure, &largest);
+    ULONG listBytes = ARENA_ROUND(COPPER_LIST_BYTES(&measure));
+
+    // Room for two of the largest bitmaps, so one can be built while the
+    // other is on screen, or just one if chip RAM is short
+    ULONG fixedBytes = (listBytes * 2) + ARENA_ROUND(HUD_PLANE_BYTES);
+    ULONG bitmapBytes = PatternCacheBitmapBytes(PATTERN_CACHE_MAX_WIDTH, PATTERN_CACHE_MAX_HEIGHT);
+    if (!ArenaInit(fixedBytes, bitmapBytes * 2) && !ArenaInit(fixedBytes, bitmapBytes))
+    {
+        printf("Not enough chip memory\n");
+        return 20;
+    }
+
+    if (!VBlankInit(listBytes))
+    {
+        printf("Could not set up the copper lists\n");
+        ArenaCleanup();
+        return 20;
+    }
+
+    g_pHudPlane = (UBYTE*)ArenaAllocFixed(HUD_PLANE_BYTES);
+
+    HudInit(g_pHudPlane);
 
     openstuff();
 
+    // The first bitmap shown, built before the display is taken over so
+    // there is nothing to undo if it doesn't fit
+    struct PatternCacheEntry* pEntry = PatternCacheGet(320, 200, 1, 0);
+    if (pEntry == NULL)
+    {
+        printf("Not enough chip memory for the first bitmap\n");
+        VBlankCleanup();
+        ArenaCleanup();
+        closestuff();
+        return 20;
+    }
+    g_pBitmap = pEntry->bitmap;
+
+    StressInit();
+
+    // "Sparkler REMOTE [baud]" takes requests on the serial port,
+    // "Sparkler IMAGE <file>" starts on an image and "Sparkler REPEAT
+    // <delay> <rate>" sets the color key auto-repeat in frames, in any order
+    Globals.remoteKey = -1;
+    Globals.imagePath = NULL;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "REMOTE") == 0 || strcmp(argv[arg], "remote") == 0)
+        {
+            ULONG baud = PROTOCOL_BAUD;
+            if (arg + 1 < argc && argv[arg + 1][0] >= '0' && argv[arg + 1][0] <= '9')
+            {
+                baud = strtoul(argv[++arg], NULL, 10);
+            }
+
+            Globals.remote = RemoteInit(baud);
+            if (!Globals.remote)
+            {
+                printf("serial.device could not be opened, no remote control\n");
+            }
+        }
+        else if ((strcmp(argv[arg], "IMAGE") == 0 || strcmp(argv[arg], "image") == 0) && arg + 1 < argc)
+        {
+            openImage(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "REPEAT") == 0 || strcmp(argv[arg], "repeat") == 0) && arg + 2 < argc)
+        {
+            UWORD delay = (UWORD)strtoul(argv[++arg], NULL, 10);
+            UWORD rate = (UWORD)strtoul(argv[++arg], NULL, 10);
+            InputSetRepeatTiming(delay, rate);
+        }
+        else
+        {
+            printf("Unknown argument %s\n", argv[arg]);
+        }
+    }
+
     struct View* oldView = GfxBase->ActiView;
     LoadView(NULL);
     WaitTOF();
@@ -663,9 +1106,38 @@ int main(void)
     Globals.r[1] = 0xf;
     Globals.g[1] = 0xb;
     Globals.b[1] = 0xf;
+
+    Globals.bands = FALSE;
+    Globals.bandRows = 4;
+
+    Globals.deBruijnOrder = 3;
+    Globals.editColor = 2;
+    Globals.noiseSeed = 1;
+
+    Globals.cycling = FALSE;
+    Globals.cycleKind = CYCLE_FLIP;
+    Globals.cycleHold = CYCLE_HOLD_FRAMES;
+
+    Globals.profilePhase = PROFILE_SETUP;
+
+    Globals.scrolling = FALSE;
+    g_scrollMotion.dx = 1;
+    g_scrollMotion.dy = 0;
+
+    // Pick up an interrupted sweep where it stopped
+    SweepInit();
+    Globals.sweeping = FALSE;
+    if (!SweepLoadCheckpoint(&Globals.sweep))
+    {
+        Globals.sweep.order = SWEEP_GRAY;
+        Globals.sweep.holdFrames = SWEEP_HOLD_FRAMES;
+        Globals.sweep.step = 0;
+    }
     
     BOOL changeDisplay = TRUE;
 
+    initDisplayState();
+
     struct DebugInfo dbgInfo;
     dbgInfo.width = 640;
     dbgInfo.height = 200;
@@ -676,24 +1148,22 @@ int main(void)
     dbgInfo.showhelp = TRUE;
     dbgInfo.pal = FALSE;
 
-    createBitmap(320, 200, 1);
-
-    InitRastPort(&g_rp);
-
-    SetAPen(&g_rp, 255L);
-    SetBPen(&g_rp, 0L);
-    SetDrMd(&g_rp, JAM2);
-
-    struct TextAttr textattr1 = { "helvetica.font", 11, 0, NULL };
-
-    dbgInfo.pFont1 = OpenDiskFont(&textattr1);
-    
-    if (dbgInfo.pFont1)
+    if (Globals.imagePath != NULL)
     {
-        SetFont(&g_rp, dbgInfo.pFont1);
+        selectImage(&dbgInfo);
     }
 
+    int displayWidth = 320;
+    int displayHeight = 200;
+
+    HudLayout(displayWidth, dbgInfo.showhelp);
+    int hudWidth = displayWidth;
+    BOOL layoutHud = FALSE;
+    BOOL rebuildBands = FALSE;
+
     setupDisplay(FALSE, FALSE, FALSE);
+
+    struct ShownPattern shown = { FALSE, FALSE, FALSE, 1, Globals.noiseSeed, Globals.deBruijnOrder };
     
     if (((struct ExecBase*)SysBase)->VBlankFrequency == 50)
     {
@@ -704,190 +1174,471 @@ int main(void)
         dbgInfo.pal = FALSE;
     }
 
-    int count = 0;
-
-    while(TRUE) 
-    {
-        ReadKeyboard();
-
-        if (GetKeyState(0x057)) // F8 "r"
-        { 
-            ChangeColorValue(&Globals.r[1], &dbgInfo.colorOrTextChanged);
-        }
+    // Build the rest of the startup resolution up front if chip RAM allows
+    PatternCachePrefill(640, dbgInfo.pal ? 256 : 200);
 
-        if (GetKeyState(0x058)) // F9 "g"
-        { 
-            ChangeColorValue(&Globals.g[1], &dbgInfo.colorOrTextChanged);
-        }
+    BOOL running = TRUE;
 
-        if (GetKeyState(0x059)) // F10 "b"
+    while (running) 
+    {
+        // One request at a time, so each answer can tell the frame its
+        // change first showed on
+        const struct ProtocolLine* pLine;
+        while (Globals.remote && Globals.remoteReply == REMOTE_IDLE && (pLine = RemoteNextLine()) != NULL)
         {
-            ChangeColorValue(&Globals.b[1], &dbgInfo.colorOrTextChanged);
-        }
-
-        if (GetKeyState(0x052)) // F3 "r"
-        { 
-            ChangeColorValue(&Globals.r[0], &dbgInfo.colorOrTextChanged);
-        }
-
-        if (GetKeyState(0x053)) // F4 "g"
-        { 
-            ChangeColorValue(&Globals.g[0], &dbgInfo.colorOrTextChanged);
-        }
-
-        if (GetKeyState(0x054)) // F5 "b"
-        { 
-            ChangeColorValue(&Globals.b[0], &dbgInfo.colorOrTextChanged);
-        }
-
-        if (GetKeyState(0x050)) // F1
-        { 
-            dbgInfo.hires = !dbgInfo.hires;
-            changeDisplay = TRUE;
+            runRemoteRequest(pLine, &dbgInfo, &changeDisplay, &rebuildBands);
         }
 
-        if (GetKeyState(0x051)) // F2
-        { 
-            dbgInfo.interlaced = !dbgInfo.interlaced;
-            changeDisplay = TRUE;
-        }
-
-        if (GetKeyState(0x01)) 
+        int key;
+        while ((key = InputNextKey(g_vblankTicks.frames)) != -1 || (key = takeRemoteKey()) != -1)
         {
-            dbgInfo.lineMode = 1;
-            changeDisplay = TRUE;
-        }
+            switch (key)
+            {
+                case 0x57: // F8 "r"
+                    ChangeColorValue(&Globals.r[1], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x58: // F9 "g"
+                    ChangeColorValue(&Globals.g[1], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x59: // F10 "b"
+                    ChangeColorValue(&Globals.b[1], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x52: // F3 "r"
+                    ChangeColorValue(&Globals.r[0], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x53: // F4 "g"
+                    ChangeColorValue(&Globals.g[0], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x54: // F5 "b"
+                    ChangeColorValue(&Globals.b[0], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x17: // I - the image from the command line
+                    if (Globals.imagePath != NULL)
+                    {
+                        selectImage(&dbgInfo);
+                        changeDisplay = TRUE;
+                    }
+                    break;
+
+                case 0x36: // N - noise, a new seed every press after the first
+                    if (dbgInfo.lineMode == PATTERN_NOISE)
+                    {
+                        Globals.noiseSeed = PatternNextSeed(Globals.noiseSeed ^ g_vblankTicks.frames);
+                    }
+                    dbgInfo.lineMode = PATTERN_NOISE;
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x42: // TAB - next palette entry to edit, SHIFT for previous
+                    if (GetKeyState(0x60) || GetKeyState(0x61))
+                        Globals.editColor = (Globals.editColor + 15) & 15;
+                    else
+                        Globals.editColor = (Globals.editColor + 1) & 15;
+                    dbgInfo.colorOrTextChanged = TRUE;
+                    break;
+
+                case 0x13: // R
+                    ChangeColorValue(&Globals.r[Globals.editColor], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x24: // G
+                    ChangeColorValue(&Globals.g[Globals.editColor], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x35: // B
+                    ChangeColorValue(&Globals.b[Globals.editColor], &dbgInfo.colorOrTextChanged);
+                    break;
+
+                case 0x37: // M - start or stop hardware scrolling
+                    Globals.scrolling = !Globals.scrolling;
+                    g_scrollMotion.x = 0;
+                    g_scrollMotion.y = 0;
+
+                    // the scrolling lists have no bands
+                    Globals.bands = FALSE;
+                    rebuildBands = TRUE;
+                    break;
+
+                case 0x4E: // cursor right - scroll faster to the left
+                case 0x4F: // cursor left
+                    ChangeScrollSpeed(&g_scrollMotion.dx, key == 0x4E ? 1 : -1);
+                    break;
+
+                case 0x4C: // cursor up - scroll faster upwards
+                case 0x4D: // cursor down
+                    ChangeScrollSpeed(&g_scrollMotion.dy, key == 0x4C ? 1 : -1);
+                    break;
+
+                case 0x33: // C - start or stop color cycling
+                    if (Globals.cycling)
+                    {
+                        stopCycle();
+                    }
+                    else
+                    {
+                        // the cycle drives the whole palette
+                        if (Globals.sweeping)
+                        {
+                            stopSweep();
+                        }
+                        if (Globals.bands)
+                        {
+                            Globals.bands = FALSE;
+                            rebuildBands = TRUE;
+                        }
+                        startCycle(0);
+                    }
+                    break;
+
+                case 0x34: // V - next cycle kind, starting over
+                    Globals.cycleKind = (Globals.cycleKind + 1) % CYCLE_KIND_COUNT;
+                    if (Globals.cycling)
+                        startCycle(0);
+                    else
+                        Globals.cycleChanges++;
+                    break;
+
+                case 0x25: // H - frames per cycle step, 1 to CYCLE_MAX_HOLD_FRAMES
+                    Globals.cycleHold = Globals.cycleHold < CYCLE_MAX_HOLD_FRAMES ? Globals.cycleHold * 2 : 1;
+                    if (Globals.cycling)
+                        startCycle(g_colorSequence.step);
+                    else
+                        Globals.cycleChanges++;
+                    break;
+
+                case 0x10: // Q - blitter stress on or off
+                case 0x11: // W - sprites
+                case 0x12: // E - CPU
+                {
+                    int load = key == 0x10 ? STRESS_BLITTER : key == 0x11 ? STRESS_SPRITES : STRESS_CPU;
 
-        if (GetKeyState(0x02)) 
-        {
-            dbgInfo.lineMode = 2;
-            changeDisplay = TRUE;
-        }
-        
-        if (GetKeyState(0x03)) 
-        {
-            dbgInfo.lineMode = 3;
-            changeDisplay = TRUE;
-        }
+                    // Out of chip RAM leaves it off, as the HUD shows
+                    StressSet(load, (StressLoads() & STRESS_FLAG(load)) == 0);
+                    break;
+                }
 
-        if (GetKeyState(0x04)) 
-        {
-            dbgInfo.lineMode = 4;
-            changeDisplay = TRUE;
+                case 0x19: // P - next profiled phase in the HUD
+                    Globals.profilePhase = (Globals.profilePhase + 1) % PROFILE_PHASE_COUNT;
+                    break;
+
+                case 0x55: // F6
+                    if (!Globals.sweeping && !Globals.scrolling && !Globals.cycling)
+                    {
+                        Globals.bands = !Globals.bands;
+                        rebuildBands = TRUE;
+                    }
+                    break;
+
+                case 0x21: // S - start or stop the sweep
+                    if (Globals.sweeping)
+                    {
+                        stopSweep();
+                    }
+                    else
+                    {
+                        // the sweep drives colors 0 and 1 for the whole screen
+                        if (Globals.cycling)
+                        {
+                            stopCycle();
+                        }
+                        if (Globals.bands)
+                        {
+                            Globals.bands = FALSE;
+                            rebuildBands = TRUE;
+                        }
+                        startSweep();
+                    }
+                    break;
+
+                case 0x18: // O - sweep order, starting over
+                    if (!Globals.sweeping)
+                    {
+                        Globals.sweep.order = (Globals.sweep.order + 1) % SWEEP_ORDER_COUNT;
+                        Globals.sweep.step = 0;
+                        Globals.sweepChanges++;
+                    }
+                    break;
+
+                case 0x0B: // - fewer frames per sweep step
+                case 0x0C: // = more
+                    if (key == 0x0C && Globals.sweep.holdFrames < SWEEP_MAX_HOLD_FRAMES)
+                        Globals.sweep.holdFrames *= 2;
+                    else if (key == 0x0B && Globals.sweep.holdFrames > 1)
+                        Globals.sweep.holdFrames /= 2;
+
+                    if (Globals.sweeping)
+                    {
+                        Globals.sweep.step = g_colorSequence.step;
+                        startSweep();
+                    }
+                    Globals.sweepChanges++;
+                    break;
+
+                case 0x56: // F7 - band height 1, 2, 4, 8 or 16 rows
+                    Globals.bandRows = Globals.bandRows < 16 ? Globals.bandRows * 2 : 1;
+                    rebuildBands = Globals.bands;
+                    break;
+
+                case 0x1A: // [ - previous page of bands
+                case 0x1B: // ] - next page
+                    if (Globals.bands)
+                    {
+                        LONG step = key == 0x1B ? Globals.bandCount : -(LONG)Globals.bandCount;
+                        setColorPair((getColorPair() + step) & 0xFFFFFF);
+                        dbgInfo.colorOrTextChanged = TRUE;
+                    }
+                    break;
+
+                case 0x50: // F1
+                    dbgInfo.hires = !dbgInfo.hires;
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x51: // F2
+                    dbgInfo.interlaced = !dbgInfo.interlaced;
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x01: // number keys 1-7
+                case 0x02:
+                case 0x03:
+                case 0x04:
+                case 0x05:
+                case 0x06:
+                case 0x07:
+                    dbgInfo.lineMode = key;
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x08: // 8 - De Bruijn pattern
+                    dbgInfo.lineMode = PATTERN_DEBRUIJN(Globals.deBruijnOrder);
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x09: // 9 - next De Bruijn order
+                    Globals.deBruijnOrder = Globals.deBruijnOrder < PATTERN_DEBRUIJN_MAX_ORDER ? Globals.deBruijnOrder + 1 : PATTERN_DEBRUIJN_MIN_ORDER;
+                    dbgInfo.lineMode = PATTERN_DEBRUIJN(Globals.deBruijnOrder);
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x0A: // 0 - next multi-plane pattern
+                    dbgInfo.lineMode = PatternMulti(dbgInfo.lineMode) < PATTERN_MULTI_COUNT ? PATTERN_MULTI(PatternMulti(dbgInfo.lineMode) + 1) : PATTERN_MULTI(1);
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x40: // SPACE
+                    dbgInfo.pal = !dbgInfo.pal;
+                    changeDisplay = TRUE;
+                    break;
+
+                case 0x5F: // HELP
+                    dbgInfo.showhelp = !dbgInfo.showhelp;
+                    layoutHud = TRUE;
+                    break;
+
+                case 0x45: // ESC - exit
+                case KEY_MOUSE_LEFT: // exit it on mouse click
+                    running = FALSE;
+                    break;
+            }
         }
 
-        if (GetKeyState(0x05)) 
+        if (!running)
         {
-            dbgInfo.lineMode = 5;
-            changeDisplay = TRUE;
+            break;
         }
 
-        if (GetKeyState(0x06)) 
-        {
-            dbgInfo.lineMode = 6;
-            changeDisplay = TRUE;
-        }
-        
-        if (GetKeyState(0x07)) 
+        if (Globals.sweeping)
         {
-            dbgInfo.lineMode = 7;
-            changeDisplay = TRUE;
-        }
+            // The server moves colors 0 and 1 on its own; follow it
+            setColorPair(g_colorSequence.pair);
 
-        if (GetKeyState(0x40)) 
-        {
-            dbgInfo.pal = !dbgInfo.pal;
-            changeDisplay = TRUE;
+            if (g_colorSequence.finished)
+            {
+                stopSweep();
+            }
+            else if (g_vblankTicks.frames - Globals.sweepSavedFrame >= SWEEP_CHECKPOINT_FRAMES)
+            {
+                saveSweep();
+            }
         }
 
-        if (GetKeyState(0x5F)) 
+        // While a sweep runs the server puts its pair back over the posted
+        // colors 0 and 1, so only edits to 2-15 show
+        if (dbgInfo.colorOrTextChanged)
         {
-            dbgInfo.showhelp = !dbgInfo.showhelp;
-            
-            if (dbgInfo.showhelp)
+            // Band colors all follow from C0 and C1, so they need new lists
+            if (Globals.bands)
             {
-                dbgInfo.colorOrTextChanged = TRUE;
+                rebuildBands = TRUE;
             }
             else
             {
-                changeDisplay = TRUE;
+                setCopperColors();
             }
-        }
-
-        if (GetKeyState(0x45)) // ESC - exit
-        { 
-            break;
-        }
-
-        if (dbgInfo.colorOrTextChanged && !changeDisplay)
-        {
-            WaitTOF();
-            int offset = 1; // color00, (write to value)
-
-            g_pCopperList[Globals.copperList1ColorStartIndex + offset] = (UWORD)((Globals.r[0] << 8) | (Globals.g[0] << 4) | Globals.b[0]);
-            g_pCopperList2[Globals.copperList2ColorStartIndex + offset] = (UWORD)((Globals.r[0] << 8) | (Globals.g[0] << 4) | Globals.b[0]);
-
-            offset = 3; // color00, value, color1 (2 bytes each), and now write to value (3 because this is a UWORD*)
-
-            g_pCopperList[Globals.copperList1ColorStartIndex + offset] = (UWORD)((Globals.r[1] << 8) | (Globals.g[1] << 4) | Globals.b[1]);
-            g_pCopperList2[Globals.copperList2ColorStartIndex + offset] = (UWORD)((Globals.r[1] << 8) | (Globals.g[1] << 4) | Globals.b[1]);
-
-            g_rp.BitMap = g_pBitmap;
-
-            struct RastPort* rp = &g_rp;
-            DrawDebugInfo(rp, &dbgInfo);
 
+            // The cycle was built from the old palette
+            if (Globals.cycling)
+            {
+                startCycle(g_colorSequence.step);
+            }
             dbgInfo.colorOrTextChanged = FALSE;
-            Delay();
         }
 
         if (changeDisplay)
         {
-            WaitTOF();
-            freeBitmap();
+            // dbgInfo holds the mode and pattern asked for; they only stay
+            // if the bitmap for them can be had
+            int width;
+            int height;
             if (dbgInfo.hires)
             {
-                dbgInfo.width = 640;
+                width = 640;
             }
             else
             {
-                dbgInfo.width = 320;
+                width = 320;
             }
             
             if (dbgInfo.interlaced)
             {
                 if (dbgInfo.pal)
-                    dbgInfo.height = 512;
+                    height = 512;
                 else
-                    dbgInfo.height = 400;
+                    height = 400;
             }
             else
             {
                 if (dbgInfo.pal)
-                    dbgInfo.height = 256;
+                    height = 256;
                 else
-                    dbgInfo.height = 200;
+                    height = 200;
             }
             
-            createBitmap(dbgInfo.width, dbgInfo.height, dbgInfo.lineMode);
-            setupDisplay(dbgInfo.hires, dbgInfo.interlaced, dbgInfo.pal);
+            // The cache protects the bitmap on screen and the last one
+            // requested, so let any queued swap or posted bitplanes land
+            // before asking again; a noise bitmap is refilled in place
+            DisplayWaitShown(g_vblankTicks.frames);
+
+            ProfileBegin(PROFILE_PATTERN);
+            pEntry = PatternCacheGet(width, height, dbgInfo.lineMode, Globals.noiseSeed);
+            ProfileEnd(PROFILE_PATTERN);
+            if (pEntry != NULL)
+            {
+                g_pBitmap = pEntry->bitmap;
+                dbgInfo.width = width;
+                dbgInfo.height = height;
+
+                // The cache falls back to pattern 1 when it gave up the
+                // bitmap on screen and could not fill the new one
+                if (pEntry->lineMode != dbgInfo.lineMode)
+                {
+                    dbgInfo.lineMode = pEntry->lineMode;
+                    if (Globals.remoteReply == REMOTE_WHEN_SHOWN)
+                    {
+                        replyRemoteError("no bitmap");
+                    }
+                }
+                keepShownPattern(&shown, &dbgInfo);
+
+                // Width and height imply hires, interlace and PAL, so the same
+                // size only needs the bitplane pointers swapped
+                if (width == displayWidth && height == displayHeight)
+                {
+                    setBitplanePointers();
+                }
+                else
+                {
+                    setupDisplay(dbgInfo.hires, dbgInfo.interlaced, dbgInfo.pal);
+                    displayWidth = width;
+                    displayHeight = height;
+                    rebuildBands = FALSE;
+                }
+            }
+            else
+            {
+                // Out of chip RAM, or an image that can't be read, keeps the
+                // current mode and pattern on screen
+                restoreShownPattern(&shown, &dbgInfo);
+                if (Globals.remoteReply == REMOTE_WHEN_SHOWN)
+                {
+                    replyRemoteError("no bitmap");
+                }
+            }
             changeDisplay = FALSE;
+        }
+
+        // The overlay is laid out for the width on screen. Help shown or
+        // hidden only changes the height of its band.
+        if (layoutHud || hudWidth != displayWidth)
+        {
+            HudLayout(displayWidth, dbgInfo.showhelp);
+            hudWidth = displayWidth;
 
-            g_rp.BitMap = g_pBitmap;
-            struct RastPort* rp = &g_rp;
-            DrawDebugInfo(rp, &dbgInfo);
-            Delay();
+            // Band WAITs are in beam order with the HUD one, so moving it
+            // means new lists
+            if (Globals.bands)
+            {
+                rebuildBands = TRUE;
+            }
+            else
+            {
+                // 400 and 512 line displays are interlaced
+                setHud(displayHeight > 256);
+            }
+            layoutHud = FALSE;
         }
 
-        // exit it on mouse click
-        if ((ciaa.ciapra & CIAF_GAMEPORT0) == 0)
+        if (rebuildBands)
+        {
+            rebuildDisplay();
+            rebuildBands = FALSE;
+        }
+
+        ProfileBegin(PROFILE_HUD);
+        DrawDebugInfo(&dbgInfo);
+        ProfileEnd(PROFILE_HUD);
+
+        answerRemote(FALSE);
+
+        // Sleep until a key event or remote request arrives, or the next
+        // frame while a color key is held and may need to repeat, a sweep
+        // or cycle is running, the stress counts are coming in or a remote
+        // WAIT is counting down
+        VBlankEnableTicks(InputRepeatHeld() || Globals.sweeping || Globals.cycling || StressLoads() != 0 || Globals.remoteReply == REMOTE_AFTER_WAIT);
+        ProfileBegin(PROFILE_SLEEP);
+        ULONG signals = Wait(InputSignalMask() | RemoteSignalMask() | g_vblankTicks.signalMask | SIGBREAKF_CTRL_C);
+        ProfileEnd(PROFILE_SLEEP);
+
+        if (signals & SIGBREAKF_CTRL_C)
         {
             break;
         }
     }
 
+    answerRemote(TRUE);
+
+    if (Globals.sweeping)
+    {
+        stopSweep();
+    }
+    if (Globals.cycling)
+    {
+        stopCycle();
+    }
+    StressCleanup();
+    Globals.scrolling = FALSE;
+
     // Returning to the system seems happier if not in int erlaced mode
     setupDisplay(FALSE, FALSE, FALSE);
+    CopperWaitSwap();
+    VBlankCleanup();
 
     LoadView(oldView);
     WaitTOF();
@@ -897,17 +1648,17 @@ int main(void)
     custom.dmacon = g_oldRegs.dmacon | 0x8000;
     custom.intena = g_oldRegs.intena | 0x8000;
     
-    freeBitmap();
+    PatternCacheFlush();
 
-    if (dbgInfo.pFont1)
-    {
-        CloseFont(dbgInfo.pFont1);
-    }
+    // The system's copper list is running again
+    ArenaCleanup();
 
-    FreeMem(g_pCopperList, copperListSize);
-    FreeMem(g_pCopperList2, copperListSize);
-    
     RethinkDisplay();
+
+    if (!ProfileWriteLog(PROFILE_LOG_FILE))
+    {
+        printf("Could not write %s\n", PROFILE_LOG_FILE);
+    }
     closestuff();
     
     printf("\n");
@@ -0,0 +1,400 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Chip bus stress, see stress.h
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/exec.h>
+#include <exec/interrupts.h>
+#include <hardware/custom.h>
+#include <hardware/intbits.h>
+#include <hardware/dmabits.h>
+#include <hardware/blit.h>
+#include <graphics/gfxbase.h>
+#include <clib/alib_protos.h>
+
+#include "copper.h"
+#include "stress.h"
+
+extern struct Custom custom;
+extern struct GfxBase* GfxBase;
+
+// Every blit copies a block from the first half of the buffer to the second
+#define BLIT_WORDS 32
+#define BLIT_ROWS 128
+#define BLIT_BYTES (BLIT_WORDS * 2L * BLIT_ROWS)
+
+// Sprites from the top of the display down to the last line of a PAL field
+#define SPRITE_COUNT 8
+#define SPRITE_START COPPER_DISPLAY_TOP
+#define SPRITE_LINES 256
+#define SPRITE_WORDS (2 + (SPRITE_LINES * 2) + 2)
+#define SPRITE_BYTES (SPRITE_COUNT * SPRITE_WORDS * 2L)
+
+#define CPU_LONGS 1024
+#define CPU_BYTES (CPU_LONGS * 4L)
+#define CPU_STACK_BYTES 1024
+
+// Below the main task, so the hammering only takes time nothing else wants
+#define CPU_TASK_PRI (-1)
+
+// Bus slots in a line, those refresh always takes, and those the sprites
+// take on a line they are fetched on
+#define LINE_SLOTS 227
+#define REFRESH_SLOTS 4
+#define SPRITE_SLOTS (SPRITE_COUNT * 2)
+
+// Four planes of 20 or 40 words a line
+#define FETCH_SLOTS(hires) ((hires) ? 160 : 80)
+
+struct CpuTask
+{
+    struct Task task;
+    ULONG stack[CPU_STACK_BYTES / 4];
+};
+
+struct StressStats g_stressStats;
+
+static volatile UWORD loads = 0;
+
+static struct Interrupt vblankInterrupt;
+static BOOL serverAdded = FALSE;
+
+// Running counts, averaged by the server
+static volatile ULONG blitWords = 0;
+static volatile ULONG cpuWords = 0;
+
+static UBYTE* pBlitBuffer = NULL;
+static volatile BOOL blitRunning = FALSE;
+static struct Interrupt blitInterrupt;
+static struct Interrupt* pOldBlitInterrupt = NULL;
+static UWORD oldBlitIntena = 0;
+
+static UWORD* pSprites = NULL;
+
+static volatile ULONG* pCpuBuffer = NULL;
+static struct CpuTask* pCpuTask = NULL;
+
+// The server reads the flags
+static void SetLoadFlag(int load, BOOL on)
+{
+    Disable();
+    if (on)
+        loads |= STRESS_FLAG(load);
+    else
+        loads &= ~STRESS_FLAG(load);
+    Enable();
+}
+
+static void StartBlit()
+{
+    custom.bltapt = (ULONG)pBlitBuffer;
+    custom.bltdpt = (ULONG)(pBlitBuffer + BLIT_BYTES);
+    custom.bltsize = (BLIT_ROWS << 6) | BLIT_WORDS;
+}
+
+// Called by exec for the blitter interrupt with A1 = is_Data. It has no
+// server chain, so the request is cleared here.
+static void BlitDone(register APTR data __asm("a1"))
+{
+    custom.intreq = INTF_BLIT;
+    blitWords += BLIT_WORDS * BLIT_ROWS;
+
+    if (blitRunning)
+    {
+        StartBlit();
+    }
+}
+
+// Reads and writes chip RAM for as long as the task runs
+static void CpuHammer()
+{
+    volatile ULONG* p = pCpuBuffer;
+
+    for (;;)
+    {
+        for (int i = 0; i < CPU_LONGS; i++)
+        {
+            p[i] = ~p[i];
+        }
+
+        // Each longword is two words read and two written
+        cpuWords += CPU_LONGS * 4;
+    }
+}
+
+// Runs before the display server, so the sprite pointers are in before
+// sprite DMA starts for the frame
+static ULONG StressServer(register APTR data __asm("a1"))
+{
+    static UWORD frames = 0;
+    static ULONG lastBlitWords = 0;
+    static ULONG lastCpuWords = 0;
+
+    if (loads & STRESS_FLAG(STRESS_SPRITES))
+    {
+        for (int i = 0; i < SPRITE_COUNT; i++)
+        {
+            custom.sprpt[i] = (ULONG)(pSprites + (i * SPRITE_WORDS));
+        }
+    }
+
+    if (++frames == STRESS_AVERAGE_FRAMES)
+    {
+        ULONG blit = blitWords;
+        ULONG cpu = cpuWords;
+
+        g_stressStats.blitWords = (blit - lastBlitWords) / STRESS_AVERAGE_FRAMES;
+        g_stressStats.cpuWords = (cpu - lastCpuWords) / STRESS_AVERAGE_FRAMES;
+        g_stressStats.updates++;
+
+        lastBlitWords = blit;
+        lastCpuWords = cpu;
+        frames = 0;
+    }
+
+    return 0;
+}
+
+static BOOL StartBlitter()
+{
+    pBlitBuffer = (UBYTE*)AllocMem(BLIT_BYTES * 2, MEMF_CHIP|MEMF_CLEAR);
+    if (pBlitBuffer == NULL)
+    {
+        return FALSE;
+    }
+
+    // Every blit from now on is ours, started from the interrupt
+    OwnBlitter();
+    WaitBlit();
+
+    blitInterrupt.is_Node.ln_Type = NT_INTERRUPT;
+    blitInterrupt.is_Node.ln_Pri = 0;
+    blitInterrupt.is_Node.ln_Name = "Sparkler Blitter Stress";
+    blitInterrupt.is_Data = NULL;
+    blitInterrupt.is_Code = (void (*)())BlitDone;
+
+    Disable();
+    oldBlitIntena = custom.intenar & INTF_BLIT;
+    pOldBlitInterrupt = SetIntVector(INTB_BLIT, &blitInterrupt);
+
+    // A to D copy; only the pointers and size change between blits
+    custom.bltcon0 = SRCA|DEST|A_TO_D;
+    custom.bltcon1 = 0;
+    custom.bltafwm = 0xFFFF;
+    custom.bltalwm = 0xFFFF;
+    custom.bltamod = 0;
+    custom.bltdmod = 0;
+
+    blitRunning = TRUE;
+    custom.intreq = INTF_BLIT;
+    custom.intena = INTF_SETCLR|INTF_BLIT;
+    StartBlit();
+    Enable();
+
+    SetLoadFlag(STRESS_BLITTER, TRUE);
+    return TRUE;
+}
+
+static void StopBlitter()
+{
+    // The blit running now is the last
+    blitRunning = FALSE;
+    WaitBlit();
+
+    Disable();
+    if (!oldBlitIntena)
+    {
+        custom.intena = INTF_BLIT;
+    }
+    custom.intreq = INTF_BLIT;
+    SetIntVector(INTB_BLIT, pOldBlitInterrupt);
+    Enable();
+
+    DisownBlitter();
+    SetLoadFlag(STRESS_BLITTER, FALSE);
+
+    FreeMem(pBlitBuffer, BLIT_BYTES * 2);
+    pBlitBuffer = NULL;
+}
+
+static BOOL StartSprites()
+{
+    pSprites = (UWORD*)AllocMem(SPRITE_BYTES, MEMF_CHIP|MEMF_CLEAR);
+    if (pSprites == NULL)
+    {
+        return FALSE;
+    }
+
+    // Spread across the display. The image words stay clear, so the
+    // sprites are fetched on every line but never seen, and captures still
+    // match the reference frame.
+    const UWORD vstop = SPRITE_START + SPRITE_LINES;
+    for (int i = 0; i < SPRITE_COUNT; i++)
+    {
+        UWORD* pSprite = pSprites + (i * SPRITE_WORDS);
+        UWORD hstart = 0x80 + (i * 40);
+
+        pSprite[0] = ((SPRITE_START & 0xFF) << 8) | ((hstart >> 1) & 0xFF);
+        pSprite[1] = ((vstop & 0xFF) << 8) | ((SPRITE_START >> 8) << 2) | ((vstop >> 8) << 1) | (hstart & 1);
+    }
+
+    // The server loads the pointers from the next frame on
+    SetLoadFlag(STRESS_SPRITES, TRUE);
+    custom.dmacon = DMAF_SETCLR|DMAF_SPRITE;
+
+    return TRUE;
+}
+
+static void StopSprites()
+{
+    custom.dmacon = DMAF_SPRITE;
+    SetLoadFlag(STRESS_SPRITES, FALSE);
+
+    FreeMem(pSprites, SPRITE_BYTES);
+    pSprites = NULL;
+}
+
+static BOOL StartCpu()
+{
+    pCpuBuffer = (volatile ULONG*)AllocMem(CPU_BYTES, MEMF_CHIP|MEMF_CLEAR);
+    pCpuTask = (struct CpuTask*)AllocMem(sizeof(struct CpuTask), MEMF_PUBLIC|MEMF_CLEAR);
+    if (pCpuBuffer == NULL || pCpuTask == NULL)
+    {
+        if (pCpuBuffer != NULL)
+            FreeMem((APTR)pCpuBuffer, CPU_BYTES);
+        if (pCpuTask != NULL)
+            FreeMem(pCpuTask, sizeof(struct CpuTask));
+        pCpuBuffer = NULL;
+        pCpuTask = NULL;
+        return FALSE;
+    }
+
+    struct Task* pTask = &pCpuTask->task;
+    pTask->tc_Node.ln_Type = NT_TASK;
+    pTask->tc_Node.ln_Pri = CPU_TASK_PRI;
+    pTask->tc_Node.ln_Name = "Sparkler CPU Stress";
+    pTask->tc_SPLower = (APTR)pCpuTask->stack;
+    pTask->tc_SPUpper = (APTR)(pCpuTask->stack + (CPU_STACK_BYTES / 4));
+    pTask->tc_SPReg = pTask->tc_SPUpper;
+
+    // RemTask frees what is on this list, so it has to be a real empty one
+    NewList(&pTask->tc_MemEntry);
+    AddTask(pTask, (APTR)CpuHammer, NULL);
+    SetLoadFlag(STRESS_CPU, TRUE);
+    return TRUE;
+}
+
+static void StopCpu()
+{
+    // It holds nothing, so it can go from wherever it is
+    Forbid();
+    RemTask(&pCpuTask->task);
+    Permit();
+    SetLoadFlag(STRESS_CPU, FALSE);
+
+    FreeMem(pCpuTask, sizeof(struct CpuTask));
+    FreeMem((APTR)pCpuBuffer, CPU_BYTES);
+    pCpuTask = NULL;
+    pCpuBuffer = NULL;
+}
+
+void StressInit()
+{
+    // Above the display server's 0 but below 10, where a C server would
+    // have to return with A0 = custom and the Z flag set
+    vblankInterrupt.is_Node.ln_Type = NT_INTERRUPT;
+    vblankInterrupt.is_Node.ln_Pri = 1;
+    vblankInterrupt.is_Node.ln_Name = "Sparkler Stress";
+    vblankInterrupt.is_Data = NULL;
+    vblankInterrupt.is_Code = (void (*)())StressServer;
+
+    AddIntServer(INTB_VERTB, &vblankInterrupt);
+    serverAdded = TRUE;
+}
+
+void StressCleanup()
+{
+    for (int load = 0; load < STRESS_LOAD_COUNT; load++)
+    {
+        StressSet(load, FALSE);
+    }
+
+    if (serverAdded)
+    {
+        RemIntServer(INTB_VERTB, &vblankInterrupt);
+        serverAdded = FALSE;
+    }
+}
+
+BOOL StressSet(int load, BOOL on)
+{
+    if (on == ((loads & STRESS_FLAG(load)) != 0))
+    {
+        return TRUE;
+    }
+
+    switch (load)
+    {
+    case STRESS_BLITTER:
+        if (on)
+            return StartBlitter();
+        StopBlitter();
+        break;
+
+    case STRESS_SPRITES:
+        if (on)
+            return StartSprites();
+        StopSprites();
+        break;
+
+    case STRESS_CPU:
+        if (on)
+            return StartCpu();
+        StopCpu();
+        break;
+    }
+
+    return TRUE;
+}
+
+UWORD StressLoads()
+{
+    return loads;
+}
+
+UWORD StressDmaBits()
+{
+    return (loads & STRESS_FLAG(STRESS_SPRITES)) ? DMAF_SPRITE : 0;
+}
+
+static UWORD Percent(ULONG slots, ULONG frameSlots)
+{
+    return (UWORD)((slots * 100) / frameSlots);
+}
+
+void StressGetBusLoad(BOOL hires, BOOL pal, int fieldLines, struct StressBusLoad* pLoad)
+{
+    ULONG lines = pal ? 313 : 263;
+    ULONG frameSlots = lines * LINE_SLOTS;
+
+    ULONG display = (lines * REFRESH_SLOTS) + ((ULONG)fieldLines * FETCH_SLOTS(hires));
+
+    ULONG sprites = 0;
+    if (loads & STRESS_FLAG(STRESS_SPRITES))
+    {
+        ULONG spriteEnd = SPRITE_START + SPRITE_LINES < lines ? SPRITE_START + SPRITE_LINES : lines;
+        sprites = (spriteEnd - SPRITE_START) * SPRITE_SLOTS;
+    }
+
+    // An A to D copy takes a read and a write slot for every word
+    ULONG blitter = g_stressStats.blitWords * 2;
+    ULONG cpu = g_stressStats.cpuWords;
+
+    pLoad->display = Percent(display, frameSlots);
+    pLoad->sprites = Percent(sprites, frameSlots);
+    pLoad->blitter = Percent(blitter, frameSlots);
+    pLoad->cpu = Percent(cpu, frameSlots);
+
+    ULONG total = Percent(display + sprites + blitter + cpu, frameSlots);
+    pLoad->total = total < 100 ? total : 100;
+}
@@ -0,0 +1,63 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Chip bus stress: blitter copies chained from the blitter interrupt, eight
+// sprites fetched on every display line, and a low priority task hammering
+// chip RAM with the CPU. Each load is switched on its own, and a vertical
+// blank server of its own counts the bus slots they take.
+
+#ifndef SPARKLER_STRESS_H
+#define SPARKLER_STRESS_H
+
+#include <exec/types.h>
+
+enum StressLoad
+{
+    STRESS_BLITTER,
+    STRESS_SPRITES,
+    STRESS_CPU,
+    STRESS_LOAD_COUNT
+};
+
+#define STRESS_FLAG(load) (1 << (load))
+
+// Counts are averaged over this many frames
+#define STRESS_AVERAGE_FRAMES 16
+
+// Bus slots per frame, as counted by the server
+struct StressStats
+{
+    volatile ULONG blitWords;       // words the blitter copied, per frame
+    volatile ULONG cpuWords;        // chip RAM words the CPU read or wrote, per frame
+    volatile ULONG updates;         // changes when the averages do
+};
+
+extern struct StressStats g_stressStats;
+
+// Share of a frame's bus slots, in percent. Display fetch, refresh and
+// sprites are worked out from the mode, the blitter and CPU are counted.
+struct StressBusLoad
+{
+    UWORD display;
+    UWORD sprites;
+    UWORD blitter;
+    UWORD cpu;
+    UWORD total;
+};
+
+void StressInit(void);
+
+// Stop every load and free its chip RAM
+void StressCleanup(void);
+
+// FALSE if a load could not start, e.g. for lack of chip RAM
+BOOL StressSet(int load, BOOL on);
+
+// STRESS_FLAG() of each load that is on
+UWORD StressLoads(void);
+
+// DMACON bits the loads that are on need, for when the display is set up
+UWORD StressDmaBits(void);
+
+// fieldLines is the bitmap lines the display shows per field
+void StressGetBusLoad(BOOL hires, BOOL pal, int fieldLines, struct StressBusLoad* pLoad);
+
+#endif
@@ -0,0 +1,111 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Color sweep orders and checkpoints, see sweep.h
+
+#include <stdio.h>
+
+#include "sweep.h"
+
+#define CHECKPOINT_NEW SWEEP_CHECKPOINT_FILE ".new"
+
+// Every 12 bit mask, most bits set first
+static UWORD masksByBits[4096];
+
+void SweepInit()
+{
+    static const UBYTE nibbleBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    int start[14] = { 0 };
+
+    // Counting sort on the number of bits, 12 down to 0
+    for (int mask = 0; mask < 4096; mask++)
+    {
+        int bits = nibbleBits[mask & 15] + nibbleBits[(mask >> 4) & 15] + nibbleBits[mask >> 8];
+        start[(12 - bits) + 1]++;
+    }
+
+    for (int i = 1; i < 14; i++)
+    {
+        start[i] += start[i - 1];
+    }
+
+    for (int mask = 0; mask < 4096; mask++)
+    {
+        int bits = nibbleBits[mask & 15] + nibbleBits[(mask >> 4) & 15] + nibbleBits[mask >> 8];
+        masksByBits[start[12 - bits]++] = (UWORD)mask;
+    }
+}
+
+static ULONG PairFull(ULONG step)
+{
+    return step & 0xFFFFFF;
+}
+
+// Neighbouring steps differ in one bit, so only one nibble of C0/C1 changes
+static ULONG PairGray(ULONG step)
+{
+    return (step ^ (step >> 1)) & 0xFFFFFF;
+}
+
+// Every C0 against the C1 differing from it in all 12 bits, then every C0
+// against the twelve C1s differing in 11 bits, and so on
+static ULONG PairBitDiff(ULONG step)
+{
+    ULONG c0 = step & 0xFFF;
+    ULONG c1 = c0 ^ masksByBits[(step >> 12) & 0xFFF];
+    return (c0 << 12) | c1;
+}
+
+static const char* orderNames[SWEEP_ORDER_COUNT] = { "Full", "Gray", "BitDiff" };
+static const SweepPairFunc orderFunctions[SWEEP_ORDER_COUNT] = { PairFull, PairGray, PairBitDiff };
+
+const char* SweepOrderName(int order)
+{
+    return order >= 0 && order < SWEEP_ORDER_COUNT ? orderNames[order] : "?";
+}
+
+SweepPairFunc SweepPairFunction(int order)
+{
+    return order >= 0 && order < SWEEP_ORDER_COUNT ? orderFunctions[order] : PairFull;
+}
+
+static BOOL ReadCheckpoint(const char* path, struct SweepCheckpoint* pCheckpoint)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return FALSE;
+
+    unsigned int order = 0;
+    unsigned int holdFrames = 0;
+    unsigned long step = 0;
+    int fields = fscanf(file, "sweep %u %u %lu", &order, &holdFrames, &step);
+    fclose(file);
+
+    if (fields != 3 || order >= SWEEP_ORDER_COUNT || holdFrames < 1 || holdFrames > SWEEP_MAX_HOLD_FRAMES || step >= SWEEP_STEPS)
+        return FALSE;
+
+    pCheckpoint->order = (UWORD)order;
+    pCheckpoint->holdFrames = (UWORD)holdFrames;
+    pCheckpoint->step = step;
+    return TRUE;
+}
+
+BOOL SweepLoadCheckpoint(struct SweepCheckpoint* pCheckpoint)
+{
+    // A reset between writing the new file and renaming it leaves only that
+    return ReadCheckpoint(SWEEP_CHECKPOINT_FILE, pCheckpoint) || ReadCheckpoint(CHECKPOINT_NEW, pCheckpoint);
+}
+
+BOOL SweepSaveCheckpoint(const struct SweepCheckpoint* pCheckpoint)
+{
+    // Write a new file and swap it in, so a reset never leaves half a file
+    FILE* file = fopen(CHECKPOINT_NEW, "w");
+    if (file == NULL)
+        return FALSE;
+
+    BOOL written = fprintf(file, "sweep %u %u %lu\n", (unsigned int)pCheckpoint->order, (unsigned int)pCheckpoint->holdFrames, (unsigned long)pCheckpoint->step) > 0;
+    written = (fclose(file) == 0) && written;
+    if (!written)
+        return FALSE;
+
+    remove(SWEEP_CHECKPOINT_FILE);
+    return rename(CHECKPOINT_NEW, SWEEP_CHECKPOINT_FILE) == 0;
+}
@@ -0,0 +1,52 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Unattended sweep through every C0/C1 pair. A step maps to a pair
+// (C0 << 12 | C1) in one of several orders; the vertical blank server holds
+// each one for a set number of frames. Progress is saved to a checkpoint
+// file so a long sweep can pick up where it left off. Kept free of OS calls
+// so the host tools can build it too.
+
+#ifndef SPARKLER_SWEEP_H
+#define SPARKLER_SWEEP_H
+
+#include <exec/types.h>
+
+// Every C0 with every C1
+#define SWEEP_STEPS (1L << 24)
+
+#define SWEEP_HOLD_FRAMES 2
+#define SWEEP_MAX_HOLD_FRAMES 256
+
+// Checkpoint every this many frames while sweeping
+#define SWEEP_CHECKPOINT_FRAMES (60L * 50L)
+
+#define SWEEP_CHECKPOINT_FILE "PROGDIR:Sparkler.sweep"
+
+enum SweepOrder
+{
+    SWEEP_FULL,         // C0 and C1 counting up, C1 fastest
+    SWEEP_GRAY,         // reflected Gray code, one nibble changes per step
+    SWEEP_BITDIFF,      // pairs differing in the most bits first
+    SWEEP_ORDER_COUNT
+};
+
+struct SweepCheckpoint
+{
+    UWORD order;
+    UWORD holdFrames;
+    ULONG step;         // next step to show
+};
+
+// Build the tables the orders need
+void SweepInit(void);
+
+const char* SweepOrderName(int order);
+
+// Pair for a step, callable from an interrupt
+typedef ULONG (*SweepPairFunc)(ULONG step);
+SweepPairFunc SweepPairFunction(int order);
+
+// FALSE if there is no usable checkpoint
+BOOL SweepLoadCheckpoint(struct SweepCheckpoint* pCheckpoint);
+BOOL SweepSaveCheckpoint(const struct SweepCheckpoint* pCheckpoint);
+
+#endif
@@ -0,0 +1,597 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Vertical blank interrupt server and double-buffered copper lists
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/exec.h>
+#include <exec/interrupts.h>
+#include <hardware/custom.h>
+#include <hardware/intbits.h>
+
+#include "arena.h"
+#include "vblank.h"
+
+extern struct Custom custom;
+
+struct CopperBuffers g_copper;
+struct VBlankTicks g_vblankTicks;
+struct DisplayMailbox g_displayMailbox;
+struct ColorSequence g_colorSequence;
+struct ScrollMotion g_scrollMotion;
+
+static struct Interrupt vblankInterrupt;
+static BOOL serverAdded = FALSE;
+static BYTE tickSignal = -1;
+
+// Current beam line from VPOSR/VHPOSR
+static int BeamLine()
+{
+    return ((custom.vposr & 1) << 8) | (custom.vhposr >> 8);
+}
+
+// Field the copper shows this frame for a buffer. Long frames show the
+// even lines, short frames the odd ones.
+static int CurrentField(struct CopperBuffers* state, UWORD buffer)
+{
+    if (state->interlaced[buffer] && (custom.vposr & 0x8000) == 0)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+// What the front list was built from, with the last applied state and the
+// scroll position
+static void GetShownDisplay(struct CopperBuffers* state, struct CopperDisplay* display)
+{
+    UWORD front = state->front;
+    const struct DisplayState* shown = &state->shown;
+
+    display->hires = state->hires[front];
+    display->interlaced = state->interlaced[front];
+    display->pal = (state->beamcon0[front] & 0x20) != 0;
+    display->modulo = state->fieldOffset[front];
+    display->rowBytes = shown->rowBytes;
+    display->hudPlane = shown->hudPlane;
+    display->hudLines = shown->hudLines;
+    display->scroll = state->scroll[front];
+    display->scrollX = g_scrollMotion.x;
+    display->scrollY = g_scrollMotion.y;
+    for (int i = 0; i < 4; i++)
+    {
+        display->planes[i] = shown->planes[i];
+    }
+}
+
+// Point the front list at this frame's field, and the plane registers too
+// in case the copper has already loaded them. Interlaced lists are shared
+// by both fields, so this is done every frame for them.
+static void ShowField(struct CopperBuffers* state)
+{
+    UWORD front = state->front;
+    int field = CurrentField(state, front);
+
+    struct CopperDisplay display;
+    GetShownDisplay(state, &display);
+    CopperPatchField(&state->copper[front], &display, field);
+
+    ULONG offset = (field == 1 ? display.modulo : 0) - (display.scroll ? COPPER_SCROLL_LEAD : 0);
+    for (int i = 0; i < 3; i++)
+    {
+        custom.bplpt[i] = (APTR)(display.planes[i] + offset);
+    }
+    custom.bplpt[3] = (APTR)(display.hudPlane + offset);
+
+    state->backStale = TRUE;
+}
+
+// Put the posted colors and bitplanes into the running list, so they stay
+// from now on, and colors 0-7 straight into the registers, since the copper
+// has already loaded this frame's values. Colors 8-15 and plane 4 are loaded
+// again below the HUD band, further down the list, so patching takes them
+// this frame and the registers hold the HUD's until then.
+static void ApplyDisplayState(struct CopperBuffers* state, const struct DisplayState* display)
+{
+    struct CopperList* cl = &state->copper[state->front];
+
+    state->shown = *display;
+    for (int i = 0; i < 16; i++)
+    {
+        CopperPatch(cl, COPSLOT_COLOR(i), display->colors[i]);
+    }
+
+    // The WAIT is further down the list, so it still takes this frame
+    CopperPatchWait(cl, COPSLOT_HUDWAIT, COPPER_DISPLAY_TOP + display->hudLines, 0);
+
+    for (int i = 0; i < 8; i++)
+    {
+        custom.color[i] = display->colors[i];
+    }
+
+    ShowField(state);
+}
+
+// Put the sequence's pair into the running list and the registers
+static void ShowSequencePair(struct CopperBuffers* state, ULONG pair)
+{
+    UWORD c0 = (UWORD)((pair >> 12) & 0xFFF);
+    UWORD c1 = (UWORD)(pair & 0xFFF);
+
+    struct CopperList* cl = &state->copper[state->front];
+    CopperPatch(cl, COPSLOT_COLOR(0), c0);
+    CopperPatch(cl, COPSLOT_COLOR(1), c1);
+
+    custom.color[0] = c0;
+    custom.color[1] = c1;
+    state->backStale = TRUE;
+}
+
+// Put a cycle palette into the running list, and colors 0-7 into the
+// registers; 8-15 are loaded below the HUD band, like posted colors
+static void ShowSequencePalette(struct CopperBuffers* state, const UWORD* colors)
+{
+    struct CopperList* cl = &state->copper[state->front];
+    for (int i = 0; i < 16; i++)
+    {
+        CopperPatch(cl, COPSLOT_COLOR(i), colors[i]);
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        custom.color[i] = colors[i];
+    }
+    state->backStale = TRUE;
+}
+
+static void ShowSequenceStep(struct CopperBuffers* state, struct ColorSequence* seq)
+{
+    if (seq->palettes != NULL)
+        ShowSequencePalette(state, seq->palettes[seq->step]);
+    else
+        ShowSequencePair(state, seq->pair);
+}
+
+// One frame of the color sequence. New pairs only go up early in the frame,
+// like swaps, so no frame is split between two pairs. reapply is set when
+// posted colors were just applied over the pair on screen.
+static void StepSequence(struct CopperBuffers* state, BOOL early, BOOL reapply)
+{
+    struct ColorSequence* seq = &g_colorSequence;
+
+    if (!seq->showPending && seq->framesLeft > 0)
+    {
+        seq->framesLeft--;
+    }
+
+    if (!seq->showPending && seq->framesLeft == 0)
+    {
+        if (seq->step + 1 < seq->stepCount)
+        {
+            seq->step++;
+        }
+        else if (seq->palettes != NULL)
+        {
+            seq->step = 0;
+        }
+        else
+        {
+            seq->active = FALSE;
+            seq->finished = TRUE;
+            return;
+        }
+
+        seq->showPending = TRUE;
+    }
+
+    if (seq->showPending && early)
+    {
+        if (seq->palettes == NULL)
+        {
+            seq->pair = seq->pairForStep(seq->step);
+        }
+
+        if (seq->firstFrame == 0)
+        {
+            seq->firstFrame = g_vblankTicks.frames;
+        }
+
+        seq->framesLeft = seq->holdFrames;
+        seq->showPending = FALSE;
+        ShowSequenceStep(state, seq);
+    }
+    else
+    {
+        if (seq->showPending)
+        {
+            seq->lateFrames++;
+        }
+
+        if (reapply)
+        {
+            ShowSequenceStep(state, seq);
+        }
+    }
+}
+
+// Move the scroll position on a frame and point the running list at it.
+// Everything that changes is below the HUD band, so this frame shows it.
+static void StepScroll(struct CopperBuffers* state)
+{
+    struct ScrollMotion* motion = &g_scrollMotion;
+
+    struct CopperDisplay display;
+    GetShownDisplay(state, &display);
+
+    LONG width = (LONG)CopperScrollWidth(&display);
+    LONG height = (LONG)CopperScrollHeight(&display);
+    LONG x = (LONG)(motion->x % width) + motion->dx;
+    LONG y = (LONG)(motion->y % height) + motion->dy;
+
+    if (x >= width)
+    {
+        x -= width;
+        y++;
+    }
+    else if (x < 0)
+    {
+        x += width;
+        y--;
+    }
+
+    if (y >= height)
+        y -= height;
+    else if (y < 0)
+        y += height;
+
+    motion->x = (ULONG)x;
+    motion->y = (ULONG)y;
+    display.scrollX = (ULONG)x;
+    display.scrollY = (ULONG)y;
+
+    CopperPatchScroll(&state->copper[state->front], &display, CurrentField(state, state->front));
+    state->backStale = TRUE;
+}
+
+// Swap in the committed list and apply the posted display state, unless it
+// is too late in the frame. Returns TRUE if the state was applied.
+static BOOL SwapAndApply(struct CopperBuffers* state, BOOL early, UWORD published)
+{
+    if (!early)
+    {
+        if (state->swapPending)
+            state->lateSwaps++;
+        else
+            g_displayMailbox.lateApplies++;
+
+        return FALSE;
+    }
+
+    if (state->swapPending)
+    {
+        UWORD front = state->front ^ 1;
+
+        custom.beamcon0 = state->beamcon0[front];
+        custom.cop1lc = (ULONG)state->lists[front];
+        custom.copjmp1 = 0;
+
+        state->front = front;
+        state->swapPending = FALSE;
+        state->backStale = TRUE;
+        state->swaps++;
+    }
+
+    // Also after every swap, so new lists never miss a posted change
+    ApplyDisplayState(state, &g_displayMailbox.slots[published & 1]);
+    g_displayMailbox.applied = published;
+    g_displayMailbox.appliedFrame = g_vblankTicks.frames;
+
+    return TRUE;
+}
+
+// Called by exec for every VERTB interrupt with A1 = is_Data. Returning 0
+// lets the rest of the server chain run.
+static ULONG VBlankServer(register struct CopperBuffers* state __asm("a1"))
+{
+    g_vblankTicks.frames++;
+    if (g_vblankTicks.enabled)
+    {
+        Signal(g_vblankTicks.task, g_vblankTicks.signalMask);
+    }
+
+    BOOL early = BeamLine() <= VBLANK_SAFE_LINE;
+    BOOL applied = FALSE;
+
+    UWORD published = g_displayMailbox.published;
+    if (state->swapPending || (published != g_displayMailbox.applied && !state->holdApply))
+    {
+        applied = SwapAndApply(state, early, published);
+    }
+
+    BOOL stepPending = g_colorSequence.active && g_colorSequence.showPending;
+    if (g_colorSequence.active)
+    {
+        StepSequence(state, early, applied);
+    }
+
+    // Wake CopperWaitSwap or DisplayWaitShown to look again
+    if (g_vblankTicks.waiting && (applied || (stepPending && !g_colorSequence.showPending)))
+    {
+        Signal(g_vblankTicks.task, g_vblankTicks.signalMask);
+    }
+
+    // An apply has already shown this frame's field
+    if (state->interlaced[state->front] && early && !applied)
+    {
+        ShowField(state);
+    }
+
+    // Only on top of a state that has been applied
+    if (state->scroll[state->front] && early && g_displayMailbox.applied == published)
+    {
+        StepScroll(state);
+    }
+
+    return 0;
+}
+
+BOOL VBlankInit(ULONG listSize)
+{
+    g_copper.listSize = listSize;
+
+    tickSignal = AllocSignal(-1);
+    if (tickSignal == -1)
+    {
+        return FALSE;
+    }
+
+    g_vblankTicks.task = FindTask(NULL);
+    g_vblankTicks.signalMask = 1L << tickSignal;
+    g_vblankTicks.enabled = FALSE;
+    g_vblankTicks.waiting = FALSE;
+
+    for (int buffer = 0; buffer < 2; buffer++)
+    {
+        g_copper.lists[buffer] = (UWORD*)ArenaAllocFixed(listSize);
+        if (g_copper.lists[buffer] == NULL)
+        {
+            VBlankCleanup();
+            return FALSE;
+        }
+
+        CopperInit(&g_copper.copper[buffer], NULL, 0);
+    }
+
+    g_copper.front = 0;
+    g_copper.swapPending = FALSE;
+    g_copper.holdApply = FALSE;
+    g_copper.backStale = FALSE;
+
+    // Below 10, so the server need not return with A0 = custom and the Z
+    // flag set; swaps check the beam line rather than relying on going first
+    vblankInterrupt.is_Node.ln_Type = NT_INTERRUPT;
+    vblankInterrupt.is_Node.ln_Pri = 0;
+    vblankInterrupt.is_Node.ln_Name = "Sparkler VBlank";
+    vblankInterrupt.is_Data = (APTR)&g_copper;
+    vblankInterrupt.is_Code = (void (*)())VBlankServer;
+
+    AddIntServer(INTB_VERTB, &vblankInterrupt);
+    serverAdded = TRUE;
+
+    return TRUE;
+}
+
+void VBlankCleanup()
+{
+    if (serverAdded)
+    {
+        RemIntServer(INTB_VERTB, &vblankInterrupt);
+        serverAdded = FALSE;
+    }
+
+    if (tickSignal != -1)
+    {
+        g_vblankTicks.enabled = FALSE;
+        FreeSignal(tickSignal);
+        tickSignal = -1;
+    }
+
+    // The lists go back with the arena
+    for (int buffer = 0; buffer < 2; buffer++)
+    {
+        g_copper.lists[buffer] = NULL;
+    }
+}
+
+void VBlankEnableTicks(BOOL enabled)
+{
+    g_vblankTicks.enabled = enabled;
+}
+
+void CopperBeginEdit(BOOL rebuild)
+{
+    // The server only swaps when swapPending is set, so once it is clear
+    // the back buffer belongs to us. Plane pointers and row bytes posted
+    // for the new lists must not go into the old ones meanwhile.
+    Disable();
+    if (g_copper.swapPending)
+    {
+        g_copper.holdApply = TRUE;
+    }
+    g_copper.swapPending = FALSE;
+    Enable();
+
+    if (!g_copper.backStale)
+    {
+        return;
+    }
+
+    g_copper.backStale = FALSE;
+    if (rebuild)
+    {
+        return;
+    }
+
+    UWORD front = g_copper.front;
+    UWORD back = front ^ 1;
+
+    CopyMem(g_copper.lists[front], g_copper.lists[back], g_copper.listSize);
+
+    g_copper.copper[back] = g_copper.copper[front];
+    if (g_copper.copper[back].words != NULL)
+    {
+        g_copper.copper[back].words = g_copper.lists[back];
+    }
+
+    g_copper.beamcon0[back] = g_copper.beamcon0[front];
+    g_copper.hires[back] = g_copper.hires[front];
+    g_copper.interlaced[back] = g_copper.interlaced[front];
+    g_copper.fieldOffset[back] = g_copper.fieldOffset[front];
+    g_copper.scroll[back] = g_copper.scroll[front];
+}
+
+struct CopperList* CopperBack()
+{
+    return &g_copper.copper[g_copper.front ^ 1];
+}
+
+UWORD* CopperBackWords()
+{
+    return g_copper.lists[g_copper.front ^ 1];
+}
+
+void CopperSetMode(UWORD beamcon0, BOOL hires, BOOL interlaced, UWORD fieldOffset, BOOL scroll)
+{
+    UWORD back = g_copper.front ^ 1;
+    g_copper.beamcon0[back] = beamcon0;
+    g_copper.hires[back] = hires;
+    g_copper.interlaced[back] = interlaced;
+    g_copper.fieldOffset[back] = fieldOffset;
+    g_copper.scroll[back] = scroll;
+}
+
+void CopperCommit()
+{
+    // Set first, so a held state only ever goes up with the swap
+    g_copper.swapPending = TRUE;
+    g_copper.holdApply = FALSE;
+}
+
+// Set before the caller's first look, so a swap landing between the look
+// and the Wait() leaves the signal set rather than being missed
+static void BeginServerWait()
+{
+    g_vblankTicks.waiting = TRUE;
+}
+
+// The Wait()s may have taken a frame tick the main loop was counting on
+static void EndServerWait()
+{
+    g_vblankTicks.waiting = FALSE;
+    if (g_vblankTicks.enabled)
+    {
+        SetSignal(g_vblankTicks.signalMask, g_vblankTicks.signalMask);
+    }
+}
+
+void CopperWaitSwap()
+{
+    BeginServerWait();
+    while (g_copper.swapPending)
+    {
+        Wait(g_vblankTicks.signalMask);
+    }
+    EndServerWait();
+}
+
+ULONG DisplayWaitShown(ULONG since)
+{
+    BeginServerWait();
+    while (g_copper.swapPending || g_displayMailbox.applied != g_displayMailbox.published
+        || (g_colorSequence.active && g_colorSequence.showPending))
+    {
+        Wait(g_vblankTicks.signalMask);
+    }
+    EndServerWait();
+
+    ULONG frame = since;
+    if (g_displayMailbox.appliedFrame > frame)
+    {
+        frame = g_displayMailbox.appliedFrame;
+    }
+    if (g_colorSequence.active && g_colorSequence.firstFrame > frame)
+    {
+        frame = g_colorSequence.firstFrame;
+    }
+
+    return frame;
+}
+
+const struct DisplayState* DisplayCurrent()
+{
+    return &g_displayMailbox.slots[g_displayMailbox.published & 1];
+}
+
+struct DisplayState* DisplayBeginChange()
+{
+    // The server only ever reads the published slot
+    UWORD published = g_displayMailbox.published;
+    struct DisplayState* pNext = &g_displayMailbox.slots[(published & 1) ^ 1];
+    *pNext = g_displayMailbox.slots[published & 1];
+    return pNext;
+}
+
+void DisplayPostChange()
+{
+    UWORD published = g_displayMailbox.published;
+    g_displayMailbox.published = (UWORD)(((published >> 1) + 1) << 1) | ((published & 1) ^ 1);
+}
+
+void CopperCommitWithDisplay()
+{
+    Disable();
+    DisplayPostChange();
+    CopperCommit();
+    Enable();
+}
+
+void ColorSequenceStart(ULONG (*pairForStep)(ULONG step), ULONG stepCount, ULONG firstStep, UWORD holdFrames)
+{
+    Disable();
+    g_colorSequence.pairForStep = pairForStep;
+    g_colorSequence.palettes = NULL;
+    g_colorSequence.stepCount = stepCount;
+    g_colorSequence.holdFrames = holdFrames > 0 ? holdFrames : 1;
+    g_colorSequence.framesLeft = 0;
+    g_colorSequence.step = firstStep;
+    g_colorSequence.pair = pairForStep(firstStep);
+    g_colorSequence.showPending = TRUE;
+    g_colorSequence.finished = FALSE;
+    g_colorSequence.firstFrame = 0;
+    g_colorSequence.lateFrames = 0;
+    g_colorSequence.active = TRUE;
+    Enable();
+}
+
+void ColorCycleStart(const UWORD (*palettes)[16], ULONG stepCount, ULONG firstStep, UWORD holdFrames)
+{
+    Disable();
+    g_colorSequence.pairForStep = NULL;
+    g_colorSequence.palettes = palettes;
+    g_colorSequence.stepCount = stepCount;
+    g_colorSequence.holdFrames = holdFrames > 0 ? holdFrames : 1;
+    g_colorSequence.framesLeft = 0;
+    g_colorSequence.step = firstStep < stepCount ? firstStep : 0;
+    g_colorSequence.pair = 0;
+    g_colorSequence.showPending = TRUE;
+    g_colorSequence.finished = FALSE;
+    g_colorSequence.firstFrame = 0;
+    g_colorSequence.lateFrames = 0;
+    g_colorSequence.active = TRUE;
+    Enable();
+}
+
+void ColorSequenceStop()
+{
+    g_colorSequence.active = FALSE;
+}
@@ -0,0 +1,181 @@
+// Amiga Sparkler Copyright 2021 by Bloodmosher
+// Vertical blank interrupt server and the double-buffered copper lists it
+// swaps. The main task only ever edits the back list; the server makes it
+// the front list at the top of the next frame. Interlaced displays run the
+// same list for both fields, and the server points it at the field each
+// frame shows, read from the long frame bit.
+//
+// Colors and bitplane pointers don't need a rebuild. The main task posts
+// them to a mailbox and the server applies them to the running lists and
+// the registers on the very next frame.
+
+#ifndef SPARKLER_VBLANK_H
+#define SPARKLER_VBLANK_H
+
+#include <exec/types.h>
+
+#include "copper.h"
+
+// Swaps are only done this early in the frame, well before the display
+// window starts at line 0x2c; later ones wait for the next frame.
+#define VBLANK_SAFE_LINE 0x20
+
+// Display registers owned by the vertical blank server
+struct DisplayState
+{
+    UWORD colors[16];
+    ULONG planes[4];
+    UWORD rowBytes;                     // bytes in a bitmap row
+    ULONG hudPlane;
+    UWORD hudLines;                     // height of the HUD band
+};
+
+struct CopperBuffers
+{
+    UWORD* lists[2];                    // in the arena
+    struct CopperList copper[2];
+    struct DisplayState shown;          // last applied, for the server only
+    ULONG listSize;
+    UWORD beamcon0[2];
+    BOOL hires[2];
+    BOOL interlaced[2];
+    UWORD fieldOffset[2];               // bitplane offset of field 1
+    BOOL scroll[2];                     // lists built for scrolling
+
+    volatile UWORD front;               // buffer the copper is running
+    volatile BOOL swapPending;
+    volatile BOOL holdApply;            // posted state waits for the next commit
+    volatile BOOL backStale;            // back buffer is older than front
+    volatile ULONG swaps;
+    volatile ULONG lateSwaps;           // swaps pushed to the next frame
+};
+
+extern struct CopperBuffers g_copper;
+
+// Two slots; the main task fills the one the server is not reading and then
+// publishes it with a single word write: post count << 1 | slot.
+struct DisplayMailbox
+{
+    struct DisplayState slots[2];
+    volatile UWORD published;
+    UWORD applied;                      // last value the server applied
+    volatile ULONG appliedFrame;        // frame it first showed on
+    volatile ULONG lateApplies;         // applies pushed to the next frame
+};
+
+extern struct DisplayMailbox g_displayMailbox;
+
+// Frame counter, and an optional signal to the main task on every frame.
+// The same signal also goes out while waiting is set, on a frame that put
+// up a swap, an apply or a color sequence step.
+struct VBlankTicks
+{
+    volatile ULONG frames;
+    struct Task* task;
+    ULONG signalMask;
+    volatile BOOL enabled;
+    volatile BOOL waiting;
+};
+
+extern struct VBlankTicks g_vblankTicks;
+
+// Colors 0 and 1 stepped by the server itself, so every pair is held for
+// exactly holdFrames frames whatever the main task is doing. pairForStep
+// maps a step to C0 << 12 | C1 and is called from the interrupt. A color
+// cycle steps through whole palettes from a table instead, and starts over
+// after the last one.
+struct ColorSequence
+{
+    volatile BOOL active;
+    volatile BOOL finished;             // ran past the last step
+    ULONG (*pairForStep)(ULONG step);
+    const UWORD (*palettes)[16];        // cycle table, NULL for pairs
+    ULONG stepCount;
+    UWORD holdFrames;
+    UWORD framesLeft;
+    BOOL showPending;                   // step is not on screen yet
+    volatile ULONG step;                // step on screen
+    volatile ULONG pair;
+    volatile ULONG firstFrame;          // frame the first step went up on
+    volatile ULONG lateFrames;          // frames a due step had to wait
+};
+
+extern struct ColorSequence g_colorSequence;
+
+// Hardware scrolling, moved on by the server every frame while the lists on
+// screen were built for it. Only the plane pointers and BPLCON1 in the
+// lists change; no bitmap data is copied. Speeds are per frame, dx in
+// BPLCON1 steps and dy in bitmap rows. Running off the right of a row
+// carries on at the start of the next one.
+struct ScrollMotion
+{
+    volatile WORD dx;
+    volatile WORD dy;
+    volatile ULONG x;
+    volatile ULONG y;
+};
+
+extern struct ScrollMotion g_scrollMotion;
+
+// Take the two lists from the chip RAM arena's fixed space, allocate
+// a tick signal for the calling task, and add the interrupt server
+BOOL VBlankInit(ULONG listSize);
+
+// Start or stop signalling the main task every frame
+void VBlankEnableTicks(BOOL enabled);
+
+// Remove the server; the lists go back with the arena
+void VBlankCleanup(void);
+
+// Start editing the back buffer. Cancels a pending swap and, unless the
+// caller is about to rebuild the list anyway, brings it up to date with the
+// front buffer first. A state posted with the cancelled swap is held back
+// until the next commit, since it was meant for the back list.
+void CopperBeginEdit(BOOL rebuild);
+
+// Back buffer list and the memory it lives in, only valid between begin
+// and commit
+struct CopperList* CopperBack(void);
+UWORD* CopperBackWords(void);
+
+// BEAMCON0, resolution, interlace, the field 1 bitplane offset and whether
+// the lists scroll, to apply together with the back buffer
+void CopperSetMode(UWORD beamcon0, BOOL hires, BOOL interlaced, UWORD fieldOffset, BOOL scroll);
+
+// Hand the back buffer to the server for the next vertical blank
+void CopperCommit(void);
+
+// Block until the committed buffer is on screen
+void CopperWaitSwap(void);
+
+// Block until the committed buffer, the posted state and any color
+// sequence step waiting to go up are all on screen. Returns the frame the
+// last of them to go up since frame since first showed on, or since if
+// none did.
+ULONG DisplayWaitShown(ULONG since);
+
+// Display state as last posted
+const struct DisplayState* DisplayCurrent(void);
+
+// Start a change: returns a copy of the current state to modify
+struct DisplayState* DisplayBeginChange(void);
+
+// Publish the change; it shows on the next frame
+void DisplayPostChange(void);
+
+// Publish a display change and commit the back buffer so that both land on
+// the same frame
+void CopperCommitWithDisplay(void);
+
+// Hand colors 0 and 1 to the server from firstStep on; it overrides the
+// posted values for them until stopped
+void ColorSequenceStart(ULONG (*pairForStep)(ULONG step), ULONG stepCount, ULONG firstStep, UWORD holdFrames);
+void ColorSequenceStop(void);
+
+// Hand the whole palette to the server, stepping through stepCount
+// palettes in a loop from firstStep on. The table must stay put until
+// stopped. With no late frames, frame f shows step
+// (firstStep + (f - firstFrame) / holdFrames) % stepCount.
+void ColorCycleStart(const UWORD (*palettes)[16], ULONG stepCount, ULONG firstStep, UWORD holdFrames);
+
+#endif